@@ -0,0 +1,296 @@
+// Measures throughput of a read/write mix on one table at 1 to 32 threads.
+// Every thread runs point lookups and short scans on snapshots,
+// writes take the table's writer mutex and change copies of pages.
+// Then compares point lookup latency of readers alone and next to an inserting writer,
+// and the insert rate of a writer alone and next to full table scans.
+// Usage: bench_concurrency [row count] [write percent], 100000 rows and 5% by default
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../includes/data.h"
+#include "../includes/catalog.h"
+
+static void fillRow(Row* row, uint64_t id, uint64_t version)
+{
+    std::string idStr = std::to_string(id);
+    row->keyType = KEY_INTEGER;
+    row->key = { 0, id };
+    strcpy_s(row->username, ("user" + idStr + "_" + std::to_string(version)).c_str());
+    strcpy_s(row->email, ("user" + idStr + "@example.com").c_str());
+    row->value.clear();
+}
+
+// Insert a new row, or overwrite the row if the key exists
+static void writeRow(std::shared_ptr<Table>& table, Row* row)
+{
+    TableWriter writer(table);
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, row->key);
+
+    void* node = table->pager->getPage(cursor->pageNumber);
+    if (cursor->cellCount < *leafGetCellCount(node) &&
+        leafGetKey(node, cursor->cellCount) == row->key)
+    {
+        leafUpdate(cursor, row);
+        return;
+    }
+    leafInsert(cursor, row);
+}
+
+// Returns false if the row under the cursor isn't the one that was asked for
+static bool readRow(std::shared_ptr<Table>& table, uint64_t id)
+{
+    Row row;
+    Key key = { 0, id };
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+    deserializeRow(cursorValue(cursor), &row);
+    return row.key == key;
+}
+
+// Walk a few rows in either direction, rows have to stay in key order
+static bool scanRows(std::shared_ptr<Table>& table, uint64_t id, bool descending)
+{
+    Row row;
+    Key previous = { 0, id };
+    std::unique_ptr<Cursor> cursor = descending ? tableSeekLast(table, previous)
+                                                : tableSeek(table, previous);
+    for (int i = 0; i < 32 && !(cursor->endOfTable); i++)
+    {
+        deserializeRow(cursorValue(cursor), &row);
+        if (descending ? previous < row.key : row.key < previous)
+        {
+            return false;
+        }
+        previous = row.key;
+
+        if (descending)
+            (*cursor)--;
+        else
+            (*cursor)++;
+    }
+    return true;
+}
+
+// Latencies of point lookups by 4 readers, in nanoseconds. If withWriter is set,
+// one more thread keeps inserting new rows meanwhile
+static std::vector<uint64_t> lookupLatencies(std::shared_ptr<Table>& table, uint64_t rowCount,
+                                             std::atomic<uint64_t>& inserted, bool withWriter,
+                                             std::atomic<bool>& failed)
+{
+    const uint32_t readerCount = 4;
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<uint64_t>> latencies(readerCount);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < readerCount; t++)
+    {
+        threads.emplace_back([&, t]() {
+            std::mt19937_64 random(t);
+            std::uniform_int_distribution<uint64_t> ids(1, rowCount);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                auto start = std::chrono::steady_clock::now();
+                bool found = readRow(table, 2 * ids(random));
+                auto end = std::chrono::steady_clock::now();
+                latencies[t].push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+                if (!found)
+                    failed = true;
+            }
+        });
+    }
+    if (withWriter)
+    {
+        threads.emplace_back([&]() {
+            Row row;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                fillRow(&row, 2 * rowCount + 2 * inserted.fetch_add(1) + 1, 0);
+                writeRow(table, &row);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    stop = true;
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<uint64_t> merged;
+    for (std::vector<uint64_t>& threadLatencies : latencies)
+    {
+        merged.insert(merged.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+    std::sort(merged.begin(), merged.end());
+    return merged;
+}
+
+// Inserts per second of one writer while scanThreads threads scan the whole table.
+// A scan has to see exactly the number of rows its snapshot counts
+static double insertRate(std::shared_ptr<Table>& table, uint64_t rowCount,
+                         std::atomic<uint64_t>& inserted, uint32_t scanThreads,
+                         std::atomic<bool>& failed)
+{
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> scanners;
+    for (uint32_t t = 0; t < scanThreads; t++)
+    {
+        scanners.emplace_back([&]() {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                Snapshot snapshot;
+                uint64_t expected = tableCount(table);
+                uint64_t seen = 0;
+                for (std::unique_ptr<Cursor> cursor = tableStart(table); !(cursor->endOfTable);
+                     cursorAdvance(cursor))
+                {
+                    if (!isRowDeleted(cursorValue(cursor)))
+                        seen++;
+                }
+                if (seen != expected)
+                    failed = true;
+            }
+        });
+    }
+
+    const std::chrono::milliseconds duration(1000);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t done = 0;
+    Row row;
+    while (std::chrono::steady_clock::now() - start < duration)
+    {
+        fillRow(&row, 2 * rowCount + 2 * inserted.fetch_add(1) + 1, 0);
+        writeRow(table, &row);
+        done++;
+    }
+    stop = true;
+    for (std::thread& scanner : scanners)
+    {
+        scanner.join();
+    }
+    return done / std::chrono::duration<double>(duration).count();
+}
+
+static void printLatencies(const std::string& name, const std::vector<uint64_t>& latencies)
+{
+    if (latencies.empty())
+    {
+        return;
+    }
+    std::cout << name << "\t " << latencies[latencies.size() / 2] << "\t  "
+              << latencies[latencies.size() * 99 / 100] << "\t   "
+              << latencies.back() << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 100000;
+    uint32_t writePercent = argc > 2 ? std::stoul(argv[2]) : 5;
+    const std::string filename = "bench_concurrency.db";
+    const std::chrono::milliseconds duration(1000);
+    DeleteFileA(filename.c_str());
+
+    // Even ids are loaded up front, writers insert odd ids and update even ones
+    std::shared_ptr<Table> catalog = openDatabase(filename);
+    std::shared_ptr<Table> table = createTable(catalog, "bench", KEY_INTEGER);
+    Row row;
+    for (uint64_t id = 2; id <= 2 * rowCount; id += 2)
+    {
+        fillRow(&row, id, 0);
+        writeRow(table, &row);
+    }
+
+    std::cout << "Rows: " << rowCount << ", writes: " << writePercent << "%" << std::endl;
+    std::cout << "Threads  Ops/s        Speedup" << std::endl;
+
+    double singleThread = 0;
+    std::atomic<uint64_t> inserted(0);
+    std::atomic<bool> failed(false);
+    for (uint32_t threadCount = 1; threadCount <= 32; threadCount *= 2)
+    {
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> operations(0);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&, t]() {
+                std::mt19937_64 random(threadCount * 64 + t);
+                std::uniform_int_distribution<uint64_t> ids(1, rowCount);
+                std::uniform_int_distribution<uint32_t> percent(0, 99);
+                uint64_t done = 0;
+                Row threadRow;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    uint64_t id = 2 * ids(random);
+                    uint32_t choice = percent(random);
+                    if (choice < writePercent / 2)
+                    {
+                        fillRow(&threadRow, 2 * rowCount + 2 * inserted.fetch_add(1) + 1, 0);
+                        writeRow(table, &threadRow);
+                    }
+                    else if (choice < writePercent)
+                    {
+                        fillRow(&threadRow, id, done);
+                        writeRow(table, &threadRow);
+                    }
+                    else if (choice < writePercent + 5)
+                    {
+                        if (!scanRows(table, id, choice % 2 == 0))
+                            failed = true;
+                    }
+                    else if (!readRow(table, id))
+                    {
+                        failed = true;
+                    }
+                    done++;
+                }
+                operations += done;
+            });
+        }
+
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        double throughput = operations / std::chrono::duration<double>(duration).count();
+        if (threadCount == 1)
+        {
+            singleThread = throughput;
+        }
+        std::cout << threadCount << "\t " << static_cast<uint64_t>(throughput) << "\t      "
+                  << throughput / singleThread << "x" << std::endl;
+    }
+
+    // Readers never wait for the writer, so lookups next to inserts 
+    // should stay close to the read-only numbers
+    std::cout << std::endl << "Lookups       p50 ns  p99 ns  max ns" << std::endl;
+    printLatencies("read-only", lookupLatencies(table, rowCount, inserted, false, failed));
+    printLatencies("with inserts", lookupLatencies(table, rowCount, inserted, true, failed));
+
+    // Neither does the writer wait for scans, they keep reading their snapshot
+    std::cout << std::endl << "Writer        Inserts/s" << std::endl;
+    std::cout << "alone\t      " 
+              << static_cast<uint64_t>(insertRate(table, rowCount, inserted, 0, failed)) << std::endl;
+    std::cout << "with 2 scans\t      " 
+              << static_cast<uint64_t>(insertRate(table, rowCount, inserted, 2, failed)) << std::endl;
+
+    if (failed || tableCount(table) != rowCount + inserted)
+    {
+        std::cerr << "Readers saw rows out of order or rows were lost" << std::endl;
+        return 1;
+    }
+
+    saveAndCloseDatabase(catalog);
+    DeleteFileA(filename.c_str());
+
+    return 0;
+}
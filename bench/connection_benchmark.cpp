@@ -0,0 +1,151 @@
+// Compares typed calls of an embedded connection with the same work given as
+// statement text: inserts, point lookups and scans of 100-row ranges. Text
+// statements are parsed every time and their rows are printed to a string.
+// Usage: bench_connection [row count], 1000000 rows by default
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "../includes/connection.h"
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t ROWS_PER_TRANSACTION = 10000;
+const uint64_t LOOKUP_COUNT = 200000;
+const uint64_t SCAN_COUNT = 20000;
+const uint64_t SCAN_ROWS = 100;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Insert rows in key order into a new table, return inserts per second
+static double insertRows(Connection& connection, uint64_t rowCount, bool typed)
+{
+    connection.exec("create table bench");
+    Clock::time_point start = Clock::now();
+    for (uint64_t id = 1; id <= rowCount; id++)
+    {
+        if (id % ROWS_PER_TRANSACTION == 1)
+        {
+            connection.begin();
+        }
+
+        std::string idStr = std::to_string(id);
+        ExecuteResult result = typed ? 
+            connection.insert(id, "user" + idStr, "user" + idStr + "@example.com") :
+            connection.exec("insert " + idStr + " user" + idStr + " user" + idStr + "@example.com");
+        if (result != ExecuteResult::EXECUTE_SUCCESS)
+        {
+            std::cerr << "Insert of row " << id << " failed" << std::endl;
+            break;
+        }
+
+        if (id % ROWS_PER_TRANSACTION == 0 || id == rowCount)
+        {
+            connection.commit();
+        }
+    }
+    return rowCount / secondsSince(start);
+}
+
+// Look up random keys, return lookups per second
+static double lookUpRows(Connection& connection, uint64_t rowCount, bool typed)
+{
+    std::mt19937_64 random(1);
+    std::ostringstream output;
+    Row row;
+    uint64_t found = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < LOOKUP_COUNT; i++)
+    {
+        uint64_t id = random() % rowCount + 1;
+        if (typed)
+        {
+            found += connection.get(id, row) == ExecuteResult::EXECUTE_SUCCESS;
+        }
+        else
+        {
+            output.str(std::string());
+            connection.exec("select where id = " + std::to_string(id), output);
+            found += output.tellp() > 0;
+        }
+    }
+    double perSecond = LOOKUP_COUNT / secondsSince(start);
+    if (found != LOOKUP_COUNT)
+    {
+        std::cerr << "Only " << found << " of " << LOOKUP_COUNT << " keys were found" << std::endl;
+    }
+    return perSecond;
+}
+
+// Scan ranges of SCAN_ROWS keys that start at random keys, return rows per second
+static double scanRows(Connection& connection, uint64_t rowCount, bool typed)
+{
+    std::mt19937_64 random(2);
+    std::ostringstream output;
+    uint64_t usernameBytes = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < SCAN_COUNT; i++)
+    {
+        uint64_t low = random() % (rowCount - SCAN_ROWS + 1) + 1;
+        uint64_t high = low + SCAN_ROWS - 1;
+        if (typed)
+        {
+            connection.scan(low, high, [&usernameBytes](const RowView& row) {
+                usernameBytes += row.username().size();
+                return true;
+            });
+        }
+        else
+        {
+            output.str(std::string());
+            connection.exec("select username where id between " + std::to_string(low) + " and " + 
+                            std::to_string(high), output);
+            usernameBytes += output.tellp();
+        }
+    }
+    double perSecond = SCAN_COUNT * SCAN_ROWS / secondsSince(start);
+    if (usernameBytes == 0)
+    {
+        std::cerr << "Scans found no rows" << std::endl;
+    }
+    return perSecond;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = std::max<uint64_t>(argc > 1 ? std::stoull(argv[1]) : 1000000, SCAN_ROWS);
+
+    const std::string filename = "bench_connection.db";
+    double inserts[2], lookups[2], scans[2];
+    for (int typed = 0; typed < 2; typed++)
+    {
+        DeleteFileA(filename.c_str());
+        std::unique_ptr<Connection> connection = Connection::open(filename);
+        inserts[typed] = insertRows(*connection, rowCount, typed);
+        connection->openTable("bench");
+        lookups[typed] = lookUpRows(*connection, rowCount, typed);
+        scans[typed] = scanRows(*connection, rowCount, typed);
+        connection->close();
+    }
+    DeleteFileA(filename.c_str());
+
+    std::cout << "Rows:                  " << rowCount << std::endl;
+    std::cout << "Text inserts:          " << inserts[0] << " rows/s" << std::endl;
+    std::cout << "Typed inserts:         " << inserts[1] << " rows/s (" << inserts[1] / inserts[0] 
+              << "x)" << std::endl;
+    std::cout << "Text lookups:          " << lookups[0] << " lookups/s" << std::endl;
+    std::cout << "Typed lookups:         " << lookups[1] << " lookups/s (" << lookups[1] / lookups[0] 
+              << "x)" << std::endl;
+    std::cout << "Text scans:            " << scans[0] << " rows/s (" << SCAN_ROWS 
+              << " rows per scan)" << std::endl;
+    std::cout << "Typed scans:           " << scans[1] << " rows/s (" << scans[1] / scans[0] 
+              << "x)" << std::endl;
+
+    return 0;
+}
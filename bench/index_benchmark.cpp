@@ -0,0 +1,118 @@
+// Compares a lookup by email through the secondary index with a full table scan.
+// Usage: bench_index [row count], 1000000 rows by default
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "../includes/data.h"
+#include "../includes/index.h"
+#include "../includes/catalog.h"
+
+static void fillRow(Row* row, uint64_t id)
+{
+    std::string idStr = std::to_string(id);
+    row->keyType = KEY_INTEGER;
+    row->key = { 0, id };
+    strcpy_s(row->username, ("user" + idStr).c_str());
+    strcpy_s(row->email, ("user" + idStr + "@example.com").c_str());
+    row->value.clear();
+}
+
+// Same comparison select does when the column has no index
+static size_t scanLookup(std::shared_ptr<Table>& table, const std::string& email)
+{
+    size_t found = 0;
+    Row row;
+    std::unique_ptr<Cursor> cursor = tableStart(table);
+    while (!(cursor->endOfTable))
+    {
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source))
+        {
+            deserializeRow(source, &row);
+            if (email == row.email)
+                found++;
+        }
+        (*cursor)++;
+    }
+    return found;
+}
+
+static size_t indexedLookup(std::shared_ptr<Table>& table, const std::string& email)
+{
+    size_t found = 0;
+    Row row;
+    for (const Key& key : indexLookup(table->indexes[INDEX_EMAIL], INDEX_EMAIL, email))
+    {
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+        deserializeRow(cursorValue(cursor), &row);
+        found++;
+    }
+    return found;
+}
+
+int main(int argc, char** argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    const std::string filename = "bench_index.db";
+    DeleteFileA(filename.c_str());
+
+    std::shared_ptr<Table> catalog = openDatabase(filename);
+    std::shared_ptr<Table> table = createTable(catalog, "bench", KEY_INTEGER);
+    createIndex(table, INDEX_EMAIL);
+
+    Clock::time_point start = Clock::now();
+    Row row;
+    {
+        TableWriter writer(table);
+        for (uint64_t id = 1; id <= rowCount; id++)
+        {
+            fillRow(&row, id);
+            std::unique_ptr<Cursor> cursor = tableFindKey(table, row.key);
+            leafInsert(cursor, &row);
+            indexInsertRow(table, &row);
+        }
+    }
+    double insertSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> ids(1, rowCount);
+    const int scanLookups = 5;
+    const int indexLookups = 10000;
+
+    start = Clock::now();
+    size_t found = 0;
+    for (int i = 0; i < scanLookups; i++)
+    {
+        found += scanLookup(table, "user" + std::to_string(ids(random)) + "@example.com");
+    }
+    double scanSeconds = std::chrono::duration<double>(Clock::now() - start).count() / scanLookups;
+
+    start = Clock::now();
+    for (int i = 0; i < indexLookups; i++)
+    {
+        found += indexedLookup(table, "user" + std::to_string(ids(random)) + "@example.com");
+    }
+    double indexSeconds = std::chrono::duration<double>(Clock::now() - start).count() / indexLookups;
+
+    if (found != scanLookups + indexLookups)
+    {
+        std::cerr << "Lookups found " << found << " rows, expected "
+                  << scanLookups + indexLookups << std::endl;
+        return 1;
+    }
+
+    std::cout << "Rows:                  " << rowCount << std::endl;
+    std::cout << "Insert with index:     " << insertSeconds << " s" << std::endl;
+    std::cout << "Scan lookup:           " << scanSeconds * 1e6 << " us" << std::endl;
+    std::cout << "Index lookup:          " << indexSeconds * 1e6 << " us" << std::endl;
+    std::cout << "Speedup:               " << scanSeconds / indexSeconds << "x" << std::endl;
+
+    saveAndCloseDatabase(catalog);
+    DeleteFileA(filename.c_str());
+
+    return 0;
+}
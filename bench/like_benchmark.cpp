@@ -0,0 +1,120 @@
+// Compares rows per second of "select where email like" scans, which match the
+// serialized column in place, with a scan that deserializes every row and
+// searches its email with strstr. Printed rows go to a discarding stream.
+// Usage: bench_like [row count], 300000 rows by default, so the table fits into the page cache
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+#include "../includes/statement.h"
+#include "../includes/tablecache.h"
+
+using Clock = std::chrono::steady_clock;
+
+const uint32_t SCAN_REPEATS = 10;
+const uint64_t DEPARTMENT_COUNT = 100;
+
+// Drops everything written to it
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Run a select a few times, return rows scanned per second
+static double likeScan(TableCache& tables, const std::string& text, uint64_t rowCount)
+{
+    Statement select;
+    select.prepareStatement(text);
+
+    NullBuffer nullBuffer;
+    std::streambuf* previous = std::cout.rdbuf(&nullBuffer);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < SCAN_REPEATS; i++)
+    {
+        select.executeStatement(tables);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout.rdbuf(previous);
+
+    return rowCount * SCAN_REPEATS / seconds;
+}
+
+// Copy every row out of its page and search the email with strstr,
+// return rows scanned per second
+static double naiveScan(std::shared_ptr<Table>& table, const char* needle, uint64_t rowCount)
+{
+    Snapshot snapshot;
+    NullBuffer nullBuffer;
+    std::streambuf* previous = std::cout.rdbuf(&nullBuffer);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < SCAN_REPEATS; i++)
+    {
+        Row row;
+        for (std::unique_ptr<Cursor> cursor = tableStart(table); !cursor->endOfTable; (*cursor)++)
+        {
+            void* source = cursorValue(cursor);
+            if (isRowDeleted(source))
+            {
+                continue;
+            }
+            deserializeRow(source, &row);
+            if (strstr(row.email, needle) != nullptr)
+            {
+                printRow(&row);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout.rdbuf(previous);
+
+    return rowCount * SCAN_REPEATS / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 300000;
+
+    const std::string filename = "bench_like.db";
+    DeleteFileA(filename.c_str());
+    TableCache tables(filename);
+
+    Statement create;
+    create.prepareStatement("create table bench");
+    create.executeStatement(tables);
+    for (uint64_t first = 1; first <= rowCount; first += 1000)
+    {
+        std::string text = "insert ";
+        uint64_t last = std::min(rowCount, first + 999);
+        for (uint64_t id = first; id <= last; id++)
+        {
+            std::string idStr = std::to_string(id);
+            text += "(" + idStr + " user" + idStr + " firstname.lastname" + idStr + "@department" + 
+                    std::to_string(id % DEPARTMENT_COUNT) + ".example.com" + (id < last ? "), " : ")");
+        }
+
+        Statement insert;
+        insert.prepareStatement(text);
+        insert.executeStatement(tables);
+    }
+
+    std::shared_ptr<Table> table = tables.get("bench");
+    double suffix = likeScan(tables, "select id where email like %@department7.example.com", rowCount);
+    double substring = likeScan(tables, "select id where email like %department7.%", rowCount);
+    double naive = naiveScan(table, "department7.", rowCount);
+
+    tables.closeAll();
+    DeleteFileA(filename.c_str());
+
+    std::cout << "Rows:               " << rowCount << std::endl;
+    std::cout << "Like suffix:        " << suffix << " rows/s" << std::endl;
+    std::cout << "Like substring:     " << substring << " rows/s" << std::endl;
+    std::cout << "Naive strstr:       " << naive << " rows/s" << std::endl;
+    std::cout << "Substring speedup:  " << substring / naive << "x" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+// Measures how many statements per second prepareStatement() parses, without
+// executing them. Usage: bench_parse [statement count], 1000000 by default
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../includes/statement.h"
+
+int main(int argc, char** argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    const std::vector<std::pair<std::string, std::string>> statements = {
+        { "insert", "insert 123456 user123456 user123456@example.com some value with spaces" },
+        { "insert into", "insert into users 123456 user123456 user123456@example.com" },
+        { "update", "update users 123456 user123456 user123456@example.com new value" },
+        { "delete", "delete from users 123456" },
+        { "select range", "select where id between 1000 and 2000 order by id desc limit 10 offset 5" },
+        { "select where", "select count(*) from users where email = user123456@example.com" },
+    };
+
+    uint64_t failed = 0;
+    for (const auto& [name, text] : statements)
+    {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < count; i++)
+        {
+            Statement statement;
+            if (statement.prepareStatement(text) != PrepareResult::PREPARE_SUCCESS)
+            {
+                failed++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << name << ":" << std::string(22 - name.size(), ' ')
+                  << count / seconds / 1e6 << " M statements/s" << std::endl;
+    }
+
+    if (failed > 0)
+    {
+        std::cerr << failed << " statements failed to parse" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Compares inserts parsed from text every time with a prepared insert executed
+// with bound values, and with inserts of many rows per statement. Then compares
+// prepared inserts that commit and flush the file every row with inserts
+// batched into transactions. Usage: bench_prepared [row count], 1000000 rows by default
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../includes/statement.h"
+#include "../includes/tablecache.h"
+
+enum class InsertMode { AD_HOC, PREPARED, MULTI_ROW, DURABLE, TRANSACTION };
+
+const uint64_t ROWS_PER_STATEMENT = 1000;
+const uint64_t ROWS_PER_TRANSACTION = 10000;
+
+// Every durable insert flushes the file, so they run on fewer rows
+const uint64_t MAX_DURABLE_ROWS = 10000;
+
+// Insert rows in key order into a new table, return inserts per second
+static double insertRows(uint64_t rowCount, InsertMode mode)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const std::string filename = "bench_prepared.db";
+    DeleteFileA(filename.c_str());
+
+    TableCache tables(filename);
+    Statement create;
+    create.prepareStatement("create table bench");
+    create.executeStatement(tables);
+
+    Statement insert;
+    insert.prepareStatement("insert ? ? ? ?");
+    Statement begin;
+    begin.prepareStatement("begin");
+    Statement commit;
+    commit.prepareStatement("commit");
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t id = 1; id <= rowCount; id++)
+    {
+        std::string idStr = std::to_string(id);
+        ExecuteResult result;
+        if (mode == InsertMode::MULTI_ROW)
+        {
+            // Rows of a statement are parsed with it, like ad-hoc inserts
+            std::string text = "insert ";
+            uint64_t last = std::min(rowCount, id + ROWS_PER_STATEMENT - 1);
+            for (; id <= last; id++)
+            {
+                idStr = std::to_string(id);
+                text += "(" + idStr + " user" + idStr + " user" + idStr + "@example.com value " + 
+                        idStr + (id < last ? "), " : ")");
+            }
+            id--;
+
+            Statement statement;
+            statement.prepareStatement(text);
+            result = statement.executeStatement(tables);
+        }
+        else if (mode == InsertMode::AD_HOC)
+        {
+            Statement statement;
+            statement.prepareStatement("insert " + idStr + " user" + idStr + " user" + idStr +
+                                       "@example.com value " + idStr);
+            result = statement.executeStatement(tables);
+        }
+        else
+        {
+            // Durable inserts are transactions of one row
+            bool transaction = mode == InsertMode::DURABLE || mode == InsertMode::TRANSACTION;
+            if (transaction && (mode == InsertMode::DURABLE || id % ROWS_PER_TRANSACTION == 1))
+            {
+                begin.executeStatement(tables);
+            }
+
+            insert.bindKey(1, { 0, id }, KEY_INTEGER);
+            insert.bindText(2, "user" + idStr);
+            insert.bindText(3, "user" + idStr + "@example.com");
+            insert.bindText(4, "value " + idStr);
+            result = insert.executeStatement(tables);
+
+            if (transaction && (mode == InsertMode::DURABLE || id % ROWS_PER_TRANSACTION == 0 || 
+                                id == rowCount))
+            {
+                commit.executeStatement(tables);
+            }
+        }
+
+        if (result != ExecuteResult::EXECUTE_SUCCESS)
+        {
+            std::cerr << "Insert of row " << id << " failed" << std::endl;
+            break;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    tables.closeAll();
+    DeleteFileA(filename.c_str());
+
+    return rowCount / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    double adHoc = insertRows(rowCount, InsertMode::AD_HOC);
+    double prepared = insertRows(rowCount, InsertMode::PREPARED);
+    double multiRow = insertRows(rowCount, InsertMode::MULTI_ROW);
+    uint64_t durableRowCount = std::min(rowCount, MAX_DURABLE_ROWS);
+    double durable = insertRows(durableRowCount, InsertMode::DURABLE);
+    double transaction = insertRows(rowCount, InsertMode::TRANSACTION);
+
+    std::cout << "Rows:                  " << rowCount << std::endl;
+    std::cout << "Ad-hoc inserts:        " << adHoc << " rows/s" << std::endl;
+    std::cout << "Prepared inserts:      " << prepared << " rows/s" << std::endl;
+    std::cout << "Multi-row inserts:     " << multiRow << " rows/s (" << ROWS_PER_STATEMENT 
+              << " rows per statement)" << std::endl;
+    std::cout << "Prepared speedup:      " << prepared / adHoc << "x" << std::endl;
+    std::cout << "Multi-row speedup:     " << multiRow / adHoc << "x" << std::endl;
+    std::cout << "Durable inserts:       " << durable << " rows/s (one commit per row, " 
+              << durableRowCount << " rows)" << std::endl;
+    std::cout << "Transaction inserts:   " << transaction << " rows/s (" << ROWS_PER_TRANSACTION 
+              << " rows per commit)" << std::endl;
+    std::cout << "Transaction speedup:   " << transaction / durable << "x" << std::endl;
+
+    return 0;
+}
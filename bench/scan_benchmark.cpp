@@ -0,0 +1,94 @@
+// Measures rows per second of full scans filtered by an unindexed column, on all
+// hardware threads and on one thread, and of scans that print one column of every row.
+// Printed rows go to a discarding stream.
+// Usage: bench_scan [row count], 1000000 rows by default
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+#include "../includes/statement.h"
+#include "../includes/tablecache.h"
+
+using Clock = std::chrono::steady_clock;
+
+const uint32_t SCAN_REPEATS = 10;
+
+// Drops everything written to it
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Run a select a few times, return rows scanned per second
+static double scanRows(TableCache& tables, const std::string& text, uint64_t rowCount)
+{
+    Statement select;
+    select.prepareStatement(text);
+
+    NullBuffer nullBuffer;
+    std::streambuf* previous = std::cout.rdbuf(&nullBuffer);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < SCAN_REPEATS; i++)
+    {
+        select.executeStatement(tables);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout.rdbuf(previous);
+
+    return rowCount * SCAN_REPEATS / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    const std::string filename = "bench_scan.db";
+    DeleteFileA(filename.c_str());
+    TableCache tables(filename);
+
+    Statement create;
+    create.prepareStatement("create table bench");
+    create.executeStatement(tables);
+    for (uint64_t first = 1; first <= rowCount; first += 1000)
+    {
+        std::string text = "insert ";
+        uint64_t last = std::min(rowCount, first + 999);
+        for (uint64_t id = first; id <= last; id++)
+        {
+            std::string idStr = std::to_string(id);
+            text += "(" + idStr + " user" + idStr + " user" + idStr + "@example.com value " + 
+                    idStr + (id < last ? "), " : ")");
+        }
+
+        Statement insert;
+        insert.prepareStatement(text);
+        insert.executeStatement(tables);
+    }
+
+    std::string lastEmail = "user" + std::to_string(rowCount) + "@example.com";
+    double filtered = scanRows(tables, "select where email = " + lastEmail, rowCount);
+
+    // A select with a limit is scanned by one thread
+    double oneThread = scanRows(tables, "select where email = " + lastEmail + " limit " + 
+                                std::to_string(rowCount), rowCount);
+    double projected = scanRows(tables, "select username", rowCount);
+    double whole = scanRows(tables, "select", rowCount);
+
+    tables.closeAll();
+    DeleteFileA(filename.c_str());
+
+    std::cout << "Rows:              " << rowCount << std::endl;
+    std::cout << "Filtered scan:     " << filtered << " rows/s (one matching row, " 
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << "One-thread scan:   " << oneThread << " rows/s" << std::endl;
+    std::cout << "Parallel speedup:  " << filtered / oneThread << "x" << std::endl;
+    std::cout << "Projected scan:    " << projected << " rows/s (username of every row)" << std::endl;
+    std::cout << "Whole-row scan:    " << whole << " rows/s" << std::endl;
+
+    return 0;
+}
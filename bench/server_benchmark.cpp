@@ -0,0 +1,156 @@
+// Measures a server on a Unix domain socket with 1 to 256 connected clients.
+// Every client runs on its own thread and sends binary point selects of random keys, 
+// each one after the response of the previous one, then one client sends them
+// with many requests in flight. Prints requests per second and latency percentiles.
+// Usage: bench_server [row count] [seconds per run], 100000 rows and 2 seconds by default
+#include "../includes/server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../includes/database.h"
+
+using Clock = std::chrono::steady_clock;
+
+const char* SOCKET_PATH = "bench_server.sock";
+const uint32_t MAX_CONNECTIONS = 256;
+const uint32_t PIPELINE_DEPTH = 16;
+
+struct RunResult
+{
+    double requestsPerSecond;
+    std::vector<double> latencies; // microseconds, sorted
+};
+
+static std::string pointSelect(std::mt19937_64& random, uint64_t rowCount)
+{
+    return "select where id = " + std::to_string(random() % rowCount + 1);
+}
+
+// Send requests until the time is up, keep "depth" of them in flight
+static void runClient(uint64_t rowCount, double seconds, uint32_t depth, uint32_t seed,
+                      std::vector<double>& latencies)
+{
+    ServerConnection connection(SOCKET_PATH);
+    connection.request("open table bench");
+
+    std::mt19937_64 random(seed);
+    std::vector<Clock::time_point> sent;
+    ServerResponse response;
+    Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(seconds));
+    size_t received = 0;
+    while (true)
+    {
+        bool running = Clock::now() < end;
+        while (running && sent.size() - received < depth)
+        {
+            sent.push_back(Clock::now());
+            connection.sendRequest(pointSelect(random, rowCount), RequestKind::REQUEST_BINARY);
+        }
+        if (received == sent.size() || !connection.receiveResponse(response))
+        {
+            break;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent[received]).count());
+        received++;
+    }
+}
+
+static RunResult runClients(uint64_t rowCount, double seconds, uint32_t connections, uint32_t depth)
+{
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<std::thread> clients;
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < connections; i++)
+    {
+        clients.emplace_back(runClient, rowCount, seconds, depth, i + 1, std::ref(latencies[i]));
+    }
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    RunResult result;
+    for (std::vector<double>& clientLatencies : latencies)
+    {
+        result.latencies.insert(result.latencies.end(), clientLatencies.begin(), clientLatencies.end());
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    result.requestsPerSecond = result.latencies.size() / elapsed;
+    return result;
+}
+
+static double percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+static void printResult(const std::string& label, const RunResult& result)
+{
+    std::cout << label << result.requestsPerSecond << " requests/s, p50 " 
+              << percentile(result.latencies, 0.5) << " us, p99 " 
+              << percentile(result.latencies, 0.99) << " us, p99.9 " 
+              << percentile(result.latencies, 0.999) << " us" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 100000;
+    double seconds = argc > 2 ? std::stod(argv[2]) : 2;
+
+    const std::string filename = "bench_server.db";
+    DeleteFileA(filename.c_str());
+    char program[] = "bench_server";
+    char serveOption[] = "--serve";
+    std::string socketPath = SOCKET_PATH;
+    std::string file = filename;
+    char* databaseArguments[] = { program, serveOption, socketPath.data(), file.data() };
+
+    Database database(4, databaseArguments);
+    Server server(database, SOCKET_PATH);
+    std::thread serving([&server]() { server.run(); });
+
+    {
+        ServerConnection connection(SOCKET_PATH);
+        connection.request("create table bench");
+        for (uint64_t first = 1; first <= rowCount; first += 1000)
+        {
+            std::string insert = "insert ";
+            uint64_t last = std::min(rowCount, first + 999);
+            for (uint64_t id = first; id <= last; id++)
+            {
+                std::string idStr = std::to_string(id);
+                insert += "(" + idStr + " user" + idStr + " user" + idStr + "@example.com value " +
+                          idStr + (id < last ? "), " : ")");
+            }
+            connection.request(insert);
+        }
+    }
+
+    std::cout << "Rows:                  " << rowCount << std::endl;
+    for (uint32_t connections = 1; connections <= MAX_CONNECTIONS; connections *= 2)
+    {
+        std::string label = std::to_string(connections) + " connections:";
+        label.resize(std::max<size_t>(label.size() + 1, 23), ' ');
+        printResult(label, runClients(rowCount, seconds, connections, 1));
+    }
+    printResult("Pipelined, 1 client:  ", runClients(rowCount, seconds, 1, PIPELINE_DEPTH));
+    std::cout << "(" << PIPELINE_DEPTH << " requests in flight)" << std::endl;
+
+    server.stop();
+    serving.join();
+    DeleteFileA(filename.c_str());
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Measures rows per second of exporting a table to CSV and binary files and
+// of importing them into new tables. Usage: bench_transfer [row count], 1000000 by default
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../includes/statement.h"
+#include "../includes/tablecache.h"
+#include "../includes/transfer.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double rowsPerSecond(uint64_t rowCount, Clock::time_point start)
+{
+    return rowCount / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t rowCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    const std::string filename = "bench_transfer.db";
+    DeleteFileA(filename.c_str());
+    TableCache tables(filename);
+
+    Statement create;
+    create.prepareStatement("create table bench");
+    create.executeStatement(tables);
+    for (uint64_t first = 1; first <= rowCount; first += 1000)
+    {
+        std::string text = "insert ";
+        uint64_t last = std::min(rowCount, first + 999);
+        for (uint64_t id = first; id <= last; id++)
+        {
+            std::string idStr = std::to_string(id);
+            text += "(" + idStr + " user" + idStr + " user" + idStr + "@example.com value " + 
+                    idStr + (id < last ? "), " : ")");
+        }
+
+        Statement insert;
+        insert.prepareStatement(text);
+        insert.executeStatement(tables);
+    }
+
+    std::shared_ptr<Table> table = tables.get("bench");
+    std::cout << "Rows:          " << rowCount << std::endl;
+    for (TransferFormat format : { TransferFormat::TRANSFER_CSV, TransferFormat::TRANSFER_BINARY })
+    {
+        bool csv = format == TransferFormat::TRANSFER_CSV;
+        std::string exportFilename = csv ? "bench_transfer.csv" : "bench_transfer.bin";
+        uint64_t transferred;
+
+        Clock::time_point start = Clock::now();
+        exportTable(table, exportFilename, format, transferred);
+        std::cout << (csv ? "CSV export:    " : "Binary export: ")
+                  << rowsPerSecond(transferred, start) << " rows/s" << std::endl;
+
+        std::string tableName = csv ? "csv" : "binary";
+        Statement createImport;
+        createImport.prepareStatement("create table " + tableName);
+        createImport.executeStatement(tables);
+        std::shared_ptr<Table> imported = tables.get(tableName);
+
+        start = Clock::now();
+        if (importTable(imported, exportFilename, format, transferred) != TransferResult::TRANSFER_SUCCESS)
+        {
+            std::cerr << "Import of " << exportFilename << " failed" << std::endl;
+        }
+        std::cout << (csv ? "CSV import:    " : "Binary import: ")
+                  << rowsPerSecond(transferred, start) << " rows/s" << std::endl;
+        DeleteFileA(exportFilename.c_str());
+    }
+
+    table.reset();
+    tables.closeAll();
+    DeleteFileA(filename.c_str());
+    return 0;
+}
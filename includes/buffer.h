@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sys/types.h>
 #include <memory>
@@ -9,20 +10,53 @@
 
 #include "constants.h"
 
+// Lines typed into the console, or lines of a script or of piped input.
+// Scripts are read in large blocks and the lines are cut out of the block
 class InputBuffer
 {
 private:
     std::string buffer;
     size_t inputLength;
 
+    std::istream* batchInput; // nullptr for the console
+    std::string block;
+    size_t blockPosition;
+
+    bool readBatchLine();
+    void trimInput();
+
 public:
     InputBuffer();
+    explicit InputBuffer(std::istream* batchInput);
 
-    void readInput();
+    bool readInput();
     void readInputTest(std::vector<std::string> &commands);
+    void setInput(std::string_view line);
 
-    const std::string getBuffer() const;
+    const std::string& getBuffer() const;
     const size_t getLength() const;
 };
 
-void printPrompt();
\ No newline at end of file
+// Output of batch mode. It takes the place of the buffer of a stream and collects
+// the output in a large buffer, which is written when it fills up or on flush(). 
+// Lines ending with std::endl are not written one by one. The old buffer
+// of the stream is put back when it's destroyed
+class OutputBuffer : public std::streambuf
+{
+private:
+    std::ostream& stream;
+    std::streambuf* target;
+    std::vector<char> data;
+
+protected:
+    int overflow(int c) override;
+    int sync() override;
+
+public:
+    OutputBuffer(std::ostream& stream, size_t size);
+    ~OutputBuffer();
+
+    void flush();
+};
+
+void printPrompt();
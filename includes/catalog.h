@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "data.h"
+
+
+//------------------------------------------------------------------------
+// A database file holds many B-trees. The catalog is a composite key B-tree
+// rooted at page 1 with a row for every table and index, like sqlite_master.
+// Keys are (hash of the name, root page), rows hold the kind of the B-tree,
+// its name and the statement that created it
+//------------------------------------------------------------------------
+
+const char CATALOG_TABLE[] = "table";
+const char CATALOG_INDEX[] = "index";
+
+std::shared_ptr<Table> openDatabase(std::string filename);
+
+uint32_t catalogFind(std::shared_ptr<Table>& catalog, const char* type, const std::string& name);
+void catalogInsert(std::shared_ptr<Table>& catalog, const char* type, const std::string& name,
+                   uint32_t rootPageNumber, const std::string& schema);
+void catalogDelete(std::shared_ptr<Table>& catalog, const char* type, const std::string& name);
+std::vector<std::string> catalogList(std::shared_ptr<Table>& catalog, const char* type);
+
+uint32_t createTree(const std::shared_ptr<Pager>& pager, KeyType keyType);
+void releaseTree(const std::shared_ptr<Pager>& pager, uint32_t pageNumber);
+
+std::shared_ptr<Table> createTable(std::shared_ptr<Table>& catalog, const std::string& name,
+                                   KeyType keyType);
+std::shared_ptr<Table> openTable(std::shared_ptr<Table>& catalog, const std::string& name);
+bool dropTable(std::shared_ptr<Table>& catalog, const std::string& name);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "constants.h"
+#include "data.h"
+#include "statement.h"
+#include "tablecache.h"
+
+
+//------------------------------------------------------------------------
+// Database file opened by a program that embeds the engine instead of
+// running the console. Typed calls go straight to the B-tree of the opened
+// table: nothing is parsed or printed, rows come back as Row structs or as
+// views into their pages, and every error is a result code. exec() runs any
+// statement given as text. A connection keeps the tables of its file open
+// like the console does and is used by one thread at a time
+//------------------------------------------------------------------------
+
+// Row in its leaf page during a scan. Its username and email point into the
+// page, they are valid until the visitor returns
+class RowView
+{
+private:
+    const std::shared_ptr<Pager>& pager;
+    void* source;
+
+public:
+    RowView(const std::shared_ptr<Pager>& pager, void* source);
+
+    uint64_t id() const;
+    Key key() const;
+    std::string_view username() const;
+    std::string_view email() const;
+    std::string value() const; // read from overflow pages when it spills
+    void copyTo(Row& row) const;
+};
+
+class Connection
+{
+private:
+    TableCache tables;
+
+    explicit Connection(const std::string& filename);
+
+    ExecuteResult getIntegerTable(std::shared_ptr<Table>& table);
+
+public:
+    static std::unique_ptr<Connection> open(const std::string& filename);
+    ~Connection();
+
+    ExecuteResult exec(std::string_view text, std::ostream& output = std::cout);
+    ExecuteResult exec(Statement& statement, std::ostream& output = std::cout);
+
+    ExecuteResult openTable(const std::string& name);
+    ExecuteResult begin();
+    ExecuteResult commit();
+    ExecuteResult rollback();
+
+    // Rows of the opened table by integer key
+    ExecuteResult insert(uint64_t id, std::string_view username, std::string_view email,
+                         std::string_view value = {});
+    ExecuteResult get(uint64_t id, Row& row);
+    ExecuteResult scan(uint64_t low, uint64_t high, const std::function<bool(const RowView&)>& visit);
+    ExecuteResult scan(uint64_t low, uint64_t high, std::vector<Row>& rows);
+
+    void close();
+};
@@ -1,32 +1,114 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 #define COLUMN_USERNAME_SIZE 32
 #define COLUMN_EMAIL_SIZE 255
 #define size_of_attribute(Struct, Attribute) sizeof(((Struct*)0)->Attribute)
-#define TABLE_MAX_PAGES 500
+#define TABLE_MAX_PAGES 1048576
 #define INVALID_PAGE_NUM UINT32_MAX
 
+// KEY STRUCTURE
+// Integer keys only use id, composite keys are ordered by (prefix, id)
+typedef enum : uint8_t { KEY_INTEGER, KEY_COMPOSITE } KeyType;
+
+typedef struct Key
+{
+	uint64_t prefix;
+	uint64_t id;
+
+	bool operator==(const Key&) const = default;
+	auto operator<=>(const Key&) const = default;
+} Key;
+
+const Key MIN_KEY = { 0, 0 };
+const Key MAX_KEY = { UINT64_MAX, UINT64_MAX };
+
 // ROW STRUCTURE
 typedef struct
 {
-	uint32_t id;
+	KeyType keyType;
+	Key key;
 	char username[COLUMN_USERNAME_SIZE + 1];
 	char email[COLUMN_EMAIL_SIZE + 1];
+	std::string value; // large values spill into overflow pages
 } Row;
 
+// INDEX STRUCTURE
+// Columns that can have a secondary index
+typedef enum : uint8_t { INDEX_USERNAME, INDEX_EMAIL, INDEX_COUNT } IndexColumn;
+
+// SELECT STRUCTURE
+// Columns that a select can print
+typedef enum : uint8_t { COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL, COLUMN_VALUE } RowColumn;
+// Rows and counts of a select are printed as text or written as records of the binary protocol
+typedef enum : uint8_t { OUTPUT_TEXT, OUTPUT_BINARY } OutputFormat;
+
 // PAGER CONSTANTS
 const uint32_t PAGE_SIZE = 4096;
+const uint32_t PAGER_FRAME_GROUP_SIZE = 1024; // cache frames allocated at once
+const uint32_t PAGER_FRAME_GROUP_COUNT = TABLE_MAX_PAGES / PAGER_FRAME_GROUP_SIZE;
+const uint32_t TABLE_CACHE_MAX_PAGES = 16384; // cached pages of the database file
+const uint32_t TABLE_CACHE_MAX_TABLES = 1024; // open table handles
+
+// SELECT CONSTANTS
+const uint32_t SELECT_BATCH_ROWS = 1024; // rows passed between operators of a select at once
+
+// PARALLEL SCAN CONSTANTS
+// Scans of a where condition without an index are split into key ranges of about
+// the same number of rows, more ranges than threads so threads that finish early take more
+const uint64_t PARALLEL_SCAN_MIN_ROWS = 65536; // smaller tables are scanned by one thread
+const uint32_t PARALLEL_SCAN_MAX_THREADS = 16;
+const uint32_t PARALLEL_SCAN_RANGES_PER_THREAD = 4;
+const uint32_t PARALLEL_SCAN_BUFFERED_RANGES_PER_THREAD = 2; // ranges started ahead of the printed ones
+
+// SERVER CONSTANTS
+// Requests and responses are frames of a 4-byte little-endian length followed by
+// their bytes. A request starts with its kind, then the text of one statement or
+// meta command. A text response is the output the console would print, a binary
+// response starts with its status, result code and payload kind
+const uint32_t SERVER_FRAME_HEADER_SIZE = 4;
+const uint32_t SERVER_REQUEST_HEADER_SIZE = 1;
+const uint32_t SERVER_RESPONSE_HEADER_SIZE = 3;
+const uint32_t SERVER_MAX_REQUEST_SIZE = 64 << 20; // larger requests close the connection
+const uint32_t SERVER_MAX_PENDING_OUTPUT = 4 << 20; // requests wait while a client doesn't read this much
+const uint32_t SERVER_RECEIVE_SIZE = 64 << 10; // bytes read from a connection at once
+const int SERVER_POLL_TIMEOUT_MS = 100; // how often the server checks if it should stop
+const int SERVER_BACKLOG = 256;
+
+// BATCH MODE CONSTANTS
+const uint32_t INPUT_BLOCK_SIZE = 1 << 20; // bytes of a script read at once
+const uint32_t OUTPUT_BUFFER_SIZE = 1 << 20; // bytes of output written at once
+
+// IMPORT AND EXPORT CONSTANTS
+// Binary exports start with a magic string, then every row is stored like in a leaf,
+// with the whole value after its length instead of an overflow page
+const uint32_t IMPORT_BATCH_ROWS = 10000; // rows inserted at once by an import
+const uint32_t IMPORT_MAX_VALUE_SIZE = 64 << 20; // longer values of a binary file fail the import
+const char EXPORT_MAGIC[] = "SQLite-CPP rows";
+const uint32_t EXPORT_MAGIC_SIZE = 16;
 
 // TABLE CONSTANTS
-const uint32_t ID_SIZE = size_of_attribute(Row, id);
-const uint32_t USERNAME_SIZE = size_of_attribute(Row, username);
-const uint32_t EMAIL_SIZE = size_of_attribute(Row, email);
-const uint32_t ID_OFFSET = 0;
-const uint32_t USERNAME_OFFSET = ID_OFFSET + ID_SIZE;
-const uint32_t EMAIL_OFFSET = USERNAME_OFFSET + USERNAME_SIZE;
-const uint32_t ROW_SIZE = ID_SIZE + USERNAME_SIZE + EMAIL_SIZE;
+// Rows are stored variable-length: flags, key, then each string prefixed with 
+// its length, then the value length, an inline prefix of the value and 
+// the first overflow page if the value doesn't fit into the prefix
+const uint32_t ROW_FLAGS_SIZE = sizeof(uint8_t);
+const uint32_t ROW_FLAGS_OFFSET = 0;
+const uint8_t ROW_FLAG_DELETED = 1 << 0;
+const uint8_t ROW_FLAG_COMPOSITE_KEY = 1 << 1;
+const uint32_t KEY_INTEGER_SIZE = sizeof(uint64_t);
+const uint32_t KEY_COMPOSITE_SIZE = 2 * sizeof(uint64_t);
+const uint32_t ROW_KEY_OFFSET = ROW_FLAGS_OFFSET + ROW_FLAGS_SIZE;
+const uint32_t STRING_LENGTH_SIZE = sizeof(uint8_t);
+const uint32_t VALUE_LENGTH_SIZE = sizeof(uint32_t);
+const uint32_t VALUE_INLINE_SIZE = 128;
+const uint32_t VALUE_OVERFLOW_PAGE_SIZE = sizeof(uint32_t);
+const uint32_t ROW_MIN_SIZE = ROW_FLAGS_SIZE + KEY_INTEGER_SIZE + 2 * STRING_LENGTH_SIZE + 
+               VALUE_LENGTH_SIZE;
+const uint32_t ROW_MAX_SIZE = ROW_FLAGS_SIZE + KEY_COMPOSITE_SIZE + 2 * STRING_LENGTH_SIZE +
+               VALUE_LENGTH_SIZE + COLUMN_USERNAME_SIZE + COLUMN_EMAIL_SIZE +
+               VALUE_INLINE_SIZE + VALUE_OVERFLOW_PAGE_SIZE;
 
 // NODE CONSTANTS
 // Common Node Header Layout
@@ -36,8 +118,10 @@ const uint32_t IS_ROOT_SIZE = sizeof(uint8_t);
 const uint32_t IS_ROOT_OFFSET = NODE_TYPE_SIZE;
 const uint32_t PARENT_POINTER_SIZE = sizeof(uint32_t);
 const uint32_t PARENT_POINTER_OFFSET = IS_ROOT_OFFSET + IS_ROOT_SIZE;
+const uint32_t KEY_TYPE_SIZE = sizeof(uint8_t);
+const uint32_t KEY_TYPE_OFFSET = PARENT_POINTER_OFFSET + PARENT_POINTER_SIZE;
 const uint8_t COMMON_NODE_HEADER_SIZE = NODE_TYPE_SIZE + IS_ROOT_SIZE + 
-              PARENT_POINTER_SIZE;
+              PARENT_POINTER_SIZE + KEY_TYPE_SIZE;
 
 // Leaf Node Header Layout
 const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
@@ -45,22 +129,33 @@ const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
 const uint32_t LEAF_NODE_NEXT_LEAF_SIZE = sizeof(uint32_t);
 const uint32_t LEAF_NODE_NEXT_LEAF_OFFSET =
     LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE;
+const uint32_t LEAF_NODE_PREV_LEAF_SIZE = sizeof(uint32_t);
+const uint32_t LEAF_NODE_PREV_LEAF_OFFSET =
+    LEAF_NODE_NEXT_LEAF_OFFSET + LEAF_NODE_NEXT_LEAF_SIZE;
+const uint32_t LEAF_NODE_CELL_CONTENT_START_SIZE = sizeof(uint16_t);
+const uint32_t LEAF_NODE_CELL_CONTENT_START_OFFSET =
+    LEAF_NODE_PREV_LEAF_OFFSET + LEAF_NODE_PREV_LEAF_SIZE;
+const uint32_t LEAF_NODE_FRAGMENTED_BYTES_SIZE = sizeof(uint16_t);
+const uint32_t LEAF_NODE_FRAGMENTED_BYTES_OFFSET =
+    LEAF_NODE_CELL_CONTENT_START_OFFSET + LEAF_NODE_CELL_CONTENT_START_SIZE;
 const uint32_t LEAF_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE +
-               LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_NEXT_LEAF_SIZE;
+               LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_NEXT_LEAF_SIZE + LEAF_NODE_PREV_LEAF_SIZE +
+               LEAF_NODE_CELL_CONTENT_START_SIZE + LEAF_NODE_FRAGMENTED_BYTES_SIZE;
 
 // Leaf Node Body Layout
-const uint32_t LEAF_NODE_KEY_SIZE = sizeof(uint32_t);
-const uint32_t LEAF_NODE_KEY_OFFSET = 0;
-const uint32_t LEAF_NODE_VALUE_SIZE = ROW_SIZE;
-const uint32_t LEAF_NODE_VALUE_OFFSET = LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE;
-const uint32_t LEAF_NODE_CELL_SIZE = LEAF_NODE_KEY_SIZE + LEAF_NODE_VALUE_SIZE;
+// A slot directory of 2-byte cell offsets grows from the header towards the end
+// of the page, while length-prefixed cells grow from the end of the page.
+// The key of a cell is read from its serialized row
+const uint32_t LEAF_NODE_SLOT_SIZE = sizeof(uint16_t);
+const uint32_t LEAF_NODE_CELL_LENGTH_SIZE = sizeof(uint16_t);
+const uint32_t LEAF_NODE_CELL_LENGTH_OFFSET = 0;
+const uint32_t LEAF_NODE_VALUE_OFFSET = LEAF_NODE_CELL_LENGTH_OFFSET + LEAF_NODE_CELL_LENGTH_SIZE;
+const uint32_t LEAF_NODE_KEY_OFFSET = LEAF_NODE_VALUE_OFFSET + ROW_KEY_OFFSET;
+const uint32_t LEAF_NODE_CELL_HEADER_SIZE = LEAF_NODE_VALUE_OFFSET;
+const uint32_t LEAF_NODE_MAX_CELL_SIZE = LEAF_NODE_CELL_HEADER_SIZE + ROW_MAX_SIZE;
 const uint32_t LEAF_NODE_SPACE_FOR_CELLS = PAGE_SIZE - LEAF_NODE_HEADER_SIZE;
-const uint32_t LEAF_NODE_MAX_CELLS = LEAF_NODE_SPACE_FOR_CELLS / LEAF_NODE_CELL_SIZE;
-
-// Leaf Node Splitting
-const uint32_t LEAF_NODE_RIGHT_SPLIT_COUNT = (LEAF_NODE_MAX_CELLS + 1) / 2;
-const uint32_t LEAF_NODE_LEFT_SPLIT_COUNT = (LEAF_NODE_MAX_CELLS + 1) -
-               LEAF_NODE_RIGHT_SPLIT_COUNT;
+const uint32_t LEAF_NODE_MAX_CELLS = LEAF_NODE_SPACE_FOR_CELLS / 
+               (LEAF_NODE_SLOT_SIZE + LEAF_NODE_CELL_HEADER_SIZE + ROW_MIN_SIZE);
 
 // Internal Node Header Layout
 const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
@@ -68,13 +163,62 @@ const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
 const uint32_t INTERNAL_NODE_RIGHT_CHILD_SIZE = sizeof(uint32_t);
 const uint32_t INTERNAL_NODE_RIGHT_CHILD_OFFSET = INTERNAL_NODE_NUM_KEYS_OFFSET +
                INTERNAL_NODE_NUM_KEYS_SIZE;
+const uint32_t INTERNAL_NODE_RIGHT_COUNT_SIZE = sizeof(uint64_t);
+const uint32_t INTERNAL_NODE_RIGHT_COUNT_OFFSET = INTERNAL_NODE_RIGHT_CHILD_OFFSET +
+               INTERNAL_NODE_RIGHT_CHILD_SIZE;
 const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE +
-               INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE;
+               INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE +
+               INTERNAL_NODE_RIGHT_COUNT_SIZE;
 
 // Internal Node Body Layout
-const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
+// Cells are a child page number, the number of live rows in the child's subtree
+// and a key of the node's key type
 const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint32_t);
-const uint32_t INTERNAL_NODE_CELL_SIZE = INTERNAL_NODE_CHILD_SIZE +
-               INTERNAL_NODE_KEY_SIZE;
+const uint32_t INTERNAL_NODE_COUNT_SIZE = sizeof(uint64_t);
+const uint32_t INTERNAL_NODE_COUNT_OFFSET = INTERNAL_NODE_CHILD_SIZE;
+const uint32_t INTERNAL_NODE_KEY_OFFSET = INTERNAL_NODE_COUNT_OFFSET + INTERNAL_NODE_COUNT_SIZE;
 const uint32_t INTERNAL_NODE_MAX_CELLS = 3;
 const uint32_t INTERNAL_NODE_MAX_KEYS = 3;
+
+// Overflow Page Layout
+// Part of a large value and the number of the page holding the rest of it
+const uint32_t OVERFLOW_NEXT_PAGE_SIZE = sizeof(uint32_t);
+const uint32_t OVERFLOW_NEXT_PAGE_OFFSET = 0;
+const uint32_t OVERFLOW_DATA_LENGTH_SIZE = sizeof(uint32_t);
+const uint32_t OVERFLOW_DATA_LENGTH_OFFSET = OVERFLOW_NEXT_PAGE_OFFSET + OVERFLOW_NEXT_PAGE_SIZE;
+const uint32_t OVERFLOW_HEADER_SIZE = OVERFLOW_NEXT_PAGE_SIZE + OVERFLOW_DATA_LENGTH_SIZE;
+const uint32_t OVERFLOW_SPACE_FOR_DATA = PAGE_SIZE - OVERFLOW_HEADER_SIZE;
+
+// DATABASE FILE LAYOUT
+// Every table and index is a B-tree in one database file. Page 0 holds the file header,
+// page 1 is the root of the catalog, which maps names of the B-trees to their roots.
+// Freed pages are chained from the header through their first bytes
+const char DEFAULT_DATABASE_FILENAME[] = "database.db";
+const char DATABASE_MAGIC[] = "SQLite-CPP 1";
+const uint32_t DATABASE_MAGIC_SIZE = 16;
+const uint32_t DATABASE_MAGIC_OFFSET = 0;
+const uint32_t DATABASE_FREE_LIST_SIZE = sizeof(uint32_t);
+const uint32_t DATABASE_FREE_LIST_OFFSET = DATABASE_MAGIC_OFFSET + DATABASE_MAGIC_SIZE;
+const uint32_t DATABASE_FREE_COUNT_SIZE = sizeof(uint32_t);
+const uint32_t DATABASE_FREE_COUNT_OFFSET = DATABASE_FREE_LIST_OFFSET + DATABASE_FREE_LIST_SIZE;
+const uint32_t DATABASE_HEADER_PAGE = 0;
+const uint32_t CATALOG_ROOT_PAGE = 1;
+const uint32_t FREE_PAGE_NEXT_OFFSET = 0;
+const uint32_t TABLE_NAME_MAX_SIZE = 128; // index names add the column to it
+
+// ROLLBACK JOURNAL CONSTANTS
+// Before changed pages are written to the database file, the pages they overwrite are
+// saved to a journal next to it. Its header holds a magic string, the length of the file
+// before the write and the number of saved pages, then every page follows its number.
+// The header is written last, so a journal without the magic was never complete
+const char JOURNAL_SUFFIX[] = "-journal";
+const char JOURNAL_MAGIC[] = "SQLite-CPP jrnl";
+const uint32_t JOURNAL_MAGIC_SIZE = 16;
+const uint32_t JOURNAL_MAGIC_OFFSET = 0;
+const uint32_t JOURNAL_FILE_LENGTH_SIZE = sizeof(uint64_t);
+const uint32_t JOURNAL_FILE_LENGTH_OFFSET = JOURNAL_MAGIC_OFFSET + JOURNAL_MAGIC_SIZE;
+const uint32_t JOURNAL_PAGE_COUNT_SIZE = sizeof(uint32_t);
+const uint32_t JOURNAL_PAGE_COUNT_OFFSET = JOURNAL_FILE_LENGTH_OFFSET + JOURNAL_FILE_LENGTH_SIZE;
+const uint32_t JOURNAL_HEADER_SIZE = JOURNAL_PAGE_COUNT_OFFSET + JOURNAL_PAGE_COUNT_SIZE;
+const uint32_t JOURNAL_PAGE_NUMBER_SIZE = sizeof(uint32_t);
+const uint32_t JOURNAL_ENTRY_SIZE = JOURNAL_PAGE_NUMBER_SIZE + PAGE_SIZE;
@@ -2,9 +2,11 @@
 
 #include <cstring>
 #include <cstdint>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <exception>
+#include <algorithm>
 
 #include "pager.h"
 #include "constants.h"
@@ -15,20 +17,87 @@
 // Most of the operations with data are lower-level for better performance
 //------------------------------------------------------------------------
 
-void serializeRow(Row*, void*);
+uint32_t serializedRowSize(Row*);
+
+void serializeRow(Row*, void*, uint32_t overflowPage);
 
 void deserializeRow(void*, Row*);
 
+void deserializeValue(const std::shared_ptr<Pager>& pager, void* source, Row* destination);
+
+uint32_t serializedOverflowPage(void* source);
+
+KeyType serializedKeyType(void* source);
+Key serializedKey(void* source);
+std::string_view serializedUsername(void* source);
+std::string_view serializedEmail(void* source);
+bool isRowDeleted(void* source);
+void markRowDeleted(void* source);
+
+uint32_t writeOverflow(const std::shared_ptr<Pager>& pager, Row* row, uint32_t reusePage);
+void releaseOverflow(const std::shared_ptr<Pager>& pager, uint32_t pageNumber);
+
+// Streams the value of a serialized row, reading overflow pages only when asked
+class ValueReader
+{
+private:
+    Pager* pager;
+    const char* inlineData;
+    uint32_t inlineLength;
+    uint32_t valueLength;
+    uint32_t nextPageNumber;
+    bool inlineRead;
+
+public:
+    ValueReader(const std::shared_ptr<Pager>& pager, void* source);
+
+    uint32_t getLength() const;
+    bool nextChunk(const char*& data, uint32_t& length);
+};
+
+std::string keyToString(const Key& key, KeyType keyType);
+
+bool parseRowColumn(std::string_view name, RowColumn& column);
+
 void printRow(Row*);
+void printSerializedRow(std::ostream& out, const std::shared_ptr<Pager>& pager, void* source,
+                        const std::vector<RowColumn>& columns);
+void writeSerializedRow(std::ostream& out, const std::shared_ptr<Pager>& pager, void* source,
+                        const std::vector<RowColumn>& columns);
 
+// A B-tree in a database file. Every table of the file shares its pager
 class Table 
 {
 public:
-	std::unique_ptr<Pager> pager;
-    uint32_t rootPageNumber;
+	std::shared_ptr<Pager> pager;
+    uint32_t rootPageNumber; // the root never moves, so the catalog keeps it
+    KeyType keyType; // integer or composite keys, same for every node
+    std::string name; // name in the catalog, the file name for the catalog itself
+
+    // Catalog of the database file, nullptr for the catalog itself
+    std::shared_ptr<Table> catalog;
+
+    // Secondary indexes by column, nullptr if the column has no index
+    std::shared_ptr<Table> indexes[INDEX_COUNT];
+
+public:
+    Table(std::shared_ptr<Pager> pager, uint32_t rootPageNumber, KeyType keyType);
+};
+
+// Makes the calling thread the only writer of the database file of a table for a statement.
+// Pages it changes are copies until the writer is destroyed, then they are committed
+// at once. If it's destroyed by an exception the copies are dropped. Inside a transaction
+// the copies are committed or dropped by the transaction instead
+class TableWriter
+{
+private:
+    std::shared_ptr<Pager> pager;
+    std::unique_lock<std::mutex> lock;
+    int uncaughtExceptions;
 
 public:
-    Table(std::unique_ptr<Pager> pager, uint32_t rootPageNumber);
+    explicit TableWriter(const std::shared_ptr<Table>& table);
+    ~TableWriter();
 };
 
 class Cursor
@@ -37,18 +106,20 @@ public:
     std::shared_ptr<Table> table; // current table
     uint32_t pageNumber; // current page number
     uint32_t cellCount; // cells (rows) in current node
-    bool endOfTable; // indicates a position one past the last element
+    bool endOfTable; // indicates a position one past the last element, or one before the first
+    Snapshot snapshot; // pages the cursor points into stay as they were when it was created
 
 public:
     Cursor& operator++(int);
+    Cursor& operator--(int);
 };
 
 std::unique_ptr<Cursor> tableStart(std::shared_ptr<Table>& table);
-std::unique_ptr<Cursor> tableFindKey(std::shared_ptr<Table>& table, const uint32_t key);
+std::unique_ptr<Cursor> tableFindKey(std::shared_ptr<Table>& table, const Key& key);
+std::unique_ptr<Cursor> tableSeek(std::shared_ptr<Table>& table, const Key& key);
+std::unique_ptr<Cursor> tableSeekLast(std::shared_ptr<Table>& table, const Key& key);
+std::unique_ptr<Cursor> tableEnd(std::shared_ptr<Table>& table);
 
-std::shared_ptr<Table> openDatabase(std::string filename);
-std::shared_ptr<Table> createDatabase(std::string filename);
-std::shared_ptr<Table> dropDatabase(std::string filename);
 void saveAndCloseDatabase(const std::shared_ptr<Table>& table);
 
 void freeTable(const std::shared_ptr<Table>& table);
@@ -58,17 +129,30 @@ void* cursorValue(std::unique_ptr<Cursor>& cursor);
 void cursorAdvance(std::unique_ptr<Cursor>& cursor);
 
 void createNewRootNode(std::shared_ptr<Table>& table, uint32_t right_child_page_num);
-uint32_t getMaxKey(const std::unique_ptr<Pager>& pager, void* node);
-
-void leafInsert(std::unique_ptr<Cursor>& cursor, const uint32_t key, Row* value);
+Key getMaxKey(const std::shared_ptr<Pager>& pager, void* node);
+
+uint64_t subtreeCount(void* node);
+void updateChildCount(std::shared_ptr<Table>& table, uint32_t pageNumber);
+void updateSubtreeCounts(std::shared_ptr<Table>& table, uint32_t pageNumber);
+uint64_t tableCount(std::shared_ptr<Table>& table);
+uint64_t tableCountLess(std::shared_ptr<Table>& table, const Key& key);
+uint64_t tableCountRange(std::shared_ptr<Table>& table, const Key& start, const Key& end);
+std::unique_ptr<Cursor> tableSeekRank(std::shared_ptr<Table>& table, uint64_t rank);
+std::vector<Key> tableSplitKeys(std::shared_ptr<Table>& table, uint32_t rangeCount);
+
+void leafInsert(std::unique_ptr<Cursor>& cursor, Row* value);
+void leafInsertRows(std::shared_ptr<Table>& table, uint32_t pageNumber, Row** rows, uint32_t rowCount);
+bool tableHasAnyKey(std::shared_ptr<Table>& table, const std::vector<Row*>& rows);
+void tableInsertRows(std::shared_ptr<Table>& table, const std::vector<Row*>& rows);
 void leafUpdate(std::unique_ptr<Cursor>& cursor, Row* value);
 void leafDelete(std::unique_ptr<Cursor>& cursor);
-void leafSplitAndInsert(std::unique_ptr<Cursor>& cursor, const uint32_t key, Row* value);
+void leafSplitAndInsert(std::unique_ptr<Cursor>& cursor, Row* value, uint32_t overflowPage);
+void leafSplit(std::unique_ptr<Cursor>& cursor, Row* value, uint32_t overflowPage, bool replace);
 
-std::unique_ptr<Cursor> findLeafNode(std::shared_ptr<Table>& table, 
-                                     uint32_t pageNumber, const uint32_t key);
-std::unique_ptr<Cursor> findInternalNode(std::shared_ptr<Table>& table,
-                                         uint32_t pageNumber, const uint32_t key);
+std::unique_ptr<Cursor> findLeafNode(std::shared_ptr<Table>& table, uint32_t pageNumber, 
+                                     const Key& key);
+std::unique_ptr<Cursor> findInternalNode(std::shared_ptr<Table>& table, uint32_t pageNumber, 
+                                         const Key& key);
 
 void internalInsert(std::shared_ptr<Table>& table, 
                     uint32_t parent_page_num, uint32_t child_page_num);
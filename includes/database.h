@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <exception>
 
 #include "../includes/buffer.h"
@@ -13,20 +14,28 @@
 class Database 
 {
 private:
-    // With current implementation, every time a new table is accessed,
-    // old table gets saved and removed from cache, and a new one gets cached.
-    std::shared_ptr<Table> cachedTable;
+    // Tables of the database file, given as the last argument
+    TableCache tables;
     std::shared_ptr<InputBuffer> inputBuffer;
 
+    // Script given with --batch, empty if statements are read from the console or a pipe
+    std::string scriptFilename;
+
+    // Socket given with --serve, empty if the database isn't served
+    std::string socketPath;
+
     int argc;
     char** argv;
 
 public:
     Database(int argc, char** argv);
 
-    void handleMetaCommand();
+    bool handleMetaCommand();
     void handleStatement();
 
+    bool handleRequest(std::string_view text);
+    TableCache& getTables();
+
     void printErrorMessage(const std::string& message);
 
     void run();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "constants.h"
+#include "data.h"
+
+
+//------------------------------------------------------------------------
+// Secondary indexes are composite key B-trees in the file of the table.
+// Keys are (hash of the column value, primary id), rows hold the column
+// value itself, so hash collisions are resolved without the primary table
+//------------------------------------------------------------------------
+
+uint64_t indexHash(const char* value, size_t length);
+
+const char* indexColumnName(IndexColumn column);
+bool parseIndexColumn(std::string_view name, IndexColumn& column);
+
+std::string indexName(const std::string& tableName, IndexColumn column);
+
+void openIndexes(std::shared_ptr<Table>& table);
+bool createIndex(std::shared_ptr<Table>& table, IndexColumn column);
+
+void indexInsertRow(std::shared_ptr<Table>& table, Row* row);
+void indexDeleteRow(std::shared_ptr<Table>& table, Row* row);
+
+std::vector<Key> indexLookup(std::shared_ptr<Table>& index, IndexColumn column,
+                             const std::string& value, bool descending = false, 
+                             uint64_t maxKeys = UINT64_MAX);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+//------------------------------------------------------------------------
+// Patterns of "where column like pattern". A "%" matches any run of characters
+// and a "_" matches one character. A pattern is split at its "%" into pieces 
+// of a fixed length that are found left to right. Pieces are searched 16 
+// positions at a time by comparing their first and last characters, candidates 
+// are then compared whole. Without SSE2 the same search runs one position at a time
+//------------------------------------------------------------------------
+
+class LikePattern
+{
+private:
+    std::vector<std::string> pieces;
+    bool anchoredStart; // the pattern doesn't start with "%"
+    bool anchoredEnd; // the pattern doesn't end with "%"
+
+public:
+    explicit LikePattern(std::string_view pattern);
+
+    bool matches(std::string_view text) const;
+};
+
+bool likePieceMatches(const char* text, std::string_view piece);
+size_t likeFind(std::string_view text, std::string_view piece, size_t from);
+size_t likeFindScalar(std::string_view text, std::string_view piece, size_t from);
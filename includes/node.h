@@ -6,29 +6,108 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstring>
 
 #include "constants.h"
 
 typedef enum { NODE_INTERNAL, NODE_LEAF } NodeType;
 
+// Encoding and ordering of each key type
+template <KeyType type> struct KeyTraits;
+
+template <> struct KeyTraits<KEY_INTEGER>
+{
+    static constexpr uint32_t SIZE = KEY_INTEGER_SIZE;
+
+    static Key read(const void* source)
+    {
+        Key key = { 0, 0 };
+        memcpy(&key.id, source, sizeof(uint64_t));
+        return key;
+    }
+
+    static void write(void* destination, const Key& key)
+    {
+        memcpy(destination, &key.id, sizeof(uint64_t));
+    }
+
+    static bool less(const Key& lhs, const Key& rhs)
+    {
+        return lhs.id < rhs.id;
+    }
+};
+
+template <> struct KeyTraits<KEY_COMPOSITE>
+{
+    static constexpr uint32_t SIZE = KEY_COMPOSITE_SIZE;
+
+    static Key read(const void* source)
+    {
+        Key key;
+        memcpy(&key.prefix, source, sizeof(uint64_t));
+        memcpy(&key.id, static_cast<const char*>(source) + sizeof(uint64_t), sizeof(uint64_t));
+        return key;
+    }
+
+    static void write(void* destination, const Key& key)
+    {
+        memcpy(destination, &key.prefix, sizeof(uint64_t));
+        memcpy(static_cast<char*>(destination) + sizeof(uint64_t), &key.id, sizeof(uint64_t));
+    }
+
+    static bool less(const Key& lhs, const Key& rhs)
+    {
+        return lhs.prefix < rhs.prefix || (lhs.prefix == rhs.prefix && lhs.id < rhs.id);
+    }
+};
+
+uint32_t keySize(KeyType keyType);
+Key readKey(KeyType keyType, const void* source);
+void writeKey(KeyType keyType, void* destination, const Key& key);
+Key maxKey(KeyType keyType);
+bool nextKey(KeyType keyType, Key& key);
+bool previousKey(KeyType keyType, Key& key);
+
 void nodeSetType(void* node, NodeType type);
 void setRootNode(void* node, bool is_root);
 bool isRootNode(void* node);
 uint32_t* getParent(void* node);
 NodeType nodeGetType(void* node);
+KeyType nodeGetKeyType(void* node);
+void nodeSetKeyType(void* node, KeyType keyType);
 
-void leafInitialize(void* node);
+void leafInitialize(void* node, KeyType keyType);
 void* leafGetValue(void* node, uint32_t cellCount);
 void* leafGetCell(void* node, uint32_t cellCount);
 uint32_t* leafGetCellCount(void* node);
-uint32_t* leafGetKey(void* node, uint32_t cellCount);
+Key leafGetKey(void* node, uint32_t cellCount);
 uint32_t* leafGetNextLeaf(void* node);
+uint32_t* leafGetPrevLeaf(void* node);
+uint16_t* leafGetSlot(void* node, uint32_t cellNumber);
+uint16_t* leafGetCellLength(void* node, uint32_t cellCount);
+uint16_t* leafGetCellContentStart(void* node);
+uint16_t* leafGetFragmentedBytes(void* node);
+uint32_t leafGetContiguousFreeSpace(void* node);
+uint32_t leafGetFreeSpace(void* node);
+void leafDefragment(void* node);
+void* leafAllocateCell(void* node, uint32_t cellNumber, uint32_t cellLength);
+void* leafReallocateCell(void* node, uint32_t cellNumber, uint32_t cellLength);
+uint32_t leafFindCell(void* node, const Key& key);
 
-void internalInitialize(void* node);
-void internalUpdateKey(void* node, uint32_t old_key, uint32_t new_key);
-uint32_t internalFindChild(void* node, uint32_t key);
+void internalInitialize(void* node, KeyType keyType);
+void internalUpdateKey(void* node, const Key& old_key, const Key& new_key);
+uint32_t internalFindChild(void* node, const Key& key);
 uint32_t* internalGetKeyCount(void* node);
 uint32_t* internalGetRightChild(void* node);
+uint64_t* internalGetRightCount(void* node);
+uint32_t internalGetCellSize(void* node);
 uint32_t* internalGetCell(void* node, uint32_t cellCount);
 uint32_t* internalGetChild(void* node, uint32_t child_num);
-uint32_t* internalGetKey(void* node, uint32_t key_num);
+uint64_t* internalGetChildCount(void* node, uint32_t child_num);
+uint32_t internalGetChildIndex(void* node, uint32_t childPageNumber);
+Key internalGetKey(void* node, uint32_t key_num);
+void internalSetKey(void* node, uint32_t key_num, const Key& key);
+
+uint32_t* overflowGetNextPage(void* page);
+uint32_t* overflowGetDataLength(void* page);
+char* overflowGetData(void* page);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "constants.h"
+#include "data.h"
+#include "like.h"
+
+
+//------------------------------------------------------------------------
+// Selects run as a pipeline of operators that pass batches of rows. A batch
+// holds pointers to the cells of up to SELECT_BATCH_ROWS rows in their leaves, 
+// rows are never copied out of the pages. Operators narrow the selection of a 
+// batch instead of moving rows, so every step is a tight loop over arrays and 
+// a virtual call is made per batch, not per row. A select pulls batches from
+// the last operator: scan -> filter -> limit, then counts or prints them
+//------------------------------------------------------------------------
+
+struct RowBatch
+{
+    void* rows[SELECT_BATCH_ROWS]; // serialized rows in leaf pages
+    uint32_t rowCount;
+    uint16_t selection[SELECT_BATCH_ROWS]; // positions in rows that are still selected
+    uint32_t selectedCount;
+    uint32_t capacity; // most rows the consumer wants, so a limit doesn't read more
+};
+
+class SelectOperator
+{
+public:
+    virtual ~SelectOperator() = default;
+
+    // Fill the batch with the next selected rows. Return false when there are no more,
+    // otherwise at least one row is selected
+    virtual bool next(RowBatch& batch) = 0;
+};
+
+// Live rows of a table from the position of a cursor in key order or backwards,
+// up to an optional end key
+class ScanOperator : public SelectOperator
+{
+private:
+    std::shared_ptr<Pager> pager;
+    std::unique_ptr<Cursor> cursor;
+    bool descending;
+    bool bounded;
+    Key end;
+    bool endInclusive;
+
+public:
+    ScanOperator(std::unique_ptr<Cursor> cursor, bool descending);
+
+    void setEnd(const Key& end, bool inclusive);
+    bool next(RowBatch& batch) override;
+};
+
+// Rows whose username or email equals a value or matches a like pattern
+class FilterOperator : public SelectOperator
+{
+private:
+    SelectOperator& input;
+    IndexColumn column;
+    std::string value;
+    bool like;
+    LikePattern pattern;
+
+    // Column of every selected row of the current batch
+    const char* fieldData[SELECT_BATCH_ROWS];
+    uint8_t fieldLengths[SELECT_BATCH_ROWS];
+
+public:
+    FilterOperator(SelectOperator& input, IndexColumn column, const std::string& value, bool like);
+
+    bool next(RowBatch& batch) override;
+};
+
+// Skips the first rows and stops after a number of rows
+class LimitOperator : public SelectOperator
+{
+private:
+    SelectOperator& input;
+    uint64_t skipLeft;
+    uint64_t rowsLeft;
+
+public:
+    LimitOperator(SelectOperator& input, uint64_t offset, uint64_t limit);
+
+    bool next(RowBatch& batch) override;
+};
+
+uint64_t countRows(SelectOperator& input);
+void printRows(SelectOperator& input, std::ostream& out, const std::shared_ptr<Pager>& pager,
+               const std::vector<RowColumn>& columns, OutputFormat format = OUTPUT_TEXT);
@@ -14,31 +14,128 @@
 #include <fcntl.h>
 #include <Windows.h>
 #include <exception>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "constants.h"
 
 
+// One committed version of a page. Versions of a page are chained from the newest one
+struct PageVersion
+{
+    char data[PAGE_SIZE];
+    uint64_t commitVersion; // number of the commit that wrote it, 0 if read from the file
+    std::atomic<PageVersion*> older;
+};
+
+// Versions of a cached page, and the private copy of the writer
+struct Frame
+{
+    std::atomic<PageVersion*> newest;
+    PageVersion* pending; // only touched by the writer thread
+    bool dirty; // newest version isn't in the file yet, guarded by the writer mutex
+    std::atomic<uint64_t> lastUse; // cache misses of the pager before it was last read
+
+    Frame() : newest(nullptr), pending(nullptr), dirty(false), lastUse(0) { }
+};
+
+// Pins the state of every table at the last commit. While a thread holds a snapshot,
+// it reads the versions of pages committed before it, and they are not freed.
+// Snapshots of a thread nest, the outermost one decides the version.
+// Another thread can join a version that is pinned for as long as it reads
+class Snapshot
+{
+private:
+    bool pinned;
+
+public:
+    Snapshot();
+    explicit Snapshot(uint64_t version);
+    Snapshot(Snapshot&& other) noexcept;
+    Snapshot& operator=(Snapshot&& other) noexcept;
+    ~Snapshot();
+
+    static uint64_t getVersion();
+    static void releasePages();
+};
+
 class Pager
 {
 private:
+    std::string filename;
     HANDLE fileHandle;
-    uint32_t fileLength;
+    uint64_t fileLength;
     uint32_t pageCount;
 
+    // Page cache. Frames are allocated in groups as pages are accessed, the array 
+    // of groups never moves, so a cached page is found without taking a lock
+    std::unique_ptr<std::atomic<Frame*>[]> frameGroups;
+    std::mutex loadMutex; // taken on a cache miss
+    std::atomic<uint32_t> cachedPageCount;
+
+    // Least recently used pages are evicted when the cache reaches its limit. While
+    // pages that can't be evicted keep it above the limit, the next try waits for more
+    uint32_t cacheLimit;
+    std::atomic<uint32_t> evictAt;
+    std::atomic<uint64_t> missCount;
+
+    // The thread that writes copies of pages, the pages it copied,
+    // and the page count before it started
+    std::atomic<std::thread::id> writer;
+    std::vector<uint32_t> pendingPages;
+    uint32_t writePageCount;
+
+    // Committed pages that are not written to the file, and whether a journal
+    // of a checkpoint that failed is left over. Guarded by the writer mutex
+    std::vector<uint32_t> dirtyPages;
+    bool hotJournal;
+
+    Frame& getFrame(uint32_t pageNumber);
+    Frame& useFrame(uint32_t pageNumber);
+    PageVersion* loadPage(Frame& frame, uint32_t pageNumber);
+    void writeDirtyPages();
+    void evictPages();
+
 public:
-    void* pages[TABLE_MAX_PAGES];
+    // Every table of the file is written by one writer at a time, 
+    // it's taken for a whole statement. Readers read a snapshot and never wait
+    std::mutex writeMutex;
+
+    // Held by an open transaction, its copies are kept from statement to statement
+    std::unique_lock<std::mutex> transactionLock;
 
-    Pager(HANDLE fileHandle, uint32_t fileLength, uint32_t pageCount);
+    Pager(const std::string& filename, HANDLE fileHandle, uint64_t fileLength, uint32_t pageCount);
+    ~Pager();
 
-    void* getPages();
     HANDLE& getFileHandle();
     uint32_t& getPageCount();
-    uint32_t getFileLength();
+    uint64_t getFileLength();
     void* getPage(uint32_t pageNumber);
+    void* readPage(uint32_t pageNumber);
     uint32_t getUnusedPageNumber();
+    void releasePage(uint32_t pageNumber);
+
+    bool isCached(uint32_t pageNumber);
+    uint32_t getCachedPageCount();
+    uint32_t getDirtyPageCount();
+    uint32_t getPendingPageCount();
+    void setCacheLimit(uint32_t maxPages);
+    void freePage(uint32_t pageNumber);
+
+    void beginWrite();
+    void discardWrite();
+    void commitWrite();
+
+    bool inTransaction();
+    bool beginTransaction();
+    bool commitTransaction();
+    bool rollbackTransaction();
 
+    void checkpoint();
     void pagerFlush(uint32_t pageNumber);
 };
 
-std::unique_ptr<Pager> openPager(std::string filename);
-std::unique_ptr<Pager> createPager(std::string filename);
\ No newline at end of file
+std::shared_ptr<Pager> openPager(std::string filename);
+std::shared_ptr<Pager> createPager(std::string filename);
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+// Winsock has to come before Windows.h, which the other headers include
+#include <winsock2.h>
+#include <afunix.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "buffer.h"
+#include "constants.h"
+
+
+//------------------------------------------------------------------------
+// Serves the database file over a Unix domain socket, so many client processes
+// share the open tables and the page cache. One thread polls every connection
+// and runs statements one at a time, in the order their requests arrive. A
+// request is a frame with the text of one statement or meta command. Its binary
+// response has the result code of the statement and the selected rows as records,
+// a text request gets the output the console would print instead. Clients may
+// send many requests without waiting, the responses come back in the same order.
+// Every connection is a session with its own current table. While a session has
+// a transaction open, requests of the other sessions wait until it ends
+//------------------------------------------------------------------------
+
+class Database;
+
+enum class RequestKind : uint8_t {
+    REQUEST_BINARY,
+    REQUEST_TEXT
+};
+
+// What the code of a binary response is
+enum class ResponseStatus : uint8_t {
+    RESPONSE_EXECUTE, // ExecuteResult of the statement
+    RESPONSE_PREPARE, // PrepareResult of a statement that couldn't be parsed
+    RESPONSE_META, // MetaCommandResult
+    RESPONSE_ERROR // the request threw, the payload is the message
+};
+
+// What follows the header of a binary response
+enum class ResponsePayload : uint8_t {
+    PAYLOAD_NONE,
+    PAYLOAD_ROWS, // column count and columns, then a record per row until the frame ends
+    PAYLOAD_COUNT, // 8-byte count of a "select count(*)"
+    PAYLOAD_TEXT // output of a meta command or the message of an error
+};
+
+// Binary response as a client decodes it
+struct ServerResponse
+{
+    ResponseStatus status;
+    uint8_t code;
+    ResponsePayload payload;
+    std::vector<RowColumn> columns;
+    std::vector<Row> rows; // only the selected columns are set
+    uint64_t count;
+    std::string text;
+};
+
+struct Session
+{
+    SOCKET socket;
+    std::string input; // received bytes that don't form a whole request yet
+    std::string output; // responses not sent yet
+    size_t outputSent;
+    std::string currentName; // current table of the session
+    bool peerClosed; // the client sent all its requests, the responses are still sent
+    bool closed;
+
+    explicit Session(SOCKET socket);
+};
+
+class Server
+{
+private:
+    Database& database;
+    std::string socketPath;
+    SOCKET listener;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::atomic<bool> stopping;
+
+    // Session with the open transaction, nullptr if there is none
+    Session* transactionSession;
+
+    // Output of the statement that runs
+    std::ostringstream response;
+    std::shared_ptr<InputBuffer> metaInput;
+
+    void acceptSessions();
+    void receive(Session& session);
+    void runRequests(Session& session);
+    bool runBinaryRequest(std::string_view text, std::string& result);
+    void send(Session& session);
+    void closeSession(Session& session);
+
+public:
+    Server(Database& database, const std::string& socketPath);
+    ~Server();
+
+    void run();
+    void stop();
+};
+
+// Connection of a client to a server, used by tools and tests
+class ServerConnection
+{
+private:
+    SOCKET socket;
+    std::string input;
+
+public:
+    explicit ServerConnection(const std::string& socketPath);
+    ~ServerConnection();
+
+    bool sendRequest(std::string_view statement, RequestKind kind = RequestKind::REQUEST_TEXT);
+    bool finishRequests();
+    bool receiveResponse(std::string& output);
+    bool receiveResponse(ServerResponse& response);
+    std::string request(std::string_view statement);
+    ServerResponse query(std::string_view statement);
+};
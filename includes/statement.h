@@ -2,7 +2,8 @@
 
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <vector>
 #include <exception>
 
 #include "constants.h"
@@ -10,18 +11,26 @@
 #include "data.h"
 #include "pager.h"
 #include "node.h"
+#include "index.h"
+#include "operators.h"
+#include "tablecache.h"
+#include "tokenizer.h"
 
 
 // STATEMENTS
 
 enum class StatementType {
     STATEMENT_CREATE,
+    STATEMENT_CREATE_INDEX,
     STATEMENT_INSERT,
     STATEMENT_SELECT,
     STATEMENT_UPDATE,
     STATEMENT_DROP,
     STATEMENT_OPEN,
-    STATEMENT_DELETE
+    STATEMENT_DELETE,
+    STATEMENT_BEGIN,
+    STATEMENT_COMMIT,
+    STATEMENT_ROLLBACK
 };
 
 enum class PrepareResult { 
@@ -29,7 +38,8 @@ enum class PrepareResult {
     PREPARE_NEGATIVE_ID, 
     PREPARE_STRING_TOO_LONG, 
     PREPARE_UNRECOGNIZED_STATEMENT, 
-    PREPARE_SYNTAX_ERROR 
+    PREPARE_SYNTAX_ERROR,
+    PREPARE_PARAMETER_MISMATCH
 };
 
 enum class ExecuteResult { 
@@ -37,12 +47,35 @@ enum class ExecuteResult {
     EXECUTE_DUPLICATE_KEY,
     EXECUTE_KEY_DOES_NOT_EXIST,
     EXECUTE_TABLE_FULL,
+    EXECUTE_KEY_TYPE_MISMATCH,
     EXECUTE_TABLE_NOT_SELECTED,
     EXECUTE_ERROR_WHILE_CREATING,
     EXECUTE_ERROR_WHILE_OPENING,
-    EXECUTE_ERROR_FILE_EXISTS,
+    EXECUTE_TABLE_EXISTS,
     EXECUTE_ERROR_WHILE_DROPPING,
-    EXECUTE_ERROR_FILE_NOT_FOUND
+    EXECUTE_TABLE_NOT_FOUND,
+    EXECUTE_INDEX_EXISTS,
+    EXECUTE_PARAMETER_NOT_BOUND,
+    EXECUTE_TRANSACTION_OPEN,
+    EXECUTE_NO_TRANSACTION,
+    EXECUTE_STRING_TOO_LONG,
+    EXECUTE_PREPARE_FAILED
+};
+
+// Field of a statement that a "?" parameter stands for
+enum class ParameterType {
+    PARAMETER_KEY,
+    PARAMETER_BETWEEN_END,
+    PARAMETER_USERNAME,
+    PARAMETER_EMAIL,
+    PARAMETER_VALUE,
+    PARAMETER_WHERE_VALUE
+};
+
+struct Parameter
+{
+    ParameterType type;
+    bool bound;
 };
 
 
@@ -53,43 +86,107 @@ private:
 	Row rowToEdit;
     std::string tableName;
 
-    // Track statement execution attemts to avoid avoid recursive executions,
-    // in case a function keeps failing
-    uint8_t attempts = 0;
+    // Rows of an insert with more than one row
+    std::vector<Row> rows;
+
+    // Range of keys to select, the range is empty if rangeEnd < rangeStart.
+    // It's set from the operator of "where id" and the key in rowToEdit
+    bool ranged;
+    Key rangeStart;
+    Key rangeEnd;
+    std::string keyOperator;
+    Key betweenEnd;
+    KeyType betweenEndType;
+
+    // Column to filter by, INDEX_COUNT if rows are not filtered
+    IndexColumn whereColumn;
+    std::string whereValue;
+
+    // Order and number of rows to select
+    bool descending;
+    uint64_t limit;
+    uint64_t offset;
+
+    // Print the number of selected rows instead of the rows
+    bool counting;
+
+    // Columns to print, in the order of the select. Every column if it's empty
+    std::vector<RowColumn> columns;
+
+    // whereValue is a pattern of "like" instead of a value
+    bool whereLike;
+
+    // Parameters in the order they appear in the statement
+    std::vector<Parameter> parameters;
+
+    // Stream that selected rows are printed to, as text or as binary records
+    std::ostream* output;
+    OutputFormat outputFormat;
+
+    PrepareResult prepareKey(Tokenizer& tokens, Key& key, KeyType& keyType,
+                             ParameterType parameterType);
+    bool prepareText(std::string_view text, ParameterType parameterType);
+    PrepareResult prepareKeyRange(Tokenizer& tokens, std::string_view _operator);
+    PrepareResult prepareInsertRows(Tokenizer& tokens);
+    void setKeyRange();
+    PrepareResult prepareColumns(Tokenizer& tokens, std::string_view& _word);
+    PrepareResult prepareWhere(Tokenizer& tokens);
+    PrepareResult prepareSelectModifiers(Tokenizer& tokens, std::string_view _word = {});
+
+    ExecuteResult getNamedTable(TableCache& tables, std::shared_ptr<Table>& table);
+    ExecuteResult executeSelectWhereParallel(std::shared_ptr<Table>& table, uint32_t threadCount);
+    void printCount(uint64_t count);
 
 public:
 	Statement();
 
 	PrepareResult prepareStatement(InputBuffer*);
-    ExecuteResult executeCreate(std::shared_ptr<Table>& table);
-    ExecuteResult executeOpen(std::shared_ptr<Table>& table);
+	PrepareResult prepareStatement(std::string_view input);
+
+    uint32_t getParameterCount() const;
+    PrepareResult bindKey(uint32_t index, const Key& key, KeyType keyType);
+    PrepareResult bindText(uint32_t index, const std::string& text);
+    ExecuteResult executeCreate(TableCache& tables);
+    ExecuteResult executeCreateIndex(std::shared_ptr<Table>& table);
+    ExecuteResult executeOpen(TableCache& tables);
 	ExecuteResult executeInsert(std::shared_ptr<Table>& table);
+	ExecuteResult executeInsertRows(std::shared_ptr<Table>& table);
 	ExecuteResult executeUpdate(std::shared_ptr<Table>& table);
-    ExecuteResult executeDrop(std::shared_ptr<Table>& table);
+    ExecuteResult executeDrop(TableCache& tables);
     ExecuteResult executeDelete(std::shared_ptr<Table>& table);
-	static ExecuteResult executeSelect(std::shared_ptr<Table>& table);
+	ExecuteResult executeSelect(std::shared_ptr<Table>& table);
+	ExecuteResult executeSelectWhere(std::shared_ptr<Table>& table);
 
-	ExecuteResult executeStatement(std::shared_ptr<Table>& table);
+	ExecuteResult executeStatement(TableCache& tables, std::ostream& output = std::cout,
+                                   OutputFormat format = OUTPUT_TEXT);
 
 	const StatementType getStatement() const;
+    bool isCounting() const;
+    const std::vector<RowColumn>& getColumns() const;
     const std::string getTableName() const;
 	const Row getRow() const;
 };
 
+ExecuteResult insertRow(std::shared_ptr<Table>& table, Row* row);
+ExecuteResult insertRows(std::shared_ptr<Table>& table, std::vector<Row*>& rows);
+
+
 // META COMMANDS
 
 enum class MetaCommandResult {
 	META_COMMAND_SUCCESS,
+    META_COMMAND_EXIT,
     META_COMMAND_SYNTAX_ERROR,
-	META_COMMAND_UNRECOGNIZED_COMMAND
+	META_COMMAND_UNRECOGNIZED_COMMAND,
+    META_COMMAND_TABLE_NOT_SELECTED,
+    META_COMMAND_TABLE_NOT_FOUND
 };
 
-MetaCommandResult doMetaCommand(std::shared_ptr<InputBuffer>, 
-                                const std::shared_ptr<Table>&);
+MetaCommandResult doMetaCommand(std::shared_ptr<InputBuffer>, TableCache&);
 
 void printConstants();
 
 void indent(uint32_t level);
 
-void printTree(const std::unique_ptr<Pager>& pager,
+void printTree(const std::shared_ptr<Pager>& pager,
                uint32_t pageNumber, uint32_t indentation_level);
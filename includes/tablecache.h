@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "constants.h"
+#include "data.h"
+#include "catalog.h"
+
+
+//------------------------------------------------------------------------
+// Tables of the database file stay open after they are used, so switching
+// between them doesn't look them up in the catalog again. Handles of the least
+// recently used tables are dropped when there are too many. Pages of every table
+// are cached by the one pager of the file, which evicts the least recently used
+// ones when they don't fit into the budget. Statements between begin
+// and commit or rollback form one transaction of the file
+//------------------------------------------------------------------------
+
+class TableCache
+{
+private:
+    std::string filename;
+    std::shared_ptr<Table> catalog; // opened on first use
+
+    // Open tables, the most recently used one first
+    std::list<std::shared_ptr<Table>> tables;
+    std::unordered_map<std::string, std::list<std::shared_ptr<Table>>::iterator> tablesByName;
+
+    // Table used by statements that don't name one
+    std::string currentName;
+
+    uint32_t maxTables;
+    uint32_t maxPages;
+
+    void evict();
+
+public:
+    explicit TableCache(const std::string& filename, uint32_t maxTables = TABLE_CACHE_MAX_TABLES,
+                        uint32_t maxPages = TABLE_CACHE_MAX_PAGES);
+
+    std::shared_ptr<Table>& getCatalog();
+    std::shared_ptr<Table> get(const std::string& name);
+    std::shared_ptr<Table> current();
+    void setCurrent(const std::string& name);
+    const std::string& getCurrentName() const;
+    void add(const std::shared_ptr<Table>& table);
+
+    bool begin();
+    bool commit();
+    bool rollback();
+    bool inTransaction();
+
+    bool isOpen(const std::string& name) const;
+    uint32_t getCachedPageCount();
+
+    void close(const std::string& name);
+    void closeAll();
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+
+
+//------------------------------------------------------------------------
+// Splits a statement into words in place. Words are views into the input
+// buffer, so parsing a statement doesn't allocate or copy anything until
+// the values are stored in the statement. Whitespace is the same as for
+// std::istream, so statements parse exactly as they did with string streams
+//------------------------------------------------------------------------
+
+class Tokenizer
+{
+private:
+    std::string_view input;
+    size_t position;
+
+public:
+    Tokenizer(std::string_view input, size_t position);
+
+    void skipSpaces();
+    int peek() const;
+    int peekWord();
+    void get();
+
+    bool word(std::string_view& word, char end = ' ');
+    bool number(uint64_t& number);
+    std::string_view rest();
+    std::string_view until(char end);
+
+    size_t getPosition() const;
+    void setPosition(size_t position);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "constants.h"
+#include "data.h"
+
+
+//------------------------------------------------------------------------
+// Bulk import and export of the rows of a table. A CSV file has a header line
+// and a line per row: key, username, email and value, quoted if they contain
+// commas, quotes or line breaks. A binary file holds the rows as leaves do.
+// Files are read and written in blocks of a fixed size, exports copy the rows
+// straight from the leaves and imports insert key-sorted batches of rows
+//------------------------------------------------------------------------
+
+enum class TransferFormat { 
+    TRANSFER_CSV, 
+    TRANSFER_BINARY 
+};
+
+enum class TransferResult { 
+    TRANSFER_SUCCESS,
+    TRANSFER_FILE_ERROR,
+    TRANSFER_FORMAT_ERROR,
+    TRANSFER_STRING_TOO_LONG,
+    TRANSFER_KEY_TYPE_MISMATCH,
+    TRANSFER_DUPLICATE_KEY
+};
+
+bool parseTransferFormat(std::string_view filename, TransferFormat& format);
+
+TransferResult exportTable(std::shared_ptr<Table>& table, const std::string& filename,
+                           TransferFormat format, uint64_t& rowCount);
+TransferResult importTable(std::shared_ptr<Table>& table, const std::string& filename,
+                           TransferFormat format, uint64_t& rowCount);
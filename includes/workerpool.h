@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//------------------------------------------------------------------------
+// Threads that parallel scans share for the whole process. Threads are
+// started the first time a scan needs them and wait for work in between,
+// so a statement doesn't pay for starting and joining threads. A task runs
+// on the calling thread and on workers at once and takes its work from
+// shared state. Workers that start after the others took all of it return
+// at once, so a busy pool only makes a scan use fewer threads
+//------------------------------------------------------------------------
+
+class WorkerPool
+{
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+    WorkerPool();
+    void work();
+
+public:
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    static WorkerPool& instance();
+
+    void run(uint32_t threadCount, const std::function<void()>& task);
+};
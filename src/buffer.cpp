@@ -1,20 +1,50 @@
 #include "../includes/buffer.h"
 
 
-InputBuffer::InputBuffer() : buffer(""), inputLength(0) { }
+InputBuffer::InputBuffer() : buffer(""), inputLength(0), batchInput(nullptr), blockPosition(0) { }
 
-// Read console input
-void InputBuffer::readInput()
+InputBuffer::InputBuffer(std::istream* batchInput) : 
+    buffer(""), inputLength(0), batchInput(batchInput), blockPosition(0) { }
+
+// Read the next line of console or batch input, return false at the end of the input
+bool InputBuffer::readInput()
 {
-	std::getline(std::cin, buffer);
+    if (batchInput != nullptr)
+    {
+        if (!readBatchLine())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        std::getline(std::cin, buffer);
 
-	if (std::cin.fail())
-	{
-        throw std::runtime_error("Error reading input.");
-	}
+        if (std::cin.eof() && buffer.empty())
+        {
+            return false;
+        }
+        if (std::cin.fail())
+        {
+            throw std::runtime_error("Error reading input.");
+        }
+    }
+
+	trimInput();
+    return true;
+}
+
+// Take a line that didn't come from the input, like a request sent to the server
+void InputBuffer::setInput(std::string_view line)
+{
+    buffer.assign(line);
+    trimInput();
+}
 
-	// Remove spaces and newline characters
-	while (buffer.back() == ' ' || buffer.back() == '\n')
+// Remove spaces and newline characters
+void InputBuffer::trimInput()
+{
+	while (!buffer.empty() && (buffer.back() == ' ' || buffer.back() == '\n' || buffer.back() == '\r'))
 	{
 		buffer.pop_back();
 	}
@@ -22,7 +52,46 @@ void InputBuffer::readInput()
 	inputLength = buffer.size();
 }
 
-const std::string InputBuffer::getBuffer() const
+// Cut the next line out of the block, read the next block when the line doesn't end in it.
+// The last line of the input doesn't need a newline
+bool InputBuffer::readBatchLine()
+{
+    while (true)
+    {
+        size_t end = block.find('\n', blockPosition);
+        if (end != std::string::npos)
+        {
+            buffer.assign(block, blockPosition, end - blockPosition);
+            blockPosition = end + 1;
+            return true;
+        }
+
+        // Keep the start of the line and read the next block after it
+        block.erase(0, blockPosition);
+        blockPosition = 0;
+        size_t kept = block.size();
+        block.resize(kept + INPUT_BLOCK_SIZE);
+        batchInput->read(block.data() + kept, INPUT_BLOCK_SIZE);
+        block.resize(kept + batchInput->gcount());
+
+        if (batchInput->gcount() == 0)
+        {
+            if (batchInput->bad())
+            {
+                throw std::runtime_error("Error reading input.");
+            }
+            if (block.empty())
+            {
+                return false;
+            }
+            buffer = block;
+            block.clear();
+            return true;
+        }
+    }
+}
+
+const std::string& InputBuffer::getBuffer() const
 {
 	return buffer;
 }
@@ -32,7 +101,51 @@ const size_t InputBuffer::getLength() const
 	return inputLength;
 }
 
+OutputBuffer::OutputBuffer(std::ostream& stream, size_t size) : 
+    stream(stream), target(stream.rdbuf()), data(size)
+{
+    setp(data.data(), data.data() + data.size());
+    stream.rdbuf(this);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+    stream.rdbuf(target);
+}
+
+// The buffer is full, write it and start over
+int OutputBuffer::overflow(int c)
+{
+    flush();
+    if (c != traits_type::eof())
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+// Called by std::endl and std::flush, the output waits until the buffer is full
+int OutputBuffer::sync()
+{
+    return 0;
+}
+
+// Write everything collected so far. Output that can't be written is dropped, 
+// like output of std::cout is when the pipe it writes to was closed
+void OutputBuffer::flush()
+{
+    std::streamsize length = pptr() - pbase();
+    if (length > 0)
+    {
+        target->sputn(pbase(), length);
+    }
+    target->pubsync();
+    setp(data.data(), data.data() + data.size());
+}
+
 void printPrompt()
 {
 	std::cout << "db > ";
-}
\ No newline at end of file
+}
@@ -0,0 +1,255 @@
+#include "../includes/catalog.h"
+#include "../includes/index.h"
+
+// Open a database file, or create it with an empty catalog if it doesn't exist.
+// Return the catalog of the file, tables are opened through it
+std::shared_ptr<Table> openDatabase(std::string filename)
+{
+    std::shared_ptr<Pager> pager;
+    try
+    {
+        pager = openPager(filename);
+    }
+    catch (...)
+    {
+        if (GetLastError() != ERROR_FILE_NOT_FOUND)
+        {
+            throw;
+        }
+        pager = createPager(filename);
+    }
+
+    std::shared_ptr<Table> catalog = std::make_shared<Table>(pager, CATALOG_ROOT_PAGE, KEY_COMPOSITE);
+    catalog->name = filename;
+
+    if (pager->getPageCount() == 0)
+    {
+        // New database file. Write the header and initialize the catalog root as leaf node
+        TableWriter writer(catalog);
+        char* header = static_cast<char*>(pager->getPage(DATABASE_HEADER_PAGE));
+        memcpy(header + DATABASE_MAGIC_OFFSET, DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+        void* rootNode = pager->getPage(CATALOG_ROOT_PAGE);
+        leafInitialize(rootNode, KEY_COMPOSITE);
+        setRootNode(rootNode, true);
+        return catalog;
+    }
+
+    char* header = static_cast<char*>(pager->getPage(DATABASE_HEADER_PAGE));
+    if (memcmp(header + DATABASE_MAGIC_OFFSET, DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) != 0)
+    {
+        freeTable(catalog);
+        CloseHandle(pager->getFileHandle());
+        throw std::runtime_error("Not a database file.");
+    }
+
+    return catalog;
+}
+
+// Cursor at the live catalog row of a B-tree, nullptr if there is none.
+// Rows with the same name hash are adjacent and sorted by root page
+static std::unique_ptr<Cursor> catalogSeek(std::shared_ptr<Table>& catalog, const char* type,
+                                           const std::string& name)
+{
+    uint64_t hash = indexHash(name.data(), name.size());
+    std::unique_ptr<Cursor> cursor = tableSeek(catalog, { hash, 0 });
+
+    Row row;
+    while (!(cursor->endOfTable))
+    {
+        Key key = leafGetKey(catalog->pager->readPage(cursor->pageNumber), cursor->cellCount);
+        if (key.prefix != hash)
+        {
+            break;
+        }
+
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source))
+        {
+            deserializeRow(source, &row);
+            if (name == row.email && strcmp(type, row.username) == 0)
+            {
+                return cursor;
+            }
+        }
+        (*cursor)++;
+    }
+
+    return nullptr;
+}
+
+// Root page of a B-tree, INVALID_PAGE_NUM if the catalog has no B-tree with the name
+uint32_t catalogFind(std::shared_ptr<Table>& catalog, const char* type, const std::string& name)
+{
+    std::unique_ptr<Cursor> cursor = catalogSeek(catalog, type, name);
+    if (cursor == nullptr)
+    {
+        return INVALID_PAGE_NUM;
+    }
+    return static_cast<uint32_t>(
+        leafGetKey(catalog->pager->readPage(cursor->pageNumber), cursor->cellCount).id);
+}
+
+void catalogInsert(std::shared_ptr<Table>& catalog, const char* type, const std::string& name,
+                   uint32_t rootPageNumber, const std::string& schema)
+{
+    if (name.size() > COLUMN_EMAIL_SIZE)
+    {
+        throw std::runtime_error("Name is too long for the catalog.");
+    }
+
+    Row row;
+    row.keyType = KEY_COMPOSITE;
+    row.key = { indexHash(name.data(), name.size()), rootPageNumber };
+    strcpy_s(row.username, type);
+    strcpy_s(row.email, name.c_str());
+    row.value = schema;
+
+    std::unique_ptr<Cursor> cursor = tableFindKey(catalog, row.key);
+    void* node = catalog->pager->readPage(cursor->pageNumber);
+    if (cursor->cellCount < *leafGetCellCount(node) &&
+        leafGetKey(node, cursor->cellCount) == row.key)
+    {
+        // Row of a dropped B-tree that had the same root page, overwrite it
+        leafUpdate(cursor, &row);
+        return;
+    }
+
+    leafInsert(cursor, &row);
+}
+
+// Mark the catalog row of a B-tree as deleted, same as rows of a table
+void catalogDelete(std::shared_ptr<Table>& catalog, const char* type, const std::string& name)
+{
+    std::unique_ptr<Cursor> cursor = catalogSeek(catalog, type, name);
+    if (cursor != nullptr)
+    {
+        leafDelete(cursor);
+    }
+}
+
+// Names of every B-tree of the given kind, in alphabetical order
+std::vector<std::string> catalogList(std::shared_ptr<Table>& catalog, const char* type)
+{
+    std::vector<std::string> names;
+
+    Row row;
+    for (std::unique_ptr<Cursor> cursor = tableStart(catalog); !(cursor->endOfTable); cursorAdvance(cursor))
+    {
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source))
+        {
+            deserializeRow(source, &row);
+            if (strcmp(type, row.username) == 0)
+            {
+                names.push_back(row.email);
+            }
+        }
+    }
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// Start a new B-tree with an empty root leaf, return its root page
+uint32_t createTree(const std::shared_ptr<Pager>& pager, KeyType keyType)
+{
+    uint32_t rootPageNumber = pager->getUnusedPageNumber();
+    void* rootNode = pager->getPage(rootPageNumber);
+    leafInitialize(rootNode, keyType);
+    setRootNode(rootNode, true);
+    return rootPageNumber;
+}
+
+// Put every page of a B-tree on the free list, with the overflow pages of its rows
+void releaseTree(const std::shared_ptr<Pager>& pager, uint32_t pageNumber)
+{
+    void* node = pager->getPage(pageNumber);
+    if (nodeGetType(node) == NODE_INTERNAL)
+    {
+        for (uint32_t i = 0; i < *internalGetKeyCount(node); i++)
+        {
+            releaseTree(pager, *internalGetChild(node, i));
+        }
+        if (*internalGetRightChild(node) != INVALID_PAGE_NUM)
+        {
+            releaseTree(pager, *internalGetRightChild(node));
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < *leafGetCellCount(node); i++)
+        {
+            releaseOverflow(pager, serializedOverflowPage(leafGetValue(node, i)));
+        }
+    }
+
+    pager->releasePage(pageNumber);
+}
+
+// Create an empty table in the database file of the catalog.
+// Return nullptr if the file already has a table with the name
+std::shared_ptr<Table> createTable(std::shared_ptr<Table>& catalog, const std::string& name,
+                                   KeyType keyType)
+{
+    TableWriter writer(catalog);
+    if (catalogFind(catalog, CATALOG_TABLE, name) != INVALID_PAGE_NUM)
+    {
+        return nullptr;
+    }
+
+    uint32_t rootPageNumber = createTree(catalog->pager, keyType);
+    catalogInsert(catalog, CATALOG_TABLE, name, rootPageNumber,
+                  "create table " + name + (keyType == KEY_COMPOSITE ? " composite" : ""));
+
+    std::shared_ptr<Table> table = std::make_shared<Table>(catalog->pager, rootPageNumber, keyType);
+    table->name = name;
+    table->catalog = catalog;
+    return table;
+}
+
+// Open a table of the database file with its indexes.
+// Return nullptr if the file has no table with the name
+std::shared_ptr<Table> openTable(std::shared_ptr<Table>& catalog, const std::string& name)
+{
+    uint32_t rootPageNumber = catalogFind(catalog, CATALOG_TABLE, name);
+    if (rootPageNumber == INVALID_PAGE_NUM)
+    {
+        return nullptr;
+    }
+
+    // Every node of a table stores the key type of the table
+    KeyType keyType = nodeGetKeyType(catalog->pager->readPage(rootPageNumber));
+    std::shared_ptr<Table> table = std::make_shared<Table>(catalog->pager, rootPageNumber, keyType);
+    table->name = name;
+    table->catalog = catalog;
+    openIndexes(table);
+
+    return table;
+}
+
+// Free the pages of a table and its indexes and remove them from the catalog.
+// Return false if the file has no table with the name
+bool dropTable(std::shared_ptr<Table>& catalog, const std::string& name)
+{
+    TableWriter writer(catalog);
+    uint32_t rootPageNumber = catalogFind(catalog, CATALOG_TABLE, name);
+    if (rootPageNumber == INVALID_PAGE_NUM)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < INDEX_COUNT; i++)
+    {
+        std::string index = indexName(name, static_cast<IndexColumn>(i));
+        uint32_t indexRootPageNumber = catalogFind(catalog, CATALOG_INDEX, index);
+        if (indexRootPageNumber != INVALID_PAGE_NUM)
+        {
+            releaseTree(catalog->pager, indexRootPageNumber);
+            catalogDelete(catalog, CATALOG_INDEX, index);
+        }
+    }
+
+    releaseTree(catalog->pager, rootPageNumber);
+    catalogDelete(catalog, CATALOG_TABLE, name);
+    return true;
+}
@@ -0,0 +1,207 @@
+#include "../includes/connection.h"
+#include "../includes/operators.h"
+
+RowView::RowView(const std::shared_ptr<Pager>& pager, void* source) : pager(pager), source(source) { }
+
+uint64_t RowView::id() const
+{
+    return key().id;
+}
+
+Key RowView::key() const
+{
+    return serializedKey(source);
+}
+
+std::string_view RowView::username() const
+{
+    return serializedUsername(source);
+}
+
+std::string_view RowView::email() const
+{
+    return serializedEmail(source);
+}
+
+std::string RowView::value() const
+{
+    Row row;
+    deserializeValue(pager, source, &row);
+    return std::move(row.value);
+}
+
+void RowView::copyTo(Row& row) const
+{
+    deserializeRow(source, &row);
+    deserializeValue(pager, source, &row);
+}
+
+Connection::Connection(const std::string& filename) : tables(filename) { }
+
+// Open or create a database file, throws if the file can't be opened
+std::unique_ptr<Connection> Connection::open(const std::string& filename)
+{
+    std::unique_ptr<Connection> connection(new Connection(filename));
+    connection->tables.getCatalog();
+    return connection;
+}
+
+// An open transaction is rolled back, then the file is saved
+Connection::~Connection()
+{
+    close();
+}
+
+void Connection::close()
+{
+    tables.closeAll();
+}
+
+// Run a statement given as text. Rows and counts of a select are printed to the output
+ExecuteResult Connection::exec(std::string_view text, std::ostream& output)
+{
+    Statement statement;
+    if (statement.prepareStatement(text) != PrepareResult::PREPARE_SUCCESS)
+    {
+        return ExecuteResult::EXECUTE_PREPARE_FAILED;
+    }
+    return exec(statement, output);
+}
+
+// Run a prepared statement, it can run again with other bound values
+ExecuteResult Connection::exec(Statement& statement, std::ostream& output)
+{
+    return statement.executeStatement(tables, output);
+}
+
+// Make a table the one that typed calls use
+ExecuteResult Connection::openTable(const std::string& name)
+{
+    if (tables.get(name) == nullptr)
+    {
+        return ExecuteResult::EXECUTE_TABLE_NOT_FOUND;
+    }
+    tables.setCurrent(name);
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+ExecuteResult Connection::begin()
+{
+    return tables.begin() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_TRANSACTION_OPEN;
+}
+
+ExecuteResult Connection::commit()
+{
+    return tables.commit() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_NO_TRANSACTION;
+}
+
+ExecuteResult Connection::rollback()
+{
+    return tables.rollback() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_NO_TRANSACTION;
+}
+
+// Opened table, typed calls only take integer keys
+ExecuteResult Connection::getIntegerTable(std::shared_ptr<Table>& table)
+{
+    table = tables.current();
+    if (table == nullptr)
+    {
+        return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
+    }
+    if (table->keyType != KEY_INTEGER)
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+ExecuteResult Connection::insert(uint64_t id, std::string_view username, std::string_view email,
+                                 std::string_view value)
+{
+    if (username.size() > COLUMN_USERNAME_SIZE || email.size() > COLUMN_EMAIL_SIZE)
+    {
+        return ExecuteResult::EXECUTE_STRING_TOO_LONG;
+    }
+
+    std::shared_ptr<Table> table;
+    ExecuteResult result = getIntegerTable(table);
+    if (result != ExecuteResult::EXECUTE_SUCCESS)
+    {
+        return result;
+    }
+
+    Row row;
+    row.keyType = KEY_INTEGER;
+    row.key = { 0, id };
+    memcpy(row.username, username.data(), username.size());
+    row.username[username.size()] = '\0';
+    memcpy(row.email, email.data(), email.size());
+    row.email[email.size()] = '\0';
+    row.value = value;
+    return insertRow(table, &row);
+}
+
+// Copy a row with its value out of the table
+ExecuteResult Connection::get(uint64_t id, Row& row)
+{
+    std::shared_ptr<Table> table;
+    ExecuteResult result = getIntegerTable(table);
+    if (result != ExecuteResult::EXECUTE_SUCCESS)
+    {
+        return result;
+    }
+
+    Snapshot snapshot;
+    Key key = { 0, id };
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+    void* node = table->pager->readPage(cursor->pageNumber);
+    if (cursor->cellCount >= *leafGetCellCount(node) || leafGetKey(node, cursor->cellCount) != key ||
+        isRowDeleted(cursorValue(cursor)))
+    {
+        return ExecuteResult::EXECUTE_KEY_DOES_NOT_EXIST;
+    }
+
+    RowView(table->pager, cursorValue(cursor)).copyTo(row);
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+// Visit the rows with keys from low to high in key order, until the visitor returns false.
+// Rows are read in batches from a snapshot, so writers don't change what a scan sees
+ExecuteResult Connection::scan(uint64_t low, uint64_t high,
+                               const std::function<bool(const RowView&)>& visit)
+{
+    std::shared_ptr<Table> table;
+    ExecuteResult result = getIntegerTable(table);
+    if (result != ExecuteResult::EXECUTE_SUCCESS || high < low)
+    {
+        return result;
+    }
+
+    Snapshot snapshot;
+    ScanOperator scan(tableSeek(table, { 0, low }), false);
+    scan.setEnd({ 0, high }, true);
+
+    RowBatch batch;
+    batch.capacity = SELECT_BATCH_ROWS;
+    while (scan.next(batch))
+    {
+        for (uint32_t i = 0; i < batch.selectedCount; i++)
+        {
+            if (!visit(RowView(table->pager, batch.rows[batch.selection[i]])))
+            {
+                return ExecuteResult::EXECUTE_SUCCESS;
+            }
+        }
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+// Copy the rows with keys from low to high, with their values
+ExecuteResult Connection::scan(uint64_t low, uint64_t high, std::vector<Row>& rows)
+{
+    return scan(low, high, [&rows](const RowView& view) {
+        rows.emplace_back();
+        view.copyTo(rows.back());
+        return true;
+    });
+}
@@ -1,178 +1,543 @@
 #include "../includes/data.h"
 
-// Copy a row into a file
-void serializeRow(Row* source, void* destination) 
+// Size of a row after serialization
+uint32_t serializedRowSize(Row* row)
+{
+    uint32_t size = ROW_MIN_SIZE + 
+                    static_cast<uint32_t>(strnlen(row->username, COLUMN_USERNAME_SIZE)) +
+                    static_cast<uint32_t>(strnlen(row->email, COLUMN_EMAIL_SIZE));
+
+    if (row->keyType == KEY_COMPOSITE)
+    {
+        size += KEY_COMPOSITE_SIZE - KEY_INTEGER_SIZE;
+    }
+
+    if (row->value.size() > VALUE_INLINE_SIZE)
+    {
+        return size + VALUE_INLINE_SIZE + VALUE_OVERFLOW_PAGE_SIZE;
+    }
+    return size + static_cast<uint32_t>(row->value.size());
+}
+
+// Copy a row into a file. Part of the value that doesn't fit inline
+// has to be written beforehand, starting at overflowPage
+void serializeRow(Row* source, void* destination, uint32_t overflowPage) 
 {
     char* destPtr = static_cast<char*>(destination);
-    memcpy(destPtr + ID_OFFSET, &(source->id), ID_SIZE);
-    memcpy(destPtr + USERNAME_OFFSET, source->username, USERNAME_SIZE);
-    memcpy(destPtr + EMAIL_OFFSET, source->email, EMAIL_SIZE);
+    uint8_t flags = (source->keyType == KEY_COMPOSITE) ? ROW_FLAG_COMPOSITE_KEY : 0;
+    *reinterpret_cast<uint8_t*>(destPtr + ROW_FLAGS_OFFSET) = flags;
+    writeKey(source->keyType, destPtr + ROW_KEY_OFFSET, source->key);
+    destPtr += ROW_KEY_OFFSET + keySize(source->keyType);
+
+    uint8_t usernameLength = static_cast<uint8_t>(strnlen(source->username, COLUMN_USERNAME_SIZE));
+    *destPtr = usernameLength;
+    memcpy(destPtr + STRING_LENGTH_SIZE, source->username, usernameLength);
+    destPtr += STRING_LENGTH_SIZE + usernameLength;
+
+    uint8_t emailLength = static_cast<uint8_t>(strnlen(source->email, COLUMN_EMAIL_SIZE));
+    *destPtr = emailLength;
+    memcpy(destPtr + STRING_LENGTH_SIZE, source->email, emailLength);
+    destPtr += STRING_LENGTH_SIZE + emailLength;
+
+    uint32_t valueLength = static_cast<uint32_t>(source->value.size());
+    uint32_t inlineLength = std::min(valueLength, VALUE_INLINE_SIZE);
+    memcpy(destPtr, &valueLength, VALUE_LENGTH_SIZE);
+    memcpy(destPtr + VALUE_LENGTH_SIZE, source->value.data(), inlineLength);
+    if (valueLength > VALUE_INLINE_SIZE)
+    {
+        memcpy(destPtr + VALUE_LENGTH_SIZE + inlineLength, &overflowPage, VALUE_OVERFLOW_PAGE_SIZE);
+    }
+}
+
+static uint8_t* serializedFlags(void* source)
+{
+    return reinterpret_cast<uint8_t*>(static_cast<char*>(source) + ROW_FLAGS_OFFSET);
+}
+
+KeyType serializedKeyType(void* source)
+{
+    return (*serializedFlags(source) & ROW_FLAG_COMPOSITE_KEY) ? KEY_COMPOSITE : KEY_INTEGER;
+}
+
+bool isRowDeleted(void* source)
+{
+    return (*serializedFlags(source) & ROW_FLAG_DELETED) != 0;
 }
 
-// Copy data from file into a row 
+// Only the flag is set, the rest of the row stays intact to make undo possible
+void markRowDeleted(void* source)
+{
+    *serializedFlags(source) |= ROW_FLAG_DELETED;
+}
+
+// Copy data from file into a row. The value is not read, 
+// so overflow pages are only touched when the value is needed
 void deserializeRow(void* source, Row* destination) 
 {
     char* srcPtr = static_cast<char*>(source);
-    memcpy(&(destination->id), srcPtr + ID_OFFSET, ID_SIZE);
-    memcpy(&(destination->username), srcPtr + USERNAME_OFFSET, USERNAME_SIZE);
-    memcpy(&(destination->email), srcPtr + EMAIL_OFFSET, EMAIL_SIZE);
+    destination->keyType = serializedKeyType(source);
+    destination->key = readKey(destination->keyType, srcPtr + ROW_KEY_OFFSET);
+    srcPtr += ROW_KEY_OFFSET + keySize(destination->keyType);
+
+    uint8_t usernameLength = static_cast<uint8_t>(*srcPtr);
+    memcpy(destination->username, srcPtr + STRING_LENGTH_SIZE, usernameLength);
+    destination->username[usernameLength] = '\0';
+    srcPtr += STRING_LENGTH_SIZE + usernameLength;
+
+    uint8_t emailLength = static_cast<uint8_t>(*srcPtr);
+    memcpy(destination->email, srcPtr + STRING_LENGTH_SIZE, emailLength);
+    destination->email[emailLength] = '\0';
+
+    destination->value.clear();
 }
 
-void printRow(Row* row)
+// Read the whole value of a serialized row, following its overflow pages
+void deserializeValue(const std::shared_ptr<Pager>& pager, void* source, Row* destination)
 {
-    if (row->id == 0) // row is marked as deleted
-        return;
+    ValueReader reader(pager, source);
+    destination->value.clear();
+    destination->value.reserve(reader.getLength());
 
-    std::cout << "(" << row->id << ", " << row->username
-              << ", " << row->email << ")" << std::endl;
+    const char* data;
+    uint32_t length;
+    while (reader.nextChunk(data, length))
+    {
+        destination->value.append(data, length);
+    }
 }
 
-Table::Table(std::unique_ptr<Pager> pager, uint32_t rootPageNumber) : 
-    pager(std::move(pager)), 
-    rootPageNumber(rootPageNumber) { }
+Key serializedKey(void* source)
+{
+    return readKey(serializedKeyType(source), static_cast<char*>(source) + ROW_KEY_OFFSET);
+}
 
-std::unique_ptr<Cursor> tableStart(std::shared_ptr<Table>& table)
+// Username of a serialized row, pointing into the row
+std::string_view serializedUsername(void* source)
 {
-    // Search for the lowest id node
-    std::unique_ptr<Cursor> cursor =  tableFindKey(table, 0);
-    
-    void* node = table->pager->getPage(cursor->pageNumber);
-    uint32_t cellCount = *leafGetCellCount(node);
-    cursor->endOfTable = (cellCount == 0);
+    char* srcPtr = static_cast<char*>(source) + ROW_KEY_OFFSET + keySize(serializedKeyType(source));
+    return std::string_view(srcPtr + STRING_LENGTH_SIZE, static_cast<uint8_t>(*srcPtr));
+}
 
-    return cursor;
+// Email of a serialized row, pointing into the row
+std::string_view serializedEmail(void* source)
+{
+    std::string_view username = serializedUsername(source);
+    const char* srcPtr = username.data() + username.size();
+    return std::string_view(srcPtr + STRING_LENGTH_SIZE, static_cast<uint8_t>(*srcPtr));
 }
 
-// Return the position of a given key. 
-// If the key is not present, return the position where it should be inserted
-std::unique_ptr<Cursor> tableFindKey(std::shared_ptr<Table>& table, const uint32_t key)
+// Pointer to the value length of a serialized row
+static char* serializedValue(void* source)
 {
-    uint32_t rootPageNumber = table->rootPageNumber;
-    void* rootNode = table->pager->getPage(rootPageNumber);
+    char* srcPtr = static_cast<char*>(source) + ROW_KEY_OFFSET + keySize(serializedKeyType(source));
+    srcPtr += STRING_LENGTH_SIZE + static_cast<uint8_t>(*srcPtr); // username
+    srcPtr += STRING_LENGTH_SIZE + static_cast<uint8_t>(*srcPtr); // email
+    return srcPtr;
+}
 
-    if (nodeGetType(rootNode) == NODE_LEAF)
+// First overflow page of a serialized row, INVALID_PAGE_NUM if the value is stored inline
+uint32_t serializedOverflowPage(void* source)
+{
+    char* valuePtr = serializedValue(source);
+    uint32_t valueLength;
+    memcpy(&valueLength, valuePtr, VALUE_LENGTH_SIZE);
+    if (valueLength <= VALUE_INLINE_SIZE)
     {
-        return findLeafNode(table, rootPageNumber, key);
+        return INVALID_PAGE_NUM;
     }
-    else
+
+    uint32_t overflowPage;
+    memcpy(&overflowPage, valuePtr + VALUE_LENGTH_SIZE + VALUE_INLINE_SIZE, VALUE_OVERFLOW_PAGE_SIZE);
+    return overflowPage;
+}
+
+// Put a chain of overflow pages on the free list of the file
+void releaseOverflow(const std::shared_ptr<Pager>& pager, uint32_t pageNumber)
+{
+    while (pageNumber != INVALID_PAGE_NUM)
     {
-        return findInternalNode(table, rootPageNumber, key);
+        uint32_t nextPage = *overflowGetNextPage(pager->getPage(pageNumber));
+        pager->releasePage(pageNumber);
+        pageNumber = nextPage;
     }
 }
 
-std::shared_ptr<Table> openDatabase(std::string filename)
+// Write the part of the value that doesn't fit inline into a chain of overflow pages.
+// Pages of an old chain starting at reusePage are overwritten before new pages are taken.
+// Return the first page of the chain, INVALID_PAGE_NUM if the value fits inline
+uint32_t writeOverflow(const std::shared_ptr<Pager>& pager, Row* row, uint32_t reusePage)
 {
-    std::shared_ptr<Table> table = std::make_shared<Table>(openPager(filename), 0);
+    if (row->value.size() <= VALUE_INLINE_SIZE)
+    {
+        releaseOverflow(pager, reusePage);
+        return INVALID_PAGE_NUM;
+    }
+
+    const char* data = row->value.data() + VALUE_INLINE_SIZE;
+    size_t remaining = row->value.size() - VALUE_INLINE_SIZE;
 
-    if (table->pager->getPageCount() == 0)
+    bool reusing = (reusePage != INVALID_PAGE_NUM);
+    uint32_t firstPage = reusing ? reusePage : pager->getUnusedPageNumber();
+    uint32_t pageNumber = firstPage;
+    while (true)
     {
-        // New database file. Initialize page 0 as leaf node
-        void* rootNode = table->pager->getPage(0);
-        leafInitialize(rootNode);
-        setRootNode(rootNode, true);
+        void* page = pager->getPage(pageNumber);
+        uint32_t oldNextPage = reusing ? *overflowGetNextPage(page) : INVALID_PAGE_NUM;
+
+        uint32_t chunkLength = static_cast<uint32_t>(
+            std::min(remaining, static_cast<size_t>(OVERFLOW_SPACE_FOR_DATA)));
+        memcpy(overflowGetData(page), data, chunkLength);
+        *overflowGetDataLength(page) = chunkLength;
+        data += chunkLength;
+        remaining -= chunkLength;
+
+        if (remaining == 0)
+        {
+            // Pages left over from a longer old chain go to the free list
+            *overflowGetNextPage(page) = INVALID_PAGE_NUM;
+            releaseOverflow(pager, oldNextPage);
+            return firstPage;
+        }
+
+        reusing = (oldNextPage != INVALID_PAGE_NUM);
+        uint32_t nextPage = reusing ? oldNextPage : pager->getUnusedPageNumber();
+        *overflowGetNextPage(page) = nextPage;
+        pageNumber = nextPage;
     }
+}
+
+ValueReader::ValueReader(const std::shared_ptr<Pager>& pager, void* source) :
+    pager(pager.get()), inlineRead(false)
+{
+    char* valuePtr = serializedValue(source);
+    memcpy(&valueLength, valuePtr, VALUE_LENGTH_SIZE);
+    inlineData = valuePtr + VALUE_LENGTH_SIZE;
+    inlineLength = std::min(valueLength, VALUE_INLINE_SIZE);
+    nextPageNumber = serializedOverflowPage(source);
+}
 
-    return table;
+uint32_t ValueReader::getLength() const
+{
+    return valueLength;
 }
 
-std::shared_ptr<Table> createDatabase(std::string filename)
+// Point data at the next part of the value without copying it.
+// Return false when the whole value was read
+bool ValueReader::nextChunk(const char*& data, uint32_t& length)
 {
-    std::shared_ptr<Table> table = std::make_shared<Table>(createPager(filename), 0);
+    if (!inlineRead)
+    {
+        inlineRead = true;
+        if (inlineLength > 0)
+        {
+            data = inlineData;
+            length = inlineLength;
+            return true;
+        }
+    }
 
-    if (table->pager->getPageCount() == 0)
+    if (nextPageNumber == INVALID_PAGE_NUM)
     {
-        // New database file. Initialize page 0 as leaf node
-        void* rootNode = table->pager->getPage(0);
-        leafInitialize(rootNode);
-        setRootNode(rootNode, true);
+        return false;
     }
 
-    return table;
+    void* page = pager->readPage(nextPageNumber);
+    data = overflowGetData(page);
+    length = *overflowGetDataLength(page);
+    nextPageNumber = *overflowGetNextPage(page);
+    return true;
 }
 
-// Delete a .db file by a given filename
-std::shared_ptr<Table> dropDatabase(std::string filename)
+// Integer keys are printed as is, composite keys as prefix:id
+std::string keyToString(const Key& key, KeyType keyType)
 {
-    if (!DeleteFileA(filename.c_str()))
+    if (keyType == KEY_COMPOSITE)
     {
-        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        return std::to_string(key.prefix) + ":" + std::to_string(key.id);
+    }
+    return std::to_string(key.id);
+}
+
+void printRow(Row* row)
+{
+    std::string key = keyToString(row->key, row->keyType);
+    if (row->value.empty())
+    {
+        std::cout << "(" << key << ", " << row->username
+                  << ", " << row->email << ")" << std::endl;
+    }
+    else
+    {
+        std::cout << "(" << key << ", " << row->username
+                  << ", " << row->email << ", " << row->value << ")" << std::endl;
+    }
+}
+
+bool parseRowColumn(std::string_view name, RowColumn& column)
+{
+    static const char* names[] = { "id", "username", "email", "value" };
+    for (uint8_t i = 0; i <= COLUMN_VALUE; i++)
+    {
+        if (name == names[i])
         {
-            throw std::exception("File not found.");
+            column = static_cast<RowColumn>(i);
+            return true;
         }
-        else if (GetLastError() == ERROR_SHARING_VIOLATION)
+    }
+    return false;
+}
+
+// Print columns of a serialized row straight from the page, nothing is copied into a Row.
+// Without columns the whole row is printed like printRow does
+void printSerializedRow(std::ostream& out, const std::shared_ptr<Pager>& pager, void* source,
+                        const std::vector<RowColumn>& columns)
+{
+    static const std::vector<RowColumn> rowColumns = { COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL };
+    static const std::vector<RowColumn> valueColumns = { COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL, COLUMN_VALUE };
+
+    const std::vector<RowColumn>* printed = &columns;
+    if (columns.empty())
+    {
+        printed = ValueReader(pager, source).getLength() > 0 ? &valueColumns : &rowColumns;
+    }
+
+    out << "(";
+    for (size_t i = 0; i < printed->size(); i++)
+    {
+        if (i > 0)
         {
-            throw std::exception("Can't drop while table is open.");
+            out << ", ";
         }
-        else
+
+        switch ((*printed)[i])
+        {
+        case COLUMN_ID:
+        {
+            KeyType keyType = serializedKeyType(source);
+            out << keyToString(readKey(keyType, static_cast<char*>(source) + ROW_KEY_OFFSET), keyType);
+            break;
+        }
+        case COLUMN_USERNAME:
+            out << serializedUsername(source);
+            break;
+        case COLUMN_EMAIL:
+            out << serializedEmail(source);
+            break;
+        case COLUMN_VALUE:
         {
-            throw std::runtime_error("Unable to delete file.");
+            ValueReader value(pager, source);
+            const char* data;
+            uint32_t length;
+            while (value.nextChunk(data, length))
+            {
+                out.write(data, length);
+            }
+            break;
+        }
         }
     }
-
-    return nullptr;
+    out << ")" << std::endl;
 }
 
-// Save, then free memory and close table
-void saveAndCloseDatabase(const std::shared_ptr<Table>& table)
+// Record of the binary protocol: the columns in the order of the select, every
+// column if there are none. The id is its key type and key bytes, the username and
+// the email have a 1-byte length and the value a 4-byte one, like in a leaf
+void writeSerializedRow(std::ostream& out, const std::shared_ptr<Pager>& pager, void* source,
+                        const std::vector<RowColumn>& columns)
 {
-    for (uint32_t i = 0; i < table->pager->getPageCount(); i++)
+    static const std::vector<RowColumn> allColumns = { COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL, COLUMN_VALUE };
+
+    for (RowColumn column : columns.empty() ? allColumns : columns)
     {
-        if (table->pager->pages[i] == NULL)
+        switch (column)
         {
-            continue;
+        case COLUMN_ID:
+        {
+            KeyType keyType = serializedKeyType(source);
+            out.put(static_cast<char>(keyType));
+            out.write(static_cast<char*>(source) + ROW_KEY_OFFSET, keySize(keyType));
+            break;
+        }
+        case COLUMN_USERNAME:
+        case COLUMN_EMAIL:
+        {
+            std::string_view text = column == COLUMN_USERNAME ? serializedUsername(source) : serializedEmail(source);
+            out.put(static_cast<char>(text.size()));
+            out.write(text.data(), text.size());
+            break;
+        }
+        case COLUMN_VALUE:
+        {
+            ValueReader value(pager, source);
+            uint32_t valueLength = value.getLength();
+            out.write(reinterpret_cast<const char*>(&valueLength), VALUE_LENGTH_SIZE);
+            const char* data;
+            uint32_t length;
+            while (value.nextChunk(data, length))
+            {
+                out.write(data, length);
+            }
+            break;
+        }
         }
-        table->pager->pagerFlush(i);
-        delete table->pager->pages[i];
-        table->pager->pages[i] = NULL;
     }
+}
 
-    if (CloseHandle(table->pager->getFileHandle()) == 0)
+Table::Table(std::shared_ptr<Pager> pager, uint32_t rootPageNumber, KeyType keyType) : 
+    pager(std::move(pager)), 
+    rootPageNumber(rootPageNumber),
+    keyType(keyType),
+    catalog(nullptr) { }
+
+// Indexes and the catalog are in the same file as the table, so they are written 
+// and committed together with it. Inside a transaction of the thread the copies
+// are left to the transaction
+TableWriter::TableWriter(const std::shared_ptr<Table>& table) :
+    pager(table->pager), lock(table->pager->writeMutex, std::defer_lock), 
+    uncaughtExceptions(std::uncaught_exceptions())
+{
+    if (pager->inTransaction())
     {
-        throw std::runtime_error("Error closing db file.");
+        return;
     }
 
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++)
+    lock.lock();
+    pager->beginWrite();
+}
+
+// A statement that stopped halfway leaves its transaction half done, so all of it is undone
+TableWriter::~TableWriter()
+{
+    bool failed = std::uncaught_exceptions() > uncaughtExceptions;
+    if (!lock.owns_lock())
     {
-        void* page = table->pager->pages[i];
-        if (page)
+        if (failed)
         {
-            free(page);
-            table->pager->pages[i] = NULL;
+            pager->rollbackTransaction();
         }
+        return;
     }
+
+    if (failed)
+    {
+        pager->discardWrite();
+        return;
+    }
+    pager->commitWrite();
 }
 
-// Save table without closing
-void saveTable(const std::shared_ptr<Table>& table)
+std::unique_ptr<Cursor> tableStart(std::shared_ptr<Table>& table)
 {
-    for (uint32_t i = 0; i < table->pager->getPageCount(); i++)
+    // Search for the lowest key node
+    std::unique_ptr<Cursor> cursor =  tableFindKey(table, MIN_KEY);
+    
+    void* node = table->pager->readPage(cursor->pageNumber);
+    uint32_t cellCount = *leafGetCellCount(node);
+    cursor->endOfTable = (cellCount == 0);
+
+    return cursor;
+}
+
+// Return the position of the first key not less than the given key,
+// moving on to the next leaf if every key of the found leaf is less
+std::unique_ptr<Cursor> tableSeek(std::shared_ptr<Table>& table, const Key& key)
+{
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+
+    void* node = table->pager->readPage(cursor->pageNumber);
+    if (cursor->cellCount >= *leafGetCellCount(node))
     {
-        if (table->pager->pages[i] == NULL)
+        uint32_t nextPageNum = *leafGetNextLeaf(node);
+        if (nextPageNum == 0)
         {
-            continue;
+            cursor->endOfTable = true;
         }
-        table->pager->pagerFlush(i);
+        else
+        {
+            cursor->pageNumber = nextPageNum;
+            cursor->cellCount = 0;
+        }
+    }
+
+    return cursor;
+}
+
+// Return the position of the last key not greater than the given key,
+// moving back to the previous leaf if every key of the found leaf is greater
+std::unique_ptr<Cursor> tableSeekLast(std::shared_ptr<Table>& table, const Key& key)
+{
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+
+    void* node = table->pager->readPage(cursor->pageNumber);
+    if (cursor->cellCount < *leafGetCellCount(node) &&
+        leafGetKey(node, cursor->cellCount) == key)
+    {
+        return cursor;
+    }
+
+    (*cursor)--;
+    return cursor;
+}
+
+// Return the position of the last row of the table
+std::unique_ptr<Cursor> tableEnd(std::shared_ptr<Table>& table)
+{
+    return tableSeekLast(table, maxKey(table->keyType));
+}
+
+// Return the position of a given key. 
+// If the key is not present, return the position where it should be inserted
+std::unique_ptr<Cursor> tableFindKey(std::shared_ptr<Table>& table, const Key& key)
+{
+    // The descent reads the same snapshot the cursor keeps
+    Snapshot snapshot;
+
+    // Root stays on the same page when it splits
+    uint32_t rootPageNumber = table->rootPageNumber;
+    void* rootNode = table->pager->readPage(rootPageNumber);
+
+    if (nodeGetType(rootNode) == NODE_LEAF)
+    {
+        return findLeafNode(table, rootPageNumber, key);
+    }
+    else
+    {
+        return findInternalNode(table, rootPageNumber, key);
     }
 }
 
-// Free memory withount closing
+// Save, then free memory and close the database file of a table.
+// Every table of the file is closed with it
+void saveAndCloseDatabase(const std::shared_ptr<Table>& table)
+{
+    saveTable(table);
+    freeTable(table);
+
+    if (CloseHandle(table->pager->getFileHandle()) == 0)
+    {
+        throw std::runtime_error("Error closing db file.");
+    }
+}
+
+// Write every changed page of the database file of a table without closing
+void saveTable(const std::shared_ptr<Table>& table)
+{
+    table->pager->checkpoint();
+}
+
+// Free cached pages of the database file of a table withount closing
 void freeTable(const std::shared_ptr<Table>& table)
 {
     for (uint32_t i = 0; i < table->pager->getPageCount(); i++)
     {
-        if (table->pager->pages[i] == NULL)
-        {
-            continue;
-        }
-        delete table->pager->pages[i];
-        table->pager->pages[i] = NULL;
+        table->pager->freePage(i);
     }
 }
 
 void* cursorValue(std::unique_ptr<Cursor>& cursor)
 {
     uint32_t pageNumber = cursor->pageNumber;
-    void* page = cursor->table->pager->getPage(pageNumber);
+    void* page = cursor->table->pager->readPage(pageNumber);
 
     return leafGetValue(page, cursor->cellCount);
 }
@@ -180,7 +545,7 @@ void* cursorValue(std::unique_ptr<Cursor>& cursor)
 void cursorAdvance(std::unique_ptr<Cursor>& cursor)
 {
     uint32_t pageNumber = cursor->pageNumber;
-    void* node = cursor->table->pager->getPage(pageNumber);
+    void* node = cursor->table->pager->readPage(pageNumber);
 
     cursor->cellCount += 1;
     if (cursor->cellCount >= (*leafGetCellCount(node)))
@@ -203,7 +568,7 @@ void cursorAdvance(std::unique_ptr<Cursor>& cursor)
 // Same as cursorAdvance
 Cursor& Cursor::operator++(int)
 {
-    void* node = this->table->pager->getPage(pageNumber);
+    void* node = this->table->pager->readPage(pageNumber);
     
     cellCount += 1;
     if (cellCount >= (*leafGetCellCount(node)))
@@ -225,153 +590,398 @@ Cursor& Cursor::operator++(int)
     return *this;
 }
 
+// Move back by one position. Moving back from the first element
+// sets endOfTable, since the cursor is outside of the table either way
+Cursor& Cursor::operator--(int)
+{
+    if (cellCount > 0)
+    {
+        cellCount -= 1;
+        return *this;
+    }
+
+    void* node = this->table->pager->readPage(pageNumber);
+    uint32_t prevPageNum = *leafGetPrevLeaf(node);
+    if (prevPageNum == 0)
+    {
+        // This was leftmost leaf
+        endOfTable = true;
+        return *this;
+    }
+
+    // Only an empty root leaf has no cells
+    pageNumber = prevPageNum;
+    cellCount = *leafGetCellCount(this->table->pager->readPage(pageNumber)) - 1;
+
+    return *this;
+}
+
 // Inserts a new key-value pair into the leaf node of the B-tree
-void leafInsert(std::unique_ptr<Cursor>& cursor, const uint32_t key, Row* value)
+void leafInsert(std::unique_ptr<Cursor>& cursor, Row* value)
 {
     void* node = cursor->table->pager->getPage(cursor->pageNumber);
+    uint32_t overflowPage = writeOverflow(cursor->table->pager, value, INVALID_PAGE_NUM);
 
-    // Check if node is full
-    uint32_t cellCount = *leafGetCellCount(node);
-    if (cellCount >= LEAF_NODE_MAX_CELLS)
+    // Check if node has space for the new cell and its slot
+    uint32_t cellLength = LEAF_NODE_CELL_HEADER_SIZE + serializedRowSize(value);
+    if (leafGetFreeSpace(node) < cellLength + LEAF_NODE_SLOT_SIZE)
     {
         // Node full
-        leafSplitAndInsert(cursor, key, value);
+        leafSplitAndInsert(cursor, value, overflowPage);
         return;
     }
 
-    // Make room for new cell if necessary
-    if (cursor->cellCount < cellCount)
+    // Only the 2-byte slots after the cursor are shifted
+    leafAllocateCell(node, cursor->cellCount, cellLength);
+    serializeRow(value, leafGetValue(node, cursor->cellCount), overflowPage);
+
+    updateSubtreeCounts(cursor->table, cursor->pageNumber);
+}
+
+// Number of sorted rows, starting at the first one, that belong to the leaf 
+// the first row was found in: the keys up to the largest key of the leaf, 
+// or every key if it is the last leaf
+static uint32_t leafRowRun(void* node, Row* const* rows, uint32_t rowCount)
+{
+    uint32_t cellCount = *leafGetCellCount(node);
+    if (*leafGetNextLeaf(node) == 0 || cellCount == 0)
     {
-        for (uint32_t i = cellCount; i > cursor->cellCount; i--)
+        return rowCount;
+    }
+
+    Key maxKey = leafGetKey(node, cellCount - 1);
+    uint32_t run = 1;
+    while (run < rowCount && !(maxKey < rows[run]->key))
+    {
+        run++;
+    }
+    return run;
+}
+
+// Return true if a live row of the table has the key of one of the sorted rows.
+// Rows that land in the same leaf are checked with one descent
+bool tableHasAnyKey(std::shared_ptr<Table>& table, const std::vector<Row*>& rows)
+{
+    uint32_t rowCount = static_cast<uint32_t>(rows.size());
+    for (uint32_t first = 0; first < rowCount;)
+    {
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, rows[first]->key);
+        void* node = table->pager->readPage(cursor->pageNumber);
+        uint32_t run = leafRowRun(node, rows.data() + first, rowCount - first);
+
+        uint32_t cellCount = *leafGetCellCount(node);
+        for (uint32_t i = first; i < first + run; i++)
         {
-            memcpy(leafGetCell(node, i), leafGetCell(node, i - 1),
-                   LEAF_NODE_CELL_SIZE);
+            uint32_t cell = leafFindCell(node, rows[i]->key);
+            if (cell < cellCount && leafGetKey(node, cell) == rows[i]->key &&
+                !isRowDeleted(leafGetValue(node, cell)))
+            {
+                return true;
+            }
         }
+        first += run;
+    }
+    return false;
+}
+
+// Insert sorted rows with keys that aren't live in the table yet.
+// Rows that land in the same leaf are inserted together after one descent
+void tableInsertRows(std::shared_ptr<Table>& table, const std::vector<Row*>& rows)
+{
+    uint32_t rowCount = static_cast<uint32_t>(rows.size());
+    for (uint32_t first = 0; first < rowCount;)
+    {
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, rows[first]->key);
+        void* node = table->pager->readPage(cursor->pageNumber);
+        uint32_t run = leafRowRun(node, rows.data() + first, rowCount - first);
+
+        leafInsertRows(table, cursor->pageNumber, const_cast<Row**>(rows.data()) + first, run);
+        first += run;
+    }
+}
+
+// Merges sorted rows into a leaf at once. The old cells and the new rows are written
+// in key order into the leaf, and into new leaves linked after it when they don't fit,
+// so a run of rows costs one rebuild of the leaf instead of a shift per row.
+// Deleted rows with the key of a new row are replaced
+void leafInsertRows(std::shared_ptr<Table>& table, uint32_t pageNumber, Row** rows, uint32_t rowCount)
+{
+    const std::shared_ptr<Pager>& pager = table->pager;
+    void* node = pager->getPage(pageNumber);
+
+    char oldCopy[PAGE_SIZE];
+    memcpy(oldCopy, node, PAGE_SIZE);
+    uint32_t oldCellCount = *leafGetCellCount(oldCopy);
+    uint32_t nextPageNumber = *leafGetNextLeaf(oldCopy);
+    Key oldMax = oldCellCount > 0 ? leafGetKey(oldCopy, oldCellCount - 1) : MIN_KEY;
+
+    // Cells in key order, either an old cell or a new row
+    struct MergedCell
+    {
+        uint32_t oldCell;
+        Row* row;
+        uint32_t length;
+        uint32_t overflowPage;
+    };
+    std::vector<MergedCell> cells;
+    cells.reserve(oldCellCount + rowCount);
+
+    uint32_t oldCell = 0;
+    for (uint32_t i = 0; i < rowCount; i++)
+    {
+        Row* row = rows[i];
+        while (oldCell < oldCellCount && leafGetKey(oldCopy, oldCell) < row->key)
+        {
+            cells.push_back({ oldCell, nullptr, *leafGetCellLength(oldCopy, oldCell), INVALID_PAGE_NUM });
+            oldCell++;
+        }
+        if (oldCell < oldCellCount && leafGetKey(oldCopy, oldCell) == row->key)
+        {
+            releaseOverflow(pager, serializedOverflowPage(leafGetValue(oldCopy, oldCell)));
+            oldCell++;
+        }
+
+        uint32_t overflowPage = writeOverflow(pager, row, INVALID_PAGE_NUM);
+        cells.push_back({ 0, row, LEAF_NODE_CELL_HEADER_SIZE + serializedRowSize(row), overflowPage });
+    }
+    for (; oldCell < oldCellCount; oldCell++)
+    {
+        cells.push_back({ oldCell, nullptr, *leafGetCellLength(oldCopy, oldCell), INVALID_PAGE_NUM });
+    }
+
+    // Fill the leaf from scratch, then new leaves when it's full
+    *leafGetCellCount(node) = 0;
+    *leafGetCellContentStart(node) = PAGE_SIZE;
+    *leafGetFragmentedBytes(node) = 0;
+
+    std::vector<uint32_t> pages = { pageNumber };
+    void* destinationNode = node;
+    for (const MergedCell& cell : cells)
+    {
+        if (leafGetFreeSpace(destinationNode) < cell.length + LEAF_NODE_SLOT_SIZE)
+        {
+            uint32_t newPageNumber = pager->getUnusedPageNumber();
+            void* newNode = pager->getPage(newPageNumber);
+            leafInitialize(newNode, nodeGetKeyType(node));
+            *leafGetPrevLeaf(newNode) = pages.back();
+            *leafGetNextLeaf(destinationNode) = newPageNumber;
+
+            pages.push_back(newPageNumber);
+            destinationNode = newNode;
+        }
+
+        uint32_t indexInNode = *leafGetCellCount(destinationNode);
+        void* destination = leafAllocateCell(destinationNode, indexInNode, cell.length);
+        if (cell.row != nullptr)
+        {
+            serializeRow(cell.row, leafGetValue(destinationNode, indexInNode), cell.overflowPage);
+        }
+        else
+        {
+            memcpy(destination, leafGetCell(oldCopy, cell.oldCell), cell.length);
+        }
+    }
+
+    // The last leaf takes over the old next link
+    *leafGetNextLeaf(destinationNode) = nextPageNumber;
+    if (nextPageNumber != 0)
+    {
+        *leafGetPrevLeaf(pager->getPage(nextPageNumber)) = pages.back();
+    }
+
+    if (pages.size() == 1)
+    {
+        updateSubtreeCounts(table, pageNumber);
+        return;
     }
 
-    *(leafGetCellCount(node)) += 1;
-    *(leafGetKey(node, cursor->cellCount)) = key;
-    serializeRow(value, leafGetValue(node, cursor->cellCount));
+    // Add the new leaves to the parent one by one, in key order. Each new leaf
+    // goes next to the previous one, the parent may split in between
+    if (isRootNode(node))
+    {
+        // The old root leaf is copied to a new left child
+        createNewRootNode(table, pages[1]);
+        pages[0] = *internalGetChild(pager->getPage(table->rootPageNumber), 0);
+    }
+    else
+    {
+        uint32_t parentPageNumber = *getParent(node);
+        internalUpdateKey(pager->getPage(parentPageNumber), oldMax, getMaxKey(pager, node));
+        *getParent(pager->getPage(pages[1])) = parentPageNumber;
+        internalInsert(table, parentPageNumber, pages[1]);
+    }
+
+    for (size_t i = 2; i < pages.size(); i++)
+    {
+        uint32_t parentPageNumber = *getParent(pager->getPage(pages[i - 1]));
+        *getParent(pager->getPage(pages[i])) = parentPageNumber;
+        internalInsert(table, parentPageNumber, pages[i]);
+    }
+
+    for (uint32_t page : pages)
+    {
+        updateSubtreeCounts(table, page);
+    }
 }
 
 void leafUpdate(std::unique_ptr<Cursor>& cursor, Row* value)
 {
     void* node = cursor->table->pager->getPage(cursor->pageNumber);
-    serializeRow(value, leafGetValue(node, cursor->cellCount));
+
+    // Overwriting a deleted row makes it live again
+    bool wasDeleted = isRowDeleted(leafGetValue(node, cursor->cellCount));
+
+    // Overwrite overflow pages of the old value
+    uint32_t oldOverflowPage = serializedOverflowPage(leafGetValue(node, cursor->cellCount));
+    uint32_t overflowPage = writeOverflow(cursor->table->pager, value, oldOverflowPage);
+
+    uint32_t cellLength = LEAF_NODE_CELL_HEADER_SIZE + serializedRowSize(value);
+    if (leafReallocateCell(node, cursor->cellCount, cellLength) == nullptr)
+    {
+        // New value doesn't fit into the node
+        leafSplit(cursor, value, overflowPage, true);
+        return;
+    }
+
+    serializeRow(value, leafGetValue(node, cursor->cellCount), overflowPage);
+
+    if (wasDeleted)
+    {
+        updateSubtreeCounts(cursor->table, cursor->pageNumber);
+    }
 }
 
 void leafDelete(std::unique_ptr<Cursor>& cursor)
 {
     void* node = cursor->table->pager->getPage(cursor->pageNumber);
-    void* cellToDelete = leafGetValue(node, cursor->cellCount);
+    markRowDeleted(leafGetValue(node, cursor->cellCount));
 
-    // Replace key with 0 without erasing other data to make undo possible
-    uint32_t deletedKeyMarker = 0;
-    memcpy(static_cast<char*>(cellToDelete) + ID_OFFSET,
-           &deletedKeyMarker, ID_SIZE);
+    updateSubtreeCounts(cursor->table, cursor->pageNumber);
 }
 
 // Splits a leaf node and inserts a new key-value pair into the appropriate node
-void leafSplitAndInsert(std::unique_ptr<Cursor>& cursor, const uint32_t key, Row* value)
+void leafSplitAndInsert(std::unique_ptr<Cursor>& cursor, Row* value, uint32_t overflowPage)
+{
+    leafSplit(cursor, value, overflowPage, false);
+}
+
+// Splits a leaf node, then inserts the new cell at the cursor position,
+// or replaces the cell at the cursor position if replace is set
+void leafSplit(std::unique_ptr<Cursor>& cursor, Row* value, uint32_t overflowPage, bool replace)
 {
-    // Create a new node and move half the cells over.
+    // Create a new node and move half of the cell bytes over.
     // Insert the new value in one of the two nodes.
     // Update parent or create a new parent.
 
     void* oldNode = cursor->table->pager->getPage(cursor->pageNumber);
-    uint32_t oldMax = getMaxKey(cursor->table->pager, oldNode);
+    Key oldMax = getMaxKey(cursor->table->pager, oldNode);
     uint32_t newPageNumber = cursor->table->pager->getUnusedPageNumber();
     void* newNode = cursor->table->pager->getPage(newPageNumber);
-    leafInitialize(newNode);
+
+    leafInitialize(newNode, nodeGetKeyType(oldNode));
     *getParent(newNode) = *getParent(oldNode);
-    *leafGetNextLeaf(newNode) = *leafGetNextLeaf(oldNode);
+    uint32_t nextPageNumber = *leafGetNextLeaf(oldNode);
+    *leafGetNextLeaf(newNode) = nextPageNumber;
+    *leafGetPrevLeaf(newNode) = cursor->pageNumber;
     *leafGetNextLeaf(oldNode) = newPageNumber;
+    if (nextPageNumber != 0)
+    {
+        *leafGetPrevLeaf(cursor->table->pager->getPage(nextPageNumber)) = newPageNumber;
+    }
 
-    // After dividing all keys between left and right nodes,
-    // move each key to correct position, starting from the right
-    for (int32_t i = LEAF_NODE_MAX_CELLS; i >= 0; i--) 
+    // Keep a copy of the old cells, the old node gets refilled from scratch
+    char oldCopy[PAGE_SIZE];
+    memcpy(oldCopy, oldNode, PAGE_SIZE);
+    uint32_t oldCellCount = *leafGetCellCount(oldCopy);
+    uint32_t newCellLength = LEAF_NODE_CELL_HEADER_SIZE + serializedRowSize(value);
+    uint32_t totalCells = replace ? oldCellCount : oldCellCount + 1;
+
+    // Position i of the combined cell list maps to this cell of the old node
+    auto oldCellNumber = [&](uint32_t i) {
+        return (i > cursor->cellCount && !replace) ? i - 1 : i;
+    };
+    auto cellLengthAt = [&](uint32_t i) -> uint32_t {
+        if (i == cursor->cellCount)
+            return newCellLength;
+        return *leafGetCellLength(oldCopy, oldCellNumber(i));
+    };
+
+    // Divide cells so both nodes get about the same number of bytes
+    uint32_t totalBytes = 0;
+    for (uint32_t i = 0; i < totalCells; i++)
     {
-        void* destinationNode;
-        if (i >= LEAF_NODE_LEFT_SPLIT_COUNT) 
-        {
-            destinationNode = newNode;
-        } 
-        else
-        {
-            destinationNode = oldNode;
-        }
-        uint32_t indexInNode = i % LEAF_NODE_LEFT_SPLIT_COUNT;
-        void* destination = leafGetCell(destinationNode, indexInNode);
+        totalBytes += cellLengthAt(i) + LEAF_NODE_SLOT_SIZE;
+    }
+    uint32_t leftCount = 0;
+    uint32_t leftBytes = 0;
+    while (leftCount < totalCells - 1 &&
+           leftBytes + (cellLengthAt(leftCount) + LEAF_NODE_SLOT_SIZE) / 2 < totalBytes / 2)
+    {
+        leftBytes += cellLengthAt(leftCount) + LEAF_NODE_SLOT_SIZE;
+        leftCount++;
+    }
+    if (leftCount == 0)
+    {
+        leftCount = 1;
+    }
 
-        if (i == cursor->cellCount) 
-        {
-            serializeRow(value, leafGetValue(destinationNode, indexInNode));
-            *leafGetKey(destinationNode, indexInNode) = key;
-        } 
-        else if (i > cursor->cellCount)
+    *leafGetCellCount(oldNode) = 0;
+    *leafGetCellContentStart(oldNode) = PAGE_SIZE;
+    *leafGetFragmentedBytes(oldNode) = 0;
+
+    for (uint32_t i = 0; i < totalCells; i++)
+    {
+        void* destinationNode = (i < leftCount) ? oldNode : newNode;
+        uint32_t indexInNode = *leafGetCellCount(destinationNode);
+
+        if (i == cursor->cellCount)
         {
-            memcpy(destination, leafGetCell(oldNode, i - 1), LEAF_NODE_CELL_SIZE);
+            leafAllocateCell(destinationNode, indexInNode, newCellLength);
+            serializeRow(value, leafGetValue(destinationNode, indexInNode), overflowPage);
         }
         else
         {
-            memcpy(destination, leafGetCell(oldNode, i), LEAF_NODE_CELL_SIZE);
+            uint32_t source = oldCellNumber(i);
+            uint32_t cellLength = *leafGetCellLength(oldCopy, source);
+            void* destination = leafAllocateCell(destinationNode, indexInNode, cellLength);
+            memcpy(destination, leafGetCell(oldCopy, source), cellLength);
         }
     }
 
-    // Update cell count on both leaf nodes
-    *(leafGetCellCount(oldNode)) = LEAF_NODE_LEFT_SPLIT_COUNT;
-    *(leafGetCellCount(newNode)) = LEAF_NODE_RIGHT_SPLIT_COUNT;
+    Key new_max = getMaxKey(cursor->table->pager, oldNode);
 
     if (isRootNode(oldNode)) 
     {
-        return createNewRootNode(cursor->table, newPageNumber);
+        createNewRootNode(cursor->table, newPageNumber);
+        return;
     } 
     else
     {
         uint32_t parentPageNumber = *getParent(oldNode);
-        uint32_t new_max = getMaxKey(cursor->table->pager, oldNode);
         void* parent = cursor->table->pager->getPage(parentPageNumber);
 
         internalUpdateKey(parent, oldMax, new_max);
         internalInsert(cursor->table, parentPageNumber, newPageNumber);
 
+        // Parents of both halves may have changed while splitting
+        updateSubtreeCounts(cursor->table, cursor->pageNumber);
+        updateSubtreeCounts(cursor->table, newPageNumber);
+
         return;
     }
 }
 
 // Search table for a node that contains the given key
-std::unique_ptr<Cursor> findLeafNode(std::shared_ptr<Table>& table, 
-                                       uint32_t pageNumber, const uint32_t key)
+std::unique_ptr<Cursor> findLeafNode(std::shared_ptr<Table>& table, uint32_t pageNumber, 
+                                     const Key& key)
 {
-    void* node = table->pager->getPage(pageNumber);
-    uint32_t cellCount = *leafGetCellCount(node);
+    void* node = table->pager->readPage(pageNumber);
 
     std::unique_ptr<Cursor> cursor = std::make_unique<Cursor>();
     cursor->table = table;
     cursor->pageNumber = pageNumber;
-
-    // Binary search
-    uint32_t minIndex = 0;
-    uint32_t onePastMaxIndex = cellCount;
-    while (onePastMaxIndex != minIndex)
-    {
-        uint32_t index = (minIndex + onePastMaxIndex) / 2;
-        uint32_t keyAtIndex = *leafGetKey(node, index);
-        if (key == keyAtIndex)
-        {
-            cursor->cellCount = index;
-            return cursor;
-        }
-        if (key < keyAtIndex)
-        {
-            onePastMaxIndex = index;
-        }
-        else
-        {
-            minIndex = index + 1;
-        }
-    }
-    cursor->cellCount = minIndex;
+    cursor->cellCount = leafFindCell(node, key);
+    cursor->endOfTable = false;
 
     return cursor;
 }
@@ -391,8 +1001,8 @@ void createNewRootNode(std::shared_ptr<Table>& table, uint32_t rightChildPageNum
 
     if (nodeGetType(root) == NODE_INTERNAL) 
     {
-        internalInitialize(rightChild);
-        internalInitialize(leftChild);
+        internalInitialize(rightChild, table->keyType);
+        internalInitialize(leftChild, table->keyType);
     }
 
     // Left child has data copied from old root
@@ -410,28 +1020,36 @@ void createNewRootNode(std::shared_ptr<Table>& table, uint32_t rightChildPageNum
         child = table->pager->getPage(*internalGetRightChild(leftChild));
         *getParent(child) = leftChildPageNumber;
     }
+    else
+    {
+        // Root leaf was the only leaf, the new right child follows it
+        *leafGetPrevLeaf(rightChild) = leftChildPageNumber;
+    }
 
     // Root node is a new internal node with one key and two children
-    internalInitialize(root);
+    internalInitialize(root, table->keyType);
     setRootNode(root, true);
     *internalGetKeyCount(root) = 1;
     *internalGetChild(root, 0) = leftChildPageNumber;
-    uint32_t leftChildMaxKey = getMaxKey(table->pager, leftChild);
-    *internalGetKey(root, 0) = leftChildMaxKey;
+    Key leftChildMaxKey = getMaxKey(table->pager, leftChild);
+    internalSetKey(root, 0, leftChildMaxKey);
+    *internalGetChildCount(root, 0) = subtreeCount(leftChild);
     *internalGetRightChild(root) = rightChildPageNum;
+    *internalGetRightCount(root) = subtreeCount(rightChild);
     *getParent(leftChild) = table->rootPageNumber;
     *getParent(rightChild) = table->rootPageNumber;
 }
 
 // Search table for a node that contains the given key
-std::unique_ptr<Cursor> findInternalNode(std::shared_ptr<Table>& table, 
-                                         uint32_t pageNumber, const uint32_t key)
+std::unique_ptr<Cursor> findInternalNode(std::shared_ptr<Table>& table, uint32_t pageNumber, 
+                                         const Key& key)
 {
-    void* node = table->pager->getPage(pageNumber);
+    void* node = table->pager->readPage(pageNumber);
 
     uint32_t childIndex = internalFindChild(node, key);
     uint32_t childNum = *internalGetChild(node, childIndex);
-    void* child = table->pager->getPage(childNum);
+    void* child = table->pager->readPage(childNum);
+
     switch (nodeGetType(child)) 
     {
         case NODE_LEAF:
@@ -443,40 +1061,13 @@ std::unique_ptr<Cursor> findInternalNode(std::shared_ptr<Table>& table,
     }
 }
 
-// Return the index of the child which should contain the given key
-uint32_t internalFindChild(void* node, const uint32_t key)
-{
-    uint32_t numKeys = *internalGetKeyCount(node);
-
-    //Binary search
-    uint32_t minIndex = 0;
-    uint32_t maxIndex = numKeys; // there is one more child than key
-
-    while (minIndex != maxIndex) 
-    {
-        uint32_t index = (minIndex + maxIndex) / 2;
-        uint32_t keyToRight = *internalGetKey(node, index);
-
-        if (keyToRight >= key) 
-        {
-            maxIndex = index;
-        } 
-        else
-        {
-            minIndex = index + 1;
-        }
-    }
-
-    return minIndex;
-}
-
 void internalInsert(std::shared_ptr<Table>& table, uint32_t parentPageNumber,
                     uint32_t childPageNumber)
 {
     // Add a new child/key pair to parent that corresponds to child
     void* parent = table->pager->getPage(parentPageNumber);
     void* child = table->pager->getPage(childPageNumber);
-    uint32_t childMaxKey = getMaxKey(table->pager, child);
+    Key childMaxKey = getMaxKey(table->pager, child);
     uint32_t index = internalFindChild(parent, childMaxKey);
 
     uint32_t originalKeyCount = *internalGetKeyCount(parent);
@@ -492,6 +1083,7 @@ void internalInsert(std::shared_ptr<Table>& table, uint32_t parentPageNumber,
     // An internal node with a right child of INVALID_PAGE_NUM is empty
     if (rightChildPageNum == INVALID_PAGE_NUM) {
         *internalGetRightChild(parent) = childPageNumber;
+        *internalGetRightCount(parent) = subtreeCount(child);
         return;
     }
 
@@ -506,9 +1098,12 @@ void internalInsert(std::shared_ptr<Table>& table, uint32_t parentPageNumber,
 
     if (childMaxKey > getMaxKey(table->pager, rightChild)) {
         /* Replace right child */
+        uint64_t rightChildCount = *internalGetRightCount(parent);
         *internalGetChild(parent, originalKeyCount) = rightChildPageNum;
-        *internalGetKey(parent, originalKeyCount) =  getMaxKey(table->pager, rightChild);
+        *internalGetChildCount(parent, originalKeyCount) = rightChildCount;
+        internalSetKey(parent, originalKeyCount, getMaxKey(table->pager, rightChild));
         *internalGetRightChild(parent) = childPageNumber;
+        *internalGetRightCount(parent) = subtreeCount(child);
     } 
     else
     {
@@ -517,22 +1112,25 @@ void internalInsert(std::shared_ptr<Table>& table, uint32_t parentPageNumber,
         {
             void* destination = internalGetCell(parent, i);
             void* source = internalGetCell(parent, i - 1);
-            memcpy(destination, source, INTERNAL_NODE_CELL_SIZE);
+            memcpy(destination, source, internalGetCellSize(parent));
         }
         *internalGetChild(parent, index) = childPageNumber;
-        *internalGetKey(parent, index) = childMaxKey;
+        *internalGetChildCount(parent, index) = subtreeCount(child);
+        internalSetKey(parent, index, childMaxKey);
     }
 }
 
+// Splits a full internal node. The new node gets the upper children, 
+// like a leaf split
 void internalSplitAndInsert(std::shared_ptr<Table>& table, uint32_t parentPageNumber,
                           uint32_t childPageNumber) 
 {
     uint32_t oldPageNumber = parentPageNumber;
     void* oldNode = table->pager->getPage(parentPageNumber);
-    uint32_t oldMax = getMaxKey(table->pager, oldNode);
+    Key oldMax = getMaxKey(table->pager, oldNode);
 
     void* child = table->pager->getPage(childPageNumber); 
-    uint32_t maxChild = getMaxKey(table->pager, child);
+    Key maxChild = getMaxKey(table->pager, child);
 
     uint32_t newPageNumber = table->pager->getUnusedPageNumber();
 
@@ -542,7 +1140,7 @@ void internalSplitAndInsert(std::shared_ptr<Table>& table, uint32_t parentPageNu
     // Otherwise, insert the created node into ints parent
 
     void* parent;
-    void* newNode;
+    void* newNode = table->pager->getPage(newPageNumber);
     if (splittingRoot)
     {
         createNewRootNode(table, newPageNumber);
@@ -557,8 +1155,7 @@ void internalSplitAndInsert(std::shared_ptr<Table>& table, uint32_t parentPageNu
     else 
     {
         parent = table->pager->getPage(*getParent(oldNode));
-        newNode = table->pager->getPage(newPageNumber);
-        internalInitialize(newNode);
+        internalInitialize(newNode, table->keyType);
     }
     
     uint32_t* oldNumKeys = internalGetKeyCount(oldNode);
@@ -586,32 +1183,213 @@ void internalSplitAndInsert(std::shared_ptr<Table>& table, uint32_t parentPageNu
 
     // Set child before middle key (its now the max child) to be node's right child,
     *internalGetRightChild(oldNode) = *internalGetChild(oldNode, *oldNumKeys - 1);
+    *internalGetRightCount(oldNode) = *internalGetChildCount(oldNode, *oldNumKeys - 1);
     (*oldNumKeys)--;
 
     // Insert the child into max node
-    uint32_t maxAfterSplit = getMaxKey(table->pager, oldNode);
+    Key maxAfterSplit = getMaxKey(table->pager, oldNode);
 
     uint32_t destinationPageNum = maxChild < maxAfterSplit ? oldPageNumber : newPageNumber;
 
     internalInsert(table, destinationPageNum, childPageNumber);
     *getParent(child) = destinationPageNum;
 
-    internalUpdateKey(parent, oldMax, getMaxKey(table->pager, oldNode));
+    Key newMax = getMaxKey(table->pager, oldNode);
 
-    if (!splittingRoot) 
+    if (splittingRoot) 
     {
-        internalInsert(table,*getParent(oldNode), newPageNumber);
-        *getParent(newNode) = *getParent(oldNode);
+        internalUpdateKey(parent, oldMax, newMax);
+        updateChildCount(table, oldPageNumber);
+        updateChildCount(table, newPageNumber);
+        return;
     }
+
+    uint32_t grandparentPageNumber = *getParent(oldNode);
+    internalUpdateKey(parent, oldMax, newMax);
+
+    // Children moved to the new node, the old count is fixed before the parent
+    // may split. The parent has to be set before inserting, since the parent 
+    // may split and move the new node under a different parent
+    updateChildCount(table, oldPageNumber);
+    *getParent(newNode) = grandparentPageNumber;
+    internalInsert(table, grandparentPageNumber, newPageNumber);
 }
 
 // Get current max key in node
-uint32_t getMaxKey(const std::unique_ptr<Pager>& pager, void* node) 
+Key getMaxKey(const std::shared_ptr<Pager>& pager, void* node) 
 {
     if (nodeGetType(node) == NODE_LEAF) 
     {
-        return *leafGetKey(node, *leafGetCellCount(node) - 1);
+        return leafGetKey(node, *leafGetCellCount(node) - 1);
     }
-    void* rightChild = pager->getPage(*internalGetRightChild(node));
+    void* rightChild = pager->readPage(*internalGetRightChild(node));
     return getMaxKey(pager, rightChild);
 }
+
+// Number of live rows under a node. Reads only the node itself,
+// internal nodes keep the counts of their children
+uint64_t subtreeCount(void* node)
+{
+    uint64_t count = 0;
+    if (nodeGetType(node) == NODE_LEAF)
+    {
+        uint32_t cellCount = *leafGetCellCount(node);
+        for (uint32_t i = 0; i < cellCount; i++)
+        {
+            if (!isRowDeleted(leafGetValue(node, i)))
+                count++;
+        }
+        return count;
+    }
+
+    uint32_t keyCount = *internalGetKeyCount(node);
+    for (uint32_t i = 0; i < keyCount; i++)
+    {
+        count += *internalGetChildCount(node, i);
+    }
+    return count + *internalGetRightCount(node);
+}
+
+// Recount rows of a node in its parent
+void updateChildCount(std::shared_ptr<Table>& table, uint32_t pageNumber)
+{
+    void* node = table->pager->getPage(pageNumber);
+    void* parent = table->pager->getPage(*getParent(node));
+
+    uint32_t childIndex = internalGetChildIndex(parent, pageNumber);
+    *internalGetChildCount(parent, childIndex) = subtreeCount(node);
+}
+
+// Recount rows of a changed node in each of its ancestors, up to the root
+void updateSubtreeCounts(std::shared_ptr<Table>& table, uint32_t pageNumber)
+{
+    void* node = table->pager->getPage(pageNumber);
+    while (!isRootNode(node))
+    {
+        uint32_t parentPageNumber = *getParent(node);
+        void* parent = table->pager->getPage(parentPageNumber);
+        uint64_t count = subtreeCount(node);
+        *internalGetChildCount(parent, internalGetChildIndex(parent, pageNumber)) = count;
+
+        pageNumber = parentPageNumber;
+        node = parent;
+    }
+}
+
+// Number of live rows in the table
+uint64_t tableCount(std::shared_ptr<Table>& table)
+{
+    Snapshot snapshot;
+    return subtreeCount(table->pager->readPage(table->rootPageNumber));
+}
+
+// Number of live rows with keys less than the given key
+uint64_t tableCountLess(std::shared_ptr<Table>& table, const Key& key)
+{
+    uint64_t count = 0;
+    Snapshot snapshot;
+    void* node = table->pager->readPage(table->rootPageNumber);
+    while (nodeGetType(node) == NODE_INTERNAL)
+    {
+        // Every key of the children to the left is less
+        uint32_t childIndex = internalFindChild(node, key);
+        for (uint32_t i = 0; i < childIndex; i++)
+        {
+            count += *internalGetChildCount(node, i);
+        }
+
+        uint32_t childPageNumber = *internalGetChild(node, childIndex);
+        node = table->pager->readPage(childPageNumber);
+    }
+
+    uint32_t cellCount = leafFindCell(node, key);
+    for (uint32_t i = 0; i < cellCount; i++)
+    {
+        if (!isRowDeleted(leafGetValue(node, i)))
+            count++;
+    }
+    return count;
+}
+
+// Number of live rows with keys in [start, end]
+uint64_t tableCountRange(std::shared_ptr<Table>& table, const Key& start, const Key& end)
+{
+    if (end < start)
+    {
+        return 0;
+    }
+
+    Key afterEnd = end;
+    uint64_t notGreater = nextKey(table->keyType, afterEnd) ? tableCountLess(table, afterEnd) 
+                                                            : tableCount(table);
+    return notGreater - tableCountLess(table, start);
+}
+
+// Return the position of the live row with the given number of live rows before it.
+// Set endOfTable if the table doesn't have that many rows
+std::unique_ptr<Cursor> tableSeekRank(std::shared_ptr<Table>& table, uint64_t rank)
+{
+    // The cursor keeps the snapshot of the descent
+    std::unique_ptr<Cursor> cursor = std::make_unique<Cursor>();
+    uint32_t pageNumber = table->rootPageNumber;
+    void* node = table->pager->readPage(pageNumber);
+    while (nodeGetType(node) == NODE_INTERNAL)
+    {
+        uint32_t keyCount = *internalGetKeyCount(node);
+        uint32_t childIndex = 0;
+        while (childIndex < keyCount && rank >= *internalGetChildCount(node, childIndex))
+        {
+            rank -= *internalGetChildCount(node, childIndex);
+            childIndex++;
+        }
+        pageNumber = *internalGetChild(node, childIndex);
+        node = table->pager->readPage(pageNumber);
+    }
+
+    cursor->table = table;
+    cursor->pageNumber = pageNumber;
+    cursor->endOfTable = true;
+
+    uint32_t cellCount = *leafGetCellCount(node);
+    for (uint32_t i = 0; i < cellCount; i++)
+    {
+        if (isRowDeleted(leafGetValue(node, i)))
+            continue;
+
+        if (rank == 0)
+        {
+            cursor->cellCount = i;
+            cursor->endOfTable = false;
+            return cursor;
+        }
+        rank--;
+    }
+
+    cursor->cellCount = cellCount;
+    return cursor;
+}
+
+// First keys of rangeCount key ranges with about the same number of live rows,
+// without the first range, which starts at the start of the table. Found by
+// descents over the row counts of internal nodes, like offsets are
+std::vector<Key> tableSplitKeys(std::shared_ptr<Table>& table, uint32_t rangeCount)
+{
+    std::vector<Key> keys;
+    uint64_t count = tableCount(table);
+    for (uint32_t i = 1; i < rangeCount; i++)
+    {
+        uint64_t rank = count * i / rangeCount;
+        std::unique_ptr<Cursor> cursor = tableSeekRank(table, rank);
+        if (cursor->endOfTable)
+        {
+            break;
+        }
+
+        Key key = leafGetKey(table->pager->readPage(cursor->pageNumber), cursor->cellCount);
+        if (keys.empty() || keys.back() < key)
+        {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
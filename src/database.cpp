@@ -1,15 +1,54 @@
+#include "../includes/server.h"
 #include "../includes/database.h"
 
+#include <fstream>
+#include <io.h>
+
+// Arguments are "[--batch script | --serve socket] [file]"
+static bool isOption(int argc, char** argv, const std::string& option)
+{
+    return argc > 2 && argv[1] == option;
+}
+
+static std::string getOptionValue(int argc, char** argv, const std::string& option)
+{
+    return isOption(argc, argv, option) ? argv[2] : "";
+}
+
+static std::string getDatabaseFilename(int argc, char** argv)
+{
+    int fileArgument = isOption(argc, argv, "--batch") || isOption(argc, argv, "--serve") ? 3 : 1;
+    return argc > fileArgument ? argv[fileArgument] : DEFAULT_DATABASE_FILENAME;
+}
+
+// Server that Ctrl+C stops
+static Server* runningServer = nullptr;
+
+static BOOL WINAPI stopServer(DWORD signal)
+{
+    if (runningServer != nullptr && (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT))
+    {
+        runningServer->stop();
+        return TRUE;
+    }
+    return FALSE;
+}
+
 Database::Database(int argc, char** argv) :
-    argc(argc), argv(argv), cachedTable(nullptr),  inputBuffer(nullptr) {}
+    tables(getDatabaseFilename(argc, argv)), inputBuffer(nullptr),
+    scriptFilename(getOptionValue(argc, argv, "--batch")), 
+    socketPath(getOptionValue(argc, argv, "--serve")), argc(argc), argv(argv) {}
 
 Database::~Database()
 { }
 
-void Database::handleMetaCommand()
+// Return false if the program should exit
+bool Database::handleMetaCommand()
 {
-    switch (doMetaCommand(inputBuffer, cachedTable))
+    switch (doMetaCommand(inputBuffer, tables))
     {
+        case MetaCommandResult::META_COMMAND_EXIT:
+            return false;
         case MetaCommandResult::META_COMMAND_SUCCESS:
             break;
         case MetaCommandResult::META_COMMAND_SYNTAX_ERROR:
@@ -18,7 +57,14 @@ void Database::handleMetaCommand()
         case MetaCommandResult::META_COMMAND_UNRECOGNIZED_COMMAND:
             printErrorMessage("Unrecognized command: " + inputBuffer->getBuffer());
             break;
+        case MetaCommandResult::META_COMMAND_TABLE_NOT_SELECTED:
+            printErrorMessage("Table not opened. Use \"create/open table [name]\" to create/open a table");
+            break;
+        case MetaCommandResult::META_COMMAND_TABLE_NOT_FOUND:
+            printErrorMessage("Table was not found.");
+            break;
     }
+    return true;
 }
 
 void Database::handleStatement()
@@ -37,6 +83,9 @@ void Database::handleStatement()
         case PrepareResult::PREPARE_SYNTAX_ERROR:
             printErrorMessage("Syntax error. Could not parse statement.");
             return;
+        case PrepareResult::PREPARE_PARAMETER_MISMATCH:
+            printErrorMessage("Value doesn't match the parameter.");
+            return;
         case PrepareResult::PREPARE_UNRECOGNIZED_STATEMENT:
             printErrorMessage("Unrecognized keyword at the start of "+ 
                                inputBuffer->getBuffer());
@@ -45,7 +94,7 @@ void Database::handleStatement()
             throw std::exception("Unknown statement.");
     }
 
-    switch (statement.executeStatement(cachedTable))
+    switch (statement.executeStatement(tables))
     {
         case ExecuteResult::EXECUTE_SUCCESS:
             std::cout << "Executed." << std::endl;
@@ -59,6 +108,9 @@ void Database::handleStatement()
         case ExecuteResult::EXECUTE_TABLE_FULL:
             std::cout << "Error: Table full." << std::endl;
             break;
+        case ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH:
+            std::cout << "Error: Key type doesn't match the table." << std::endl;
+            break;
         case ExecuteResult::EXECUTE_ERROR_WHILE_CREATING:
             std::cout << "Error: Failed to create a table. " << std::endl;
             break;
@@ -71,34 +123,134 @@ void Database::handleStatement()
         case ExecuteResult::EXECUTE_TABLE_NOT_SELECTED:
             std::cout << "Error: Table not opened. Use \"create/open table [name]\" to create/open a table" << std::endl;
             break;
-        case ExecuteResult::EXECUTE_ERROR_FILE_NOT_FOUND:
-            std::cout << "Error: Table with the name \"" + statement.getTableName() + ".db\" was not found." << std::endl;
+        case ExecuteResult::EXECUTE_TABLE_NOT_FOUND:
+            std::cout << "Error: Table with the name \"" + statement.getTableName() + "\" was not found." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_TABLE_EXISTS:
+            std::cout << "Error: Table with the name \"" + statement.getTableName() + "\" already exists." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_INDEX_EXISTS:
+            std::cout << "Error: Index already exists." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_PARAMETER_NOT_BOUND:
+            std::cout << "Error: Statement has a parameter without a value." << std::endl;
             break;
-        case ExecuteResult::EXECUTE_ERROR_FILE_EXISTS:
-            std::cout << "Error: Table with the name \"" + statement.getTableName() + ".db\" already exists." << std::endl;
+        case ExecuteResult::EXECUTE_TRANSACTION_OPEN:
+            std::cout << "Error: A transaction is already open." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_NO_TRANSACTION:
+            std::cout << "Error: No transaction is open." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_STRING_TOO_LONG:
+            std::cout << "Error: String is too long." << std::endl;
+            break;
+        case ExecuteResult::EXECUTE_PREPARE_FAILED:
+            std::cout << "Error: Syntax error. Could not parse statement." << std::endl;
             break;
         default:
             throw std::exception("Unknown statement result.");
     }
 }
 
+// Run one statement or meta command that isn't read from the input,
+// return false if it was .exit. Other sessions may still use the tables,
+// so .exit leaves them open and the caller ends its session
+bool Database::handleRequest(std::string_view text)
+{
+    if (inputBuffer == nullptr)
+    {
+        inputBuffer = std::make_shared<InputBuffer>();
+    }
+    inputBuffer->setInput(text);
+
+    if (inputBuffer->getBuffer().empty())
+    {
+        return true;
+    }
+    if (inputBuffer->getBuffer() == ".exit")
+    {
+        return false;
+    }
+    if (inputBuffer->getBuffer().front() == '.')
+    {
+        return handleMetaCommand();
+    }
+    handleStatement();
+    return true;
+}
+
+TableCache& Database::getTables()
+{
+    return tables;
+}
+
 void Database::printErrorMessage(const std::string& message)
 {
     std::cout << "Error: " << message << std::endl;
 }
 
+// Read statements until .exit or the end of the input, then save the database file.
+// A script or piped input runs in batch mode: no prompt is printed, the input
+// is read in blocks and the output is written when its buffer fills up. With
+// --serve, statements come from clients of the socket until Ctrl+C
 void Database::run()
 {
-    inputBuffer = std::make_shared<InputBuffer>();
+    if (!socketPath.empty())
+    {
+        Server server(*this, socketPath);
+        runningServer = &server;
+        SetConsoleCtrlHandler(stopServer, TRUE);
+        std::cout << "Serving " << getDatabaseFilename(argc, argv) << " on " << socketPath << std::endl;
+        server.run();
+        SetConsoleCtrlHandler(stopServer, FALSE);
+        runningServer = nullptr;
+        return;
+    }
+
+    std::ifstream script;
+    bool batch = !scriptFilename.empty() || !_isatty(_fileno(stdin));
+    if (!scriptFilename.empty())
+    {
+        script.open(scriptFilename, std::ios::binary);
+        if (!script.is_open())
+        {
+            throw std::runtime_error("Unable to open script " + scriptFilename + ".");
+        }
+        inputBuffer = std::make_shared<InputBuffer>(&script);
+    }
+    else
+    {
+        inputBuffer = batch ? std::make_shared<InputBuffer>(&std::cin) : std::make_shared<InputBuffer>();
+    }
+
+    std::unique_ptr<OutputBuffer> output;
+    if (batch)
+    {
+        output = std::make_unique<OutputBuffer>(std::cout, OUTPUT_BUFFER_SIZE);
+    }
 
     while (true)
     {
-        printPrompt();
-        inputBuffer->readInput();
+        if (!batch)
+        {
+            printPrompt();
+        }
+        if (!inputBuffer->readInput())
+        {
+            tables.closeAll();
+            return;
+        }
 
+        if (inputBuffer->getBuffer().empty())
+        {
+            continue;
+        }
         if (inputBuffer->getBuffer().front() == '.')
         {
-            handleMetaCommand();
+            if (!handleMetaCommand())
+            {
+                return;
+            }
         }
         else
         {
@@ -0,0 +1,212 @@
+#include "../includes/index.h"
+#include "../includes/catalog.h"
+
+// 64-bit FNV-1a
+uint64_t indexHash(const char* value, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<uint8_t>(value[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+const char* indexColumnName(IndexColumn column)
+{
+    switch (column)
+    {
+        case INDEX_USERNAME:
+            return "username";
+        case INDEX_EMAIL:
+            return "email";
+        default:
+            throw std::exception("Unknown index column.");
+    }
+}
+
+bool parseIndexColumn(std::string_view name, IndexColumn& column)
+{
+    for (uint8_t i = 0; i < INDEX_COUNT; i++)
+    {
+        if (name == indexColumnName(static_cast<IndexColumn>(i)))
+        {
+            column = static_cast<IndexColumn>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// users -> users.email
+std::string indexName(const std::string& tableName, IndexColumn column)
+{
+    return tableName + "." + indexColumnName(column);
+}
+
+// Index entry of a table row
+static Row indexEntry(Row* row, IndexColumn column)
+{
+    Row entry;
+    entry.keyType = KEY_COMPOSITE;
+    entry.username[0] = '\0';
+    entry.email[0] = '\0';
+
+    if (column == INDEX_USERNAME)
+    {
+        strcpy_s(entry.username, row->username);
+        entry.key = { indexHash(row->username, strnlen(row->username, COLUMN_USERNAME_SIZE)),
+                      row->key.id };
+    }
+    else
+    {
+        strcpy_s(entry.email, row->email);
+        entry.key = { indexHash(row->email, strnlen(row->email, COLUMN_EMAIL_SIZE)),
+                      row->key.id };
+    }
+
+    return entry;
+}
+
+static void indexInsertEntry(std::shared_ptr<Table>& index, IndexColumn column, Row* row)
+{
+    Row entry = indexEntry(row, column);
+    std::unique_ptr<Cursor> cursor = tableFindKey(index, entry.key);
+
+    void* node = index->pager->readPage(cursor->pageNumber);
+    if (cursor->cellCount < *leafGetCellCount(node) &&
+        leafGetKey(node, cursor->cellCount) == entry.key)
+    {
+        // Entry of a deleted row with the same value, overwrite it
+        leafUpdate(cursor, &entry);
+        return;
+    }
+
+    leafInsert(cursor, &entry);
+}
+
+static std::shared_ptr<Table> makeIndex(std::shared_ptr<Table>& table, IndexColumn column,
+                                        uint32_t rootPageNumber)
+{
+    std::shared_ptr<Table> index = std::make_shared<Table>(table->pager, rootPageNumber, KEY_COMPOSITE);
+    index->name = indexName(table->name, column);
+    index->catalog = table->catalog;
+    return index;
+}
+
+// Open indexes of the table that are in the catalog
+void openIndexes(std::shared_ptr<Table>& table)
+{
+    for (uint8_t i = 0; i < INDEX_COUNT; i++)
+    {
+        IndexColumn column = static_cast<IndexColumn>(i);
+        uint32_t rootPageNumber = catalogFind(table->catalog, CATALOG_INDEX, indexName(table->name, column));
+        if (rootPageNumber != INVALID_PAGE_NUM)
+        {
+            table->indexes[i] = makeIndex(table, column, rootPageNumber);
+        }
+    }
+}
+
+// Create an index B-tree in the file of the table and fill it with the rows already 
+// in the table. Return false if the column already has an index
+bool createIndex(std::shared_ptr<Table>& table, IndexColumn column)
+{
+    TableWriter writer(table);
+    if (table->indexes[column] != nullptr)
+    {
+        return false;
+    }
+
+    uint32_t rootPageNumber = createTree(table->pager, KEY_COMPOSITE);
+    catalogInsert(table->catalog, CATALOG_INDEX, indexName(table->name, column), rootPageNumber,
+                  std::string("create index on ") + indexColumnName(column));
+    std::shared_ptr<Table> index = makeIndex(table, column, rootPageNumber);
+
+    std::unique_ptr<Cursor> cursor = tableStart(table);
+
+    Row row;
+    while (!(cursor->endOfTable))
+    {
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source))
+        {
+            deserializeRow(source, &row);
+            indexInsertEntry(index, column, &row);
+        }
+        (*cursor)++;
+    }
+
+    table->indexes[column] = index;
+    return true;
+}
+
+void indexInsertRow(std::shared_ptr<Table>& table, Row* row)
+{
+    for (uint8_t i = 0; i < INDEX_COUNT; i++)
+    {
+        if (table->indexes[i] != nullptr)
+        {
+            indexInsertEntry(table->indexes[i], static_cast<IndexColumn>(i), row);
+        }
+    }
+}
+
+// Mark index entries of a row as deleted, same as rows of the table
+void indexDeleteRow(std::shared_ptr<Table>& table, Row* row)
+{
+    for (uint8_t i = 0; i < INDEX_COUNT; i++)
+    {
+        if (table->indexes[i] == nullptr)
+        {
+            continue;
+        }
+
+        Row entry = indexEntry(row, static_cast<IndexColumn>(i));
+        std::unique_ptr<Cursor> cursor = tableFindKey(table->indexes[i], entry.key);
+
+        void* node = table->indexes[i]->pager->readPage(cursor->pageNumber);
+        if (cursor->cellCount < *leafGetCellCount(node) &&
+            leafGetKey(node, cursor->cellCount) == entry.key)
+        {
+            leafDelete(cursor);
+        }
+    }
+}
+
+// Return primary keys of rows with the given column value in ascending or descending order,
+// stopping after maxKeys keys. Entries are compared in place in the leaves of the index
+std::vector<Key> indexLookup(std::shared_ptr<Table>& index, IndexColumn column,
+                             const std::string& value, bool descending, uint64_t maxKeys)
+{
+    std::vector<Key> primaryKeys;
+    uint64_t hash = indexHash(value.data(), value.size());
+
+    // Entries with the same hash are adjacent and sorted by primary id
+    std::unique_ptr<Cursor> cursor = descending ? tableSeekLast(index, { hash, UINT64_MAX }) 
+                                                : tableSeek(index, { hash, 0 });
+
+    while (!(cursor->endOfTable) && primaryKeys.size() < maxKeys)
+    {
+        Key key = leafGetKey(index->pager->readPage(cursor->pageNumber), cursor->cellCount);
+        if (key.prefix != hash)
+        {
+            break;
+        }
+
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source) &&
+            value == (column == INDEX_USERNAME ? serializedUsername(source) : serializedEmail(source)))
+        {
+            primaryKeys.push_back({ 0, key.id });
+        }
+
+        if (descending)
+            (*cursor)--;
+        else
+            (*cursor)++;
+    }
+
+    return primaryKeys;
+}
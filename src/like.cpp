@@ -0,0 +1,161 @@
+#include "../includes/like.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIKE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+LikePattern::LikePattern(std::string_view pattern) :
+    anchoredStart(!pattern.starts_with('%')), anchoredEnd(!pattern.ends_with('%'))
+{
+    size_t first = 0;
+    while (first <= pattern.size())
+    {
+        size_t last = pattern.find('%', first);
+        if (last == std::string_view::npos)
+        {
+            last = pattern.size();
+        }
+        if (last > first)
+        {
+            pieces.emplace_back(pattern.substr(first, last - first));
+        }
+        first = last + 1;
+    }
+}
+
+// Text that matches pieces in order, the first one at the start of the text
+// and the last one at its end unless the pattern has "%" there. Pieces have a 
+// fixed length, so the leftmost match of every piece is never worse than a later one
+bool LikePattern::matches(std::string_view text) const
+{
+    if (pieces.empty())
+    {
+        return !anchoredStart || text.empty();
+    }
+
+    size_t firstPiece = 0;
+    size_t lastPiece = pieces.size();
+    if (anchoredStart)
+    {
+        const std::string& piece = pieces.front();
+        if (text.size() < piece.size() || !likePieceMatches(text.data(), piece))
+        {
+            return false;
+        }
+        text.remove_prefix(piece.size());
+        firstPiece++;
+    }
+    if (anchoredEnd)
+    {
+        // A pattern without "%" is one piece that has to match the whole text
+        if (firstPiece == lastPiece)
+        {
+            return text.empty();
+        }
+        const std::string& piece = pieces.back();
+        if (text.size() < piece.size() || 
+            !likePieceMatches(text.data() + text.size() - piece.size(), piece))
+        {
+            return false;
+        }
+        text.remove_suffix(piece.size());
+        lastPiece--;
+    }
+
+    size_t position = 0;
+    for (size_t i = firstPiece; i < lastPiece; i++)
+    {
+        position = likeFind(text, pieces[i], position);
+        if (position == std::string_view::npos)
+        {
+            return false;
+        }
+        position += pieces[i].size();
+    }
+    return true;
+}
+
+// Compare a piece with the text at the same length, "_" matches any character
+bool likePieceMatches(const char* text, std::string_view piece)
+{
+    for (size_t i = 0; i < piece.size(); i++)
+    {
+        if (piece[i] != '_' && piece[i] != text[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Position of the first match of a piece at or after from, npos if there is none
+size_t likeFindScalar(std::string_view text, std::string_view piece, size_t from)
+{
+    for (size_t i = from; i + piece.size() <= text.size(); i++)
+    {
+        if (likePieceMatches(text.data() + i, piece))
+        {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#ifdef LIKE_SSE2
+static uint32_t lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return bit;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Same as likeFindScalar. The first and the last character of the piece that aren't "_"
+// are broadcast and compared with 16 positions at once, only positions where
+// both are equal are compared whole. Loads never go past the end of the text
+size_t likeFind(std::string_view text, std::string_view piece, size_t from)
+{
+#ifdef LIKE_SSE2
+    size_t firstChar = piece.find_first_not_of('_');
+    if (firstChar == std::string_view::npos || text.size() < piece.size())
+    {
+        return likeFindScalar(text, piece, from);
+    }
+    size_t lastChar = piece.find_last_not_of('_');
+
+    const __m128i first = _mm_set1_epi8(piece[firstChar]);
+    const __m128i last = _mm_set1_epi8(piece[lastChar]);
+    size_t positions = text.size() - piece.size() + 1;
+    size_t i = from;
+    for (; i + 16 <= positions; i += 16)
+    {
+        __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i + firstChar));
+        __m128i lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i + lastChar));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBlock, first), 
+                                                        _mm_cmpeq_epi8(lastBlock, last)));
+        while (mask != 0)
+        {
+            uint32_t bit = lowestBit(mask);
+            if (likePieceMatches(text.data() + i + bit, piece))
+            {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return likeFindScalar(text, piece, i);
+#else
+    return likeFindScalar(text, piece, from);
+#endif
+}
@@ -6,22 +6,164 @@ uint32_t* leafGetCellCount(void* node)
     return reinterpret_cast<uint32_t*>(charPtr + LEAF_NODE_NUM_CELLS_OFFSET);
 }
 
+// Offset of the lowest cell in the page. Free space lies between the slot
+// directory and this offset
+uint16_t* leafGetCellContentStart(void* node)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    return reinterpret_cast<uint16_t*>(charPtr + LEAF_NODE_CELL_CONTENT_START_OFFSET);
+}
+
+// Bytes inside the cell content area no longer used by any cell
+uint16_t* leafGetFragmentedBytes(void* node)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    return reinterpret_cast<uint16_t*>(charPtr + LEAF_NODE_FRAGMENTED_BYTES_OFFSET);
+}
+
+uint16_t* leafGetSlot(void* node, uint32_t cellNumber)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    return reinterpret_cast<uint16_t*>(charPtr + LEAF_NODE_HEADER_SIZE +
+                                       cellNumber * LEAF_NODE_SLOT_SIZE);
+}
+
 void* leafGetCell(void* node, uint32_t cellCount)
 {
     char* charPtr = reinterpret_cast<char*>(node);
-    return reinterpret_cast<void*>(charPtr + LEAF_NODE_HEADER_SIZE + 
-                                   cellCount * LEAF_NODE_CELL_SIZE);
+    return reinterpret_cast<void*>(charPtr + *leafGetSlot(node, cellCount));
+}
+
+// Length of the whole cell: length prefix and serialized row
+uint16_t* leafGetCellLength(void* node, uint32_t cellCount)
+{
+    char* charPtr = reinterpret_cast<char*>(leafGetCell(node, cellCount));
+    return reinterpret_cast<uint16_t*>(charPtr + LEAF_NODE_CELL_LENGTH_OFFSET);
 }
 
-uint32_t* leafGetKey(void* node, uint32_t cellCount)
+Key leafGetKey(void* node, uint32_t cellCount)
 {
-    return reinterpret_cast<uint32_t*>(leafGetCell(node, cellCount));
+    char* charPtr = reinterpret_cast<char*>(leafGetCell(node, cellCount));
+    return readKey(nodeGetKeyType(node), charPtr + LEAF_NODE_KEY_OFFSET);
 }
 
 void* leafGetValue(void* node, uint32_t cellCount)
 {
     char* charPtr = reinterpret_cast<char*>(leafGetCell(node, cellCount));
-    return reinterpret_cast<void*>(charPtr + LEAF_NODE_KEY_SIZE);
+    return reinterpret_cast<void*>(charPtr + LEAF_NODE_VALUE_OFFSET);
+}
+
+// Free bytes between the slot directory and the cell content area
+uint32_t leafGetContiguousFreeSpace(void* node)
+{
+    uint32_t slotsEnd = LEAF_NODE_HEADER_SIZE + *leafGetCellCount(node) * LEAF_NODE_SLOT_SIZE;
+    return *leafGetCellContentStart(node) - slotsEnd;
+}
+
+// Free bytes available after defragmentation
+uint32_t leafGetFreeSpace(void* node)
+{
+    return leafGetContiguousFreeSpace(node) + *leafGetFragmentedBytes(node);
+}
+
+// Move all cells to the end of the page, so that fragmented space becomes contiguous.
+// The cell with number skipCell is dropped and its slot is left dangling
+static void leafDefragment(void* node, uint32_t skipCell)
+{
+    char copy[PAGE_SIZE];
+    memcpy(copy, node, PAGE_SIZE);
+
+    char* charPtr = reinterpret_cast<char*>(node);
+    uint32_t cellCount = *leafGetCellCount(node);
+    uint32_t contentStart = PAGE_SIZE;
+    for (uint32_t i = 0; i < cellCount; i++)
+    {
+        if (i == skipCell)
+            continue;
+
+        uint16_t* slot = leafGetSlot(node, i);
+        uint16_t cellLength = *reinterpret_cast<uint16_t*>(copy + *slot + 
+                                                           LEAF_NODE_CELL_LENGTH_OFFSET);
+        contentStart -= cellLength;
+        memcpy(charPtr + contentStart, copy + *slot, cellLength);
+        *slot = static_cast<uint16_t>(contentStart);
+    }
+
+    *leafGetCellContentStart(node) = static_cast<uint16_t>(contentStart);
+    *leafGetFragmentedBytes(node) = 0;
+}
+
+void leafDefragment(void* node)
+{
+    leafDefragment(node, UINT32_MAX);
+}
+
+// Take cellLength bytes from the free space. Caller makes sure the space is available
+static void* leafTakeSpace(void* node, uint32_t cellLength, uint32_t skipCell)
+{
+    if (leafGetContiguousFreeSpace(node) < cellLength)
+    {
+        leafDefragment(node, skipCell);
+    }
+
+    *leafGetCellContentStart(node) -= cellLength;
+    return reinterpret_cast<char*>(node) + *leafGetCellContentStart(node);
+}
+
+// Insert a new slot at cellNumber, shifting the slots after it, and allocate
+// cellLength bytes for the cell. Caller makes sure the node has enough free space
+void* leafAllocateCell(void* node, uint32_t cellNumber, uint32_t cellLength)
+{
+    if (leafGetFreeSpace(node) < cellLength + LEAF_NODE_SLOT_SIZE)
+    {
+        throw std::runtime_error("Not enough space in leaf node for a cell of size " + 
+                                 std::to_string(cellLength) + ".");
+    }
+
+    // Reserve the slot first, so defragmentation does not overwrite it
+    if (leafGetContiguousFreeSpace(node) < cellLength + LEAF_NODE_SLOT_SIZE)
+    {
+        leafDefragment(node);
+    }
+
+    uint32_t cellCount = *leafGetCellCount(node);
+    memmove(leafGetSlot(node, cellNumber + 1), leafGetSlot(node, cellNumber),
+            (cellCount - cellNumber) * LEAF_NODE_SLOT_SIZE);
+    *leafGetCellCount(node) += 1;
+
+    void* cell = leafTakeSpace(node, cellLength, UINT32_MAX);
+    *leafGetSlot(node, cellNumber) = static_cast<uint16_t>(
+        reinterpret_cast<char*>(cell) - reinterpret_cast<char*>(node));
+    *reinterpret_cast<uint16_t*>(reinterpret_cast<char*>(cell) + 
+                                 LEAF_NODE_CELL_LENGTH_OFFSET) = cellLength;
+    return cell;
+}
+
+// Resize an existing cell. The row has to be rewritten by the caller.
+// Return nullptr if the node doesn't have enough space
+void* leafReallocateCell(void* node, uint32_t cellNumber, uint32_t cellLength)
+{
+    uint16_t oldLength = *leafGetCellLength(node, cellNumber);
+    if (cellLength <= oldLength)
+    {
+        // Shrink in place, the tail becomes fragmented
+        *leafGetCellLength(node, cellNumber) = cellLength;
+        *leafGetFragmentedBytes(node) += oldLength - cellLength;
+        return leafGetCell(node, cellNumber);
+    }
+
+    if (leafGetFreeSpace(node) + oldLength < cellLength)
+    {
+        return nullptr;
+    }
+
+    *leafGetFragmentedBytes(node) += oldLength;
+
+    void* cell = leafTakeSpace(node, cellLength, cellNumber);
+    *leafGetSlot(node, cellNumber) = static_cast<uint16_t>(
+        reinterpret_cast<char*>(cell) - reinterpret_cast<char*>(node));
+    *leafGetCellLength(node, cellNumber) = cellLength;
+    return cell;
 }
 
 uint32_t* leafGetNextLeaf(void* node) 
@@ -30,12 +172,22 @@ uint32_t* leafGetNextLeaf(void* node)
     return reinterpret_cast<uint32_t*>(charPtr + LEAF_NODE_NEXT_LEAF_OFFSET);
 }
 
-void leafInitialize(void* node)
+uint32_t* leafGetPrevLeaf(void* node) 
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    return reinterpret_cast<uint32_t*>(charPtr + LEAF_NODE_PREV_LEAF_OFFSET);
+}
+
+void leafInitialize(void* node, KeyType keyType)
 {
     nodeSetType(node, NODE_LEAF);
+    nodeSetKeyType(node, keyType);
     setRootNode(node, false);
     *leafGetCellCount(node) = 0;
     *leafGetNextLeaf(node) = 0;  // 0 is no sibling
+    *leafGetPrevLeaf(node) = 0;
+    *leafGetCellContentStart(node) = PAGE_SIZE;
+    *leafGetFragmentedBytes(node) = 0;
 }
 
 NodeType nodeGetType(void* node)
@@ -52,6 +204,86 @@ void nodeSetType(void* node, NodeType type)
     *reinterpret_cast<uint8_t*>(charPtr + NODE_TYPE_OFFSET) = value;
 }
 
+KeyType nodeGetKeyType(void* node)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    uint8_t value = *reinterpret_cast<uint8_t*>(charPtr + KEY_TYPE_OFFSET);
+    return static_cast<KeyType>(value);
+}
+
+void nodeSetKeyType(void* node, KeyType keyType)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    *reinterpret_cast<uint8_t*>(charPtr + KEY_TYPE_OFFSET) = static_cast<uint8_t>(keyType);
+}
+
+uint32_t keySize(KeyType keyType)
+{
+    return keyType == KEY_COMPOSITE ? KeyTraits<KEY_COMPOSITE>::SIZE : KeyTraits<KEY_INTEGER>::SIZE;
+}
+
+Key readKey(KeyType keyType, const void* source)
+{
+    switch (keyType)
+    {
+        case KEY_COMPOSITE:
+            return KeyTraits<KEY_COMPOSITE>::read(source);
+        default:
+            return KeyTraits<KEY_INTEGER>::read(source);
+    }
+}
+
+// Largest key of the key type, integer keys have no prefix
+Key maxKey(KeyType keyType)
+{
+    return keyType == KEY_COMPOSITE ? MAX_KEY : Key{ 0, UINT64_MAX };
+}
+
+// Move to the smallest key greater than the given one. Return false if there is none
+bool nextKey(KeyType keyType, Key& key)
+{
+    if (key.id < UINT64_MAX)
+    {
+        key.id++;
+        return true;
+    }
+    if (keyType == KEY_COMPOSITE && key.prefix < UINT64_MAX)
+    {
+        key = { key.prefix + 1, 0 };
+        return true;
+    }
+    return false;
+}
+
+// Move to the largest key less than the given one. Return false if there is none
+bool previousKey(KeyType keyType, Key& key)
+{
+    if (key.id > 0)
+    {
+        key.id--;
+        return true;
+    }
+    if (keyType == KEY_COMPOSITE && key.prefix > 0)
+    {
+        key = { key.prefix - 1, UINT64_MAX };
+        return true;
+    }
+    return false;
+}
+
+void writeKey(KeyType keyType, void* destination, const Key& key)
+{
+    switch (keyType)
+    {
+        case KEY_COMPOSITE:
+            KeyTraits<KEY_COMPOSITE>::write(destination, key);
+            break;
+        default:
+            KeyTraits<KEY_INTEGER>::write(destination, key);
+            break;
+    }
+}
+
 uint32_t* internalGetKeyCount(void* node)
 {
     char* charPtr = reinterpret_cast<char*>(node);
@@ -64,11 +296,23 @@ uint32_t* internalGetRightChild(void* node)
     return reinterpret_cast<uint32_t*>(charPtr + INTERNAL_NODE_RIGHT_CHILD_OFFSET);
 }
 
+uint64_t* internalGetRightCount(void* node)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    return reinterpret_cast<uint64_t*>(charPtr + INTERNAL_NODE_RIGHT_COUNT_OFFSET);
+}
+
+// Size of a child page number, a row count and a key
+uint32_t internalGetCellSize(void* node)
+{
+    return INTERNAL_NODE_KEY_OFFSET + keySize(nodeGetKeyType(node));
+}
+
 uint32_t* internalGetCell(void* node, uint32_t cellCount)
 {
     char* charPtr = reinterpret_cast<char*>(node);
     return reinterpret_cast<uint32_t*>(charPtr + INTERNAL_NODE_HEADER_SIZE +
-                                       cellCount * INTERNAL_NODE_CELL_SIZE);
+                                       cellCount * internalGetCellSize(node));
 }
 
 // Get internal node child by its number
@@ -101,11 +345,48 @@ uint32_t* internalGetChild(void* node, uint32_t child_num)
     }
 }
 
+// Get the number of live rows in the subtree of a child, same numbering as internalGetChild
+uint64_t* internalGetChildCount(void* node, uint32_t child_num)
+{
+    if (child_num == *internalGetKeyCount(node))
+    {
+        return internalGetRightCount(node);
+    }
+
+    char* charPtr = reinterpret_cast<char*>(internalGetCell(node, child_num));
+    return reinterpret_cast<uint64_t*>(charPtr + INTERNAL_NODE_COUNT_OFFSET);
+}
+
+// Get the position of a child page in its parent
+uint32_t internalGetChildIndex(void* node, uint32_t childPageNumber)
+{
+    uint32_t keyCount = *internalGetKeyCount(node);
+    for (uint32_t i = 0; i < keyCount; i++)
+    {
+        if (*internalGetCell(node, i) == childPageNumber)
+        {
+            return i;
+        }
+    }
+    if (*internalGetRightChild(node) == childPageNumber)
+    {
+        return keyCount;
+    }
+
+    throw std::runtime_error("Page " + std::to_string(childPageNumber) + " is not a child of its parent.");
+}
+
 // Get one of internal node keys by number
-uint32_t* internalGetKey(void* node, uint32_t key_num)
+Key internalGetKey(void* node, uint32_t key_num)
 {
     char* charPtr = reinterpret_cast<char*>(internalGetCell(node, key_num));
-    return reinterpret_cast<uint32_t*>(charPtr + INTERNAL_NODE_CHILD_SIZE);
+    return readKey(nodeGetKeyType(node), charPtr + INTERNAL_NODE_KEY_OFFSET);
+}
+
+void internalSetKey(void* node, uint32_t key_num, const Key& key)
+{
+    char* charPtr = reinterpret_cast<char*>(internalGetCell(node, key_num));
+    writeKey(nodeGetKeyType(node), charPtr + INTERNAL_NODE_KEY_OFFSET, key);
 }
 
 bool isRootNode(void* node) 
@@ -120,14 +401,16 @@ void setRootNode(void* node, bool is_root)
     *reinterpret_cast<uint8_t*>(reinterpret_cast<char*>(node) + IS_ROOT_OFFSET) = value;
 }
 
-void internalInitialize(void* node) 
+void internalInitialize(void* node, KeyType keyType) 
 {
     nodeSetType(node, NODE_INTERNAL);
+    nodeSetKeyType(node, keyType);
     setRootNode(node, false);
     *internalGetKeyCount(node) = 0;
     
     // Making sure right child number does not initialize with 0
     *internalGetRightChild(node) = INVALID_PAGE_NUM;
+    *internalGetRightCount(node) = 0;
 }
 
 uint32_t* getParent(void* node)
@@ -136,8 +419,106 @@ uint32_t* getParent(void* node)
     return reinterpret_cast<uint32_t*>(charPtr + PARENT_POINTER_OFFSET);
 }
 
-void internalUpdateKey(void* node, uint32_t old_key, uint32_t new_key) 
+void internalUpdateKey(void* node, const Key& old_key, const Key& new_key) 
 {
     uint32_t oldChildIndex = internalFindChild(node, old_key);
-    *internalGetKey(node, oldChildIndex) = new_key;
+    internalSetKey(node, oldChildIndex, new_key);
+}
+
+// Binary searches are instantiated for every key type, so the integer key path
+// compares raw 64-bit integers without branching on the key type
+
+// Return the index of the first cell with a key not less than the given key
+template <KeyType type>
+static uint32_t leafFindCell(void* node, const Key& key)
+{
+    char* charPtr = reinterpret_cast<char*>(node);
+    uint16_t* slots = leafGetSlot(node, 0);
+
+    uint32_t minIndex = 0;
+    uint32_t onePastMaxIndex = *leafGetCellCount(node);
+    while (onePastMaxIndex != minIndex)
+    {
+        uint32_t index = (minIndex + onePastMaxIndex) / 2;
+        Key keyAtIndex = KeyTraits<type>::read(charPtr + slots[index] + LEAF_NODE_KEY_OFFSET);
+        if (KeyTraits<type>::less(keyAtIndex, key))
+        {
+            minIndex = index + 1;
+        }
+        else
+        {
+            onePastMaxIndex = index;
+        }
+    }
+
+    return minIndex;
+}
+
+uint32_t leafFindCell(void* node, const Key& key)
+{
+    switch (nodeGetKeyType(node))
+    {
+        case KEY_COMPOSITE:
+            return leafFindCell<KEY_COMPOSITE>(node, key);
+        default:
+            return leafFindCell<KEY_INTEGER>(node, key);
+    }
+}
+
+// Return the index of the child which should contain the given key
+template <KeyType type>
+static uint32_t internalFindChild(void* node, const Key& key)
+{
+    char* cells = reinterpret_cast<char*>(node) + INTERNAL_NODE_HEADER_SIZE;
+    const uint32_t cellSize = INTERNAL_NODE_KEY_OFFSET + KeyTraits<type>::SIZE;
+    uint32_t numKeys = *internalGetKeyCount(node);
+
+    //Binary search
+    uint32_t minIndex = 0;
+    uint32_t maxIndex = numKeys; // there is one more child than key
+
+    while (minIndex != maxIndex) 
+    {
+        uint32_t index = (minIndex + maxIndex) / 2;
+        Key keyToRight = KeyTraits<type>::read(cells + index * cellSize + INTERNAL_NODE_KEY_OFFSET);
+
+        if (!KeyTraits<type>::less(keyToRight, key)) 
+        {
+            maxIndex = index;
+        } 
+        else
+        {
+            minIndex = index + 1;
+        }
+    }
+
+    return minIndex;
+}
+
+uint32_t internalFindChild(void* node, const Key& key)
+{
+    switch (nodeGetKeyType(node))
+    {
+        case KEY_COMPOSITE:
+            return internalFindChild<KEY_COMPOSITE>(node, key);
+        default:
+            return internalFindChild<KEY_INTEGER>(node, key);
+    }
+}
+
+uint32_t* overflowGetNextPage(void* page)
+{
+    char* charPtr = reinterpret_cast<char*>(page);
+    return reinterpret_cast<uint32_t*>(charPtr + OVERFLOW_NEXT_PAGE_OFFSET);
+}
+
+uint32_t* overflowGetDataLength(void* page)
+{
+    char* charPtr = reinterpret_cast<char*>(page);
+    return reinterpret_cast<uint32_t*>(charPtr + OVERFLOW_DATA_LENGTH_OFFSET);
+}
+
+char* overflowGetData(void* page)
+{
+    return reinterpret_cast<char*>(page) + OVERFLOW_HEADER_SIZE;
 }
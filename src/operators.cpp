@@ -0,0 +1,183 @@
+#include "../includes/operators.h"
+
+ScanOperator::ScanOperator(std::unique_ptr<Cursor> cursor, bool descending) :
+    pager(cursor->table->pager), cursor(std::move(cursor)), descending(descending), 
+    bounded(false), end(MAX_KEY), endInclusive(true) { }
+
+// Stop at the first key past the end, or before it when scanning backwards
+void ScanOperator::setEnd(const Key& end, bool inclusive)
+{
+    bounded = true;
+    this->end = end;
+    endInclusive = inclusive;
+}
+
+// Cells are read a leaf at a time, the page is looked up once per leaf instead of once per row.
+// Rows of the previous batch are not used anymore, so leaves the scan made the cache evict can be freed
+bool ScanOperator::next(RowBatch& batch)
+{
+    Snapshot::releasePages();
+    uint32_t capacity = std::min(batch.capacity, SELECT_BATCH_ROWS);
+    batch.rowCount = 0;
+    while (batch.rowCount < capacity && !(cursor->endOfTable))
+    {
+        void* node = pager->readPage(cursor->pageNumber);
+        uint32_t cellCount = *leafGetCellCount(node);
+        while (batch.rowCount < capacity)
+        {
+            uint32_t cell = cursor->cellCount;
+            if (bounded)
+            {
+                Key key = leafGetKey(node, cell);
+                bool past = descending ? (endInclusive ? key < end : !(end < key))
+                                       : (endInclusive ? end < key : !(key < end));
+                if (past)
+                {
+                    cursor->endOfTable = true;
+                    break;
+                }
+            }
+
+            void* source = leafGetValue(node, cell);
+            batch.rows[batch.rowCount] = source;
+            batch.rowCount += !isRowDeleted(source);
+
+            // Moving past the first or the last cell goes on to the next leaf
+            if (descending ? cell == 0 : cell + 1 >= cellCount)
+            {
+                if (descending)
+                    (*cursor)--;
+                else
+                    (*cursor)++;
+                break;
+            }
+            cursor->cellCount = descending ? cell - 1 : cell + 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < batch.rowCount; i++)
+    {
+        batch.selection[i] = static_cast<uint16_t>(i);
+    }
+    batch.selectedCount = batch.rowCount;
+    return batch.rowCount > 0;
+}
+
+FilterOperator::FilterOperator(SelectOperator& input, IndexColumn column, const std::string& value, 
+                               bool like) :
+    input(input), column(column), value(value), like(like), pattern(like ? value : "") { }
+
+// The column of the selected rows is gathered first, then compared in a separate loop.
+// Lengths are compared before the bytes, and most rows differ in length from an equal value
+bool FilterOperator::next(RowBatch& batch)
+{
+    uint32_t consumerCapacity = batch.capacity;
+    while (true)
+    {
+        // How many rows pass is not known ahead, so the input always fills whole batches
+        batch.capacity = SELECT_BATCH_ROWS;
+        if (!input.next(batch))
+        {
+            batch.capacity = consumerCapacity;
+            return false;
+        }
+
+        std::string_view (*field)(void*) = column == INDEX_USERNAME ? serializedUsername : serializedEmail;
+        for (uint32_t i = 0; i < batch.selectedCount; i++)
+        {
+            std::string_view text = field(batch.rows[batch.selection[i]]);
+            fieldData[i] = text.data();
+            fieldLengths[i] = static_cast<uint8_t>(text.size());
+        }
+
+        uint32_t kept = 0;
+        if (like)
+        {
+            for (uint32_t i = 0; i < batch.selectedCount; i++)
+            {
+                batch.selection[kept] = batch.selection[i];
+                kept += pattern.matches(std::string_view(fieldData[i], fieldLengths[i]));
+            }
+        }
+        else
+        {
+            uint8_t length = static_cast<uint8_t>(value.size());
+            for (uint32_t i = 0; i < batch.selectedCount; i++)
+            {
+                batch.selection[kept] = batch.selection[i];
+                kept += fieldLengths[i] == length && memcmp(fieldData[i], value.data(), length) == 0;
+            }
+        }
+        batch.selectedCount = kept;
+
+        if (kept > 0)
+        {
+            batch.capacity = consumerCapacity;
+            return true;
+        }
+    }
+}
+
+LimitOperator::LimitOperator(SelectOperator& input, uint64_t offset, uint64_t limit) :
+    input(input), skipLeft(offset), rowsLeft(limit) { }
+
+// Once the limit is reached the input is not read anymore, so a scan stops early
+bool LimitOperator::next(RowBatch& batch)
+{
+    while (rowsLeft > 0)
+    {
+        uint64_t wanted = skipLeft < SELECT_BATCH_ROWS ? skipLeft + rowsLeft : SELECT_BATCH_ROWS;
+        batch.capacity = static_cast<uint32_t>(std::min<uint64_t>(SELECT_BATCH_ROWS, wanted));
+        if (!input.next(batch))
+        {
+            return false;
+        }
+
+        uint32_t skipped = static_cast<uint32_t>(std::min<uint64_t>(skipLeft, batch.selectedCount));
+        skipLeft -= skipped;
+        uint32_t taken = static_cast<uint32_t>(std::min<uint64_t>(rowsLeft, batch.selectedCount - skipped));
+        if (taken == 0)
+        {
+            continue;
+        }
+
+        memmove(batch.selection, batch.selection + skipped, taken * sizeof(batch.selection[0]));
+        batch.selectedCount = taken;
+        rowsLeft -= taken;
+        return true;
+    }
+    return false;
+}
+
+uint64_t countRows(SelectOperator& input)
+{
+    RowBatch batch;
+    batch.capacity = SELECT_BATCH_ROWS;
+    uint64_t count = 0;
+    while (input.next(batch))
+    {
+        count += batch.selectedCount;
+    }
+    return count;
+}
+
+void printRows(SelectOperator& input, std::ostream& out, const std::shared_ptr<Pager>& pager,
+               const std::vector<RowColumn>& columns, OutputFormat format)
+{
+    RowBatch batch;
+    batch.capacity = SELECT_BATCH_ROWS;
+    while (input.next(batch))
+    {
+        for (uint32_t i = 0; i < batch.selectedCount; i++)
+        {
+            if (format == OUTPUT_BINARY)
+            {
+                writeSerializedRow(out, pager, batch.rows[batch.selection[i]], columns);
+            }
+            else
+            {
+                printSerializedRow(out, pager, batch.rows[batch.selection[i]], columns);
+            }
+        }
+    }
+}
@@ -1,57 +1,326 @@
 #include "../includes/pager.h"
 
-void* Pager::getPages()
-{
-    return pages;
-}
+#include <algorithm>
+#include <cstring>
+#include <deque>
 
-uint32_t Pager::getFileLength()
+uint64_t Pager::getFileLength()
 {
     return fileLength;
 }
 
-Pager::Pager(HANDLE fileHandle, uint32_t fileLength, uint32_t pageCount) : 
-    fileHandle(fileHandle), fileLength(fileLength), pageCount(pageCount) { }
+Pager::Pager(const std::string& filename, HANDLE fileHandle, uint64_t fileLength, uint32_t pageCount) : 
+    filename(filename), fileHandle(fileHandle), fileLength(fileLength), pageCount(pageCount),
+    frameGroups(new std::atomic<Frame*>[PAGER_FRAME_GROUP_COUNT]), cachedPageCount(0),
+    cacheLimit(UINT32_MAX), evictAt(UINT32_MAX), missCount(0), writePageCount(pageCount), 
+    hotJournal(false)
+{ 
+    for (uint32_t i = 0; i < PAGER_FRAME_GROUP_COUNT; i++)
+    {
+        frameGroups[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
 
-void* Pager::getPage(uint32_t pageNumber)
+// Cached pages are freed by the table, only the frames are left
+Pager::~Pager()
+{
+    for (uint32_t i = 0; i < PAGER_FRAME_GROUP_COUNT; i++)
+    {
+        delete[] frameGroups[i].load(std::memory_order_relaxed);
+    }
+}
+
+Frame& Pager::getFrame(uint32_t pageNumber)
 {
-    if (pageNumber > TABLE_MAX_PAGES)
+    if (pageNumber >= TABLE_MAX_PAGES)
     {
         throw std::runtime_error("Ran out of pages. Increase TABLE_MAX_PAGES if you need more. "
-            + std::to_string(pageNumber) + " > " + std::to_string(TABLE_MAX_PAGES) + ".");
+            + std::to_string(pageNumber) + " >= " + std::to_string(TABLE_MAX_PAGES) + ".");
+    }
+
+    std::atomic<Frame*>& group = frameGroups[pageNumber / PAGER_FRAME_GROUP_SIZE];
+    Frame* frames = group.load(std::memory_order_acquire);
+    if (frames == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        frames = group.load(std::memory_order_relaxed);
+        if (frames == nullptr)
+        {
+            frames = new Frame[PAGER_FRAME_GROUP_SIZE];
+            group.store(frames, std::memory_order_release);
+        }
+    }
+    return frames[pageNumber % PAGER_FRAME_GROUP_SIZE];
+}
+
+// Move the file pointer to the start of a page. Offsets are 64-bit, 
+// a file of TABLE_MAX_PAGES pages is larger than 4 GB
+static void seekPage(HANDLE fileHandle, uint32_t pageNumber)
+{
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<int64_t>(pageNumber) * PAGE_SIZE;
+    if (!SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN))
+    {
+        throw std::runtime_error("Error seeking in file. Error code: " + std::to_string(GetLastError()));
+    }
+}
+
+static uint64_t getFileSize(HANDLE fileHandle)
+{
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size))
+    {
+        throw std::runtime_error("Error reading file size. Error code: " + std::to_string(GetLastError()));
+    }
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+static void readBytes(HANDLE fileHandle, void* buffer, DWORD size)
+{
+    DWORD bytesRead;
+    if (!ReadFile(fileHandle, buffer, size, &bytesRead, nullptr) || bytesRead != size)
+    {
+        throw std::runtime_error("Error reading file: " + std::to_string(GetLastError()));
+    }
+}
+
+static void writeBytes(HANDLE fileHandle, const void* buffer, DWORD size)
+{
+    DWORD bytesWritten;
+    if (!WriteFile(fileHandle, buffer, size, &bytesWritten, nullptr) || bytesWritten != size)
+    {
+        throw std::runtime_error("Error while writing. Error code: " + std::to_string(GetLastError()));
     }
+}
 
-    if (this->pages[pageNumber] == NULL)
+static void flushFile(HANDLE fileHandle)
+{
+    if (!FlushFileBuffers(fileHandle))
     {
-        // Cache miss. Allocate memory and load from file
-        void* page = new char[PAGE_SIZE];
-        this->pageCount = this->fileLength / PAGE_SIZE;
+        throw std::runtime_error("Error while flushing. Error code: " + std::to_string(GetLastError()));
+    }
+}
+
+// Put back the pages that a checkpoint which didn't finish overwrote, and cut the file
+// to its length before it. A journal without a valid header was written before the file 
+// was touched, it's only deleted
+static void rollbackJournal(const std::string& filename, HANDLE fileHandle)
+{
+    std::string journalName = filename + JOURNAL_SUFFIX;
+    HANDLE journal = CreateFileA(journalName.c_str(), GENERIC_READ | GENERIC_WRITE,
+                     0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (journal == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Unable to open journal. Error code: " + std::to_string(GetLastError()));
+    }
+
+    try
+    {
+        char header[JOURNAL_HEADER_SIZE];
+        DWORD bytesRead;
+        if (ReadFile(journal, header, JOURNAL_HEADER_SIZE, &bytesRead, nullptr) && 
+            bytesRead == JOURNAL_HEADER_SIZE &&
+            memcmp(header + JOURNAL_MAGIC_OFFSET, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0)
+        {
+            uint64_t fileLength;
+            uint32_t pageCount;
+            memcpy(&fileLength, header + JOURNAL_FILE_LENGTH_OFFSET, JOURNAL_FILE_LENGTH_SIZE);
+            memcpy(&pageCount, header + JOURNAL_PAGE_COUNT_OFFSET, JOURNAL_PAGE_COUNT_SIZE);
+
+            std::unique_ptr<char[]> entry(new char[JOURNAL_ENTRY_SIZE]);
+            for (uint32_t i = 0; i < pageCount; i++)
+            {
+                readBytes(journal, entry.get(), JOURNAL_ENTRY_SIZE);
+                uint32_t pageNumber;
+                memcpy(&pageNumber, entry.get(), JOURNAL_PAGE_NUMBER_SIZE);
+                seekPage(fileHandle, pageNumber);
+                writeBytes(fileHandle, entry.get() + JOURNAL_PAGE_NUMBER_SIZE, PAGE_SIZE);
+            }
+
+            LARGE_INTEGER length;
+            length.QuadPart = static_cast<int64_t>(fileLength);
+            if (!SetFilePointerEx(fileHandle, length, nullptr, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+            {
+                throw std::runtime_error("Error truncating file. Error code: " + std::to_string(GetLastError()));
+            }
+            flushFile(fileHandle);
+        }
+    }
+    catch (...)
+    {
+        CloseHandle(journal);
+        throw;
+    }
+
+    CloseHandle(journal);
+    if (!DeleteFileA(journalName.c_str()))
+    {
+        throw std::runtime_error("Unable to delete journal. Error code: " + std::to_string(GetLastError()));
+    }
+}
+
+// Newest committed version of a page, read from the file on a cache miss
+PageVersion* Pager::loadPage(Frame& frame, uint32_t pageNumber)
+{
+    PageVersion* version = frame.newest.load(std::memory_order_acquire);
+    if (version != nullptr)
+    {
+        return version;
+    }
+
+    // Cache miss. Only one thread loads the page, the others wait for it
+    std::lock_guard<std::mutex> lock(loadMutex);
+    version = frame.newest.load(std::memory_order_relaxed);
+    if (version == nullptr)
+    {
+        // Allocate memory and load from file
+        std::unique_ptr<PageVersion> loaded(new PageVersion());
+        loaded->commitVersion = 0;
+        loaded->older.store(nullptr, std::memory_order_relaxed);
+        uint64_t filePageCount = this->fileLength / PAGE_SIZE;
 
         // We might save a partial page at the end of the file
         if (this->fileLength % PAGE_SIZE)
         {
-            this->pageCount++;
+            filePageCount++;
         }
 
-        if (pageNumber <= this->pageCount)
+        if (pageNumber < filePageCount)
         {
             DWORD bytesRead;
-            DWORD seekPosition = pageNumber * PAGE_SIZE;
-
-            SetFilePointer(this->fileHandle, seekPosition, nullptr, FILE_BEGIN);
-            if (!ReadFile(this->fileHandle, page, PAGE_SIZE, &bytesRead, nullptr))
+            seekPage(this->fileHandle, pageNumber);
+            if (!ReadFile(this->fileHandle, loaded->data, PAGE_SIZE, &bytesRead, nullptr))
             {
                 throw std::runtime_error("Error reading file: " + std::to_string(GetLastError()));
             }
         }
-        this->pages[pageNumber] = page;
+        version = loaded.release();
+        frame.newest.store(version, std::memory_order_release);
+        cachedPageCount.fetch_add(1, std::memory_order_relaxed);
+        missCount.store(missCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
         
+        // Page count only grows, pages allocated after the file was opened
+        // are not in the file yet
         if (pageNumber >= this->pageCount)
         {
             this->pageCount = pageNumber + 1;
         }
     }
-    return this->pages[pageNumber];
+    return version;
+}
+
+// A full cache makes room before the page is read, so the page returned isn't evicted
+Frame& Pager::useFrame(uint32_t pageNumber)
+{
+    if (cachedPageCount.load(std::memory_order_relaxed) >= evictAt.load(std::memory_order_relaxed))
+    {
+        evictPages();
+    }
+
+    Frame& frame = getFrame(pageNumber);
+    uint64_t now = missCount.load(std::memory_order_relaxed);
+    if (frame.lastUse.load(std::memory_order_relaxed) != now)
+    {
+        frame.lastUse.store(now, std::memory_order_relaxed);
+    }
+    return frame;
+}
+
+// Page that the caller changes. The writer gets its own copy of the page, made on 
+// first access. Other threads get the newest version committed before their snapshot
+void* Pager::getPage(uint32_t pageNumber)
+{
+    Frame& frame = useFrame(pageNumber);
+    if (writer.load(std::memory_order_relaxed) == std::this_thread::get_id())
+    {
+        if (frame.pending == nullptr)
+        {
+            frame.pending = new PageVersion;
+            memcpy(frame.pending->data, loadPage(frame, pageNumber)->data, PAGE_SIZE);
+            pendingPages.push_back(pageNumber);
+        }
+        return frame.pending->data;
+    }
+
+    PageVersion* version = loadPage(frame, pageNumber);
+    uint64_t snapshotVersion = Snapshot::getVersion();
+    while (version->commitVersion > snapshotVersion)
+    {
+        version = version->older.load(std::memory_order_acquire);
+    }
+    return version->data;
+}
+
+// Page that the caller only reads. The writer reads its copy if it made one, otherwise
+// the newest committed version, which no other thread changes while it holds the writer mutex.
+// The page must be looked up again with getPage before it's changed
+void* Pager::readPage(uint32_t pageNumber)
+{
+    if (writer.load(std::memory_order_relaxed) != std::this_thread::get_id())
+    {
+        return getPage(pageNumber);
+    }
+
+    Frame& frame = useFrame(pageNumber);
+    if (frame.pending != nullptr)
+    {
+        return frame.pending->data;
+    }
+    return loadPage(frame, pageNumber)->data;
+}
+
+bool Pager::isCached(uint32_t pageNumber)
+{
+    Frame* frames = frameGroups[pageNumber / PAGER_FRAME_GROUP_SIZE].load(std::memory_order_acquire);
+    return frames != nullptr && 
+           frames[pageNumber % PAGER_FRAME_GROUP_SIZE].newest.load(std::memory_order_acquire) != nullptr;
+}
+
+// Number of pages read into the cache, not counting older versions and copies of the writer
+uint32_t Pager::getCachedPageCount()
+{
+    return cachedPageCount.load(std::memory_order_relaxed);
+}
+
+// Committed pages that are not written to the file yet. Waits for the writer of another thread
+uint32_t Pager::getDirtyPageCount()
+{
+    if (writer.load(std::memory_order_relaxed) == std::this_thread::get_id())
+    {
+        return static_cast<uint32_t>(dirtyPages.size());
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return static_cast<uint32_t>(dirtyPages.size());
+}
+
+// Pages the writer of the calling thread copied, 0 if it isn't the writer
+uint32_t Pager::getPendingPageCount()
+{
+    if (writer.load(std::memory_order_relaxed) != std::this_thread::get_id())
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(pendingPages.size());
+}
+
+// Most pages kept in the cache, pages that can't be evicted may go over it for a while
+void Pager::setCacheLimit(uint32_t maxPages)
+{
+    cacheLimit = std::max<uint32_t>(maxPages, 1);
+    evictAt.store(cacheLimit);
+}
+
+// Drop a page from the cache without writing it. Older versions
+// belong to the list of retired versions and are freed from there
+void Pager::freePage(uint32_t pageNumber)
+{
+    PageVersion* version = getFrame(pageNumber).newest.exchange(nullptr);
+    if (version != nullptr)
+    {
+        delete version;
+        cachedPageCount.fetch_sub(1, std::memory_order_relaxed);
+    }
 }
 
 HANDLE& Pager::getFileHandle()
@@ -64,9 +333,10 @@ uint32_t& Pager::getPageCount()
     return pageCount;
 }
 
-// Open pager from an existing .db file
-std::unique_ptr<Pager> openPager(std::string filename)
+// Open pager from an existing .db file. A checkpoint that didn't finish is rolled back
+std::shared_ptr<Pager> openPager(std::string filename)
 {
+    bool hotJournal = GetFileAttributesA((filename + JOURNAL_SUFFIX).c_str()) != INVALID_FILE_ATTRIBUTES;
     HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE,
                         0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 
@@ -80,26 +350,26 @@ std::unique_ptr<Pager> openPager(std::string filename)
         throw std::runtime_error("Unable to open file.");
     }
 
-    DWORD fileLength = GetFileSize(fileHandle, NULL);
+    if (hotJournal)
+    {
+        rollbackJournal(filename, fileHandle);
+    }
+
+    uint64_t fileLength = getFileSize(fileHandle);
 
-    std::unique_ptr<Pager> pager = std::make_unique<Pager>(fileHandle, fileLength, 
-                                                           fileLength / PAGE_SIZE);
+    std::shared_ptr<Pager> pager = std::make_shared<Pager>(filename, fileHandle, fileLength, 
+                                                           static_cast<uint32_t>(fileLength / PAGE_SIZE));
 
     if (fileLength % PAGE_SIZE != 0)
     {
         throw std::runtime_error("Db file is not a whole number of pages. Corrupt file.");
     }
 
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++) 
-    {
-        pager->pages[i] = NULL;
-    }
-
     return pager;
 }
 
 // Create a pager in a new .db file, throw an exception if it already exists
-std::unique_ptr<Pager> createPager(std::string filename)
+std::shared_ptr<Pager> createPager(std::string filename)
 {
     HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE,
                         0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -114,44 +384,579 @@ std::unique_ptr<Pager> createPager(std::string filename)
         throw std::runtime_error("Unable to open file.");
     }
 
-    DWORD fileLength = GetFileSize(fileHandle, NULL);
+    // A journal left without its file belongs to nothing
+    DeleteFileA((filename + JOURNAL_SUFFIX).c_str());
+
+    uint64_t fileLength = getFileSize(fileHandle);
 
-    std::unique_ptr<Pager> pager = std::make_unique<Pager>(fileHandle, fileLength, 
-                                                           fileLength / PAGE_SIZE);
+    std::shared_ptr<Pager> pager = std::make_shared<Pager>(filename, fileHandle, fileLength, 
+                                                           static_cast<uint32_t>(fileLength / PAGE_SIZE));
 
     if (fileLength % PAGE_SIZE != 0)
     {
         throw std::runtime_error("Db file is not a whole number of pages. Corrupt file.");
     }
 
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++) 
-    {
-        pager->pages[i] = NULL;
-    }
-
     return pager;
 }
 
 // Flush pager into a file
 void Pager::pagerFlush(uint32_t pageNumber)
 {
-    if (this->pages[pageNumber] == NULL)
+    PageVersion* version = getFrame(pageNumber).newest.load(std::memory_order_acquire);
+    if (version == nullptr)
     {
         throw std::runtime_error("Db file is not a whole number of pages. Corrupt file.");
     }
 
-    DWORD bytesWritten;
-    DWORD seekPosition = pageNumber * PAGE_SIZE;
-    SetFilePointer(this->fileHandle, seekPosition, nullptr, FILE_BEGIN);
+    seekPage(this->fileHandle, pageNumber);
+    writeBytes(this->fileHandle, version->data, PAGE_SIZE);
 
-    if (!WriteFile(this->fileHandle, this->pages[pageNumber], PAGE_SIZE, &bytesWritten, nullptr))
+    // Pages past the end of the file are read from it once they are dropped from the cache
+    uint64_t pageEnd = (static_cast<uint64_t>(pageNumber) + 1) * PAGE_SIZE;
+    if (this->fileLength < pageEnd)
     {
-        throw std::runtime_error("Error while writing. Error code: " + std::to_string(GetLastError()));
+        this->fileLength = pageEnd;
     }
 }
 
+static uint32_t* headerGetFreeList(void* header)
+{
+    return reinterpret_cast<uint32_t*>(static_cast<char*>(header) + DATABASE_FREE_LIST_OFFSET);
+}
+
+static uint32_t* headerGetFreeCount(void* header)
+{
+    return reinterpret_cast<uint32_t*>(static_cast<char*>(header) + DATABASE_FREE_COUNT_OFFSET);
+}
+
+static uint32_t* freePageGetNext(void* page)
+{
+    return reinterpret_cast<uint32_t*>(static_cast<char*>(page) + FREE_PAGE_NEXT_OFFSET);
+}
+
+// Take a page from the free list of the file, or a new page on top of the file 
+// if the list is empty. Page 0 is the header, so it's never on the list
 uint32_t Pager::getUnusedPageNumber()
 {
-    // New pages are always on top of the file since free pages are not reused
-    return pageCount;
+    void* header = getPage(DATABASE_HEADER_PAGE);
+    uint32_t pageNumber = *headerGetFreeList(header);
+    if (pageNumber == 0)
+    {
+        return pageCount;
+    }
+
+    *headerGetFreeList(header) = *freePageGetNext(getPage(pageNumber));
+    (*headerGetFreeCount(header))--;
+    return pageNumber;
+}
+
+// Put a page that is no longer used on the free list. Snapshots that 
+// still see the page keep reading the version they had
+void Pager::releasePage(uint32_t pageNumber)
+{
+    void* header = getPage(DATABASE_HEADER_PAGE);
+    void* page = getPage(pageNumber);
+    memset(page, 0, PAGE_SIZE);
+    *freePageGetNext(page) = *headerGetFreeList(header);
+    *headerGetFreeList(header) = pageNumber;
+    (*headerGetFreeCount(header))++;
+}
+
+// Commits are numbered by one clock shared by every pager, so a snapshot
+// sees the same moment in every open database file
+static std::mutex versionMutex; // taken by commits
+static std::atomic<uint64_t> lastCommit(0);
+
+// Versions replaced by a commit, in commit order. A version is freed 
+// once every snapshot is at least as new as the commit that replaced it
+static std::deque<std::pair<uint64_t, PageVersion*>> retiredVersions;
+static std::atomic<size_t> retiredCount(0);
+
+// Versions evicted from the cache, numbered by a clock of evictions. Every snapshot
+// reads the same data from the file again, but a reader may still hold the evicted page.
+// A version is freed once every reader started reading its pages after the eviction
+static std::atomic<uint64_t> lastEviction(0);
+static std::deque<std::pair<uint64_t, PageVersion*>> evictedVersions;
+
+const uint64_t NO_SNAPSHOT = UINT64_MAX;
+
+// Version of the snapshot a thread holds. Readers only write their own slot,
+// commits read all of them to find the oldest snapshot
+struct SnapshotSlot
+{
+    std::atomic<uint64_t> version;
+    std::atomic<uint64_t> eviction; // last eviction before the pages the thread holds were read
+
+    SnapshotSlot();
+    ~SnapshotSlot();
+};
+
+static std::mutex slotsMutex;
+static std::vector<SnapshotSlot*> snapshotSlots;
+
+SnapshotSlot::SnapshotSlot() : version(NO_SNAPSHOT), eviction(NO_SNAPSHOT)
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    snapshotSlots.push_back(this);
+}
+
+SnapshotSlot::~SnapshotSlot()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    snapshotSlots.erase(std::find(snapshotSlots.begin(), snapshotSlots.end(), this));
+}
+
+thread_local SnapshotSlot threadSnapshot;
+thread_local uint32_t threadSnapshotDepth = 0;
+
+// Called with versionMutex held
+static uint64_t getOldestSnapshot()
+{
+    uint64_t oldestSnapshot = lastCommit.load();
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (SnapshotSlot* slot : snapshotSlots)
+    {
+        oldestSnapshot = std::min(oldestSnapshot, slot->version.load());
+    }
+    return oldestSnapshot;
+}
+
+// Called with versionMutex held
+static void reclaimVersions()
+{
+    uint64_t oldestSnapshot = getOldestSnapshot();
+    while (!retiredVersions.empty() && retiredVersions.front().first <= oldestSnapshot)
+    {
+        delete retiredVersions.front().second;
+        retiredVersions.pop_front();
+    }
+
+    uint64_t oldestEviction = lastEviction.load();
+    {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        for (SnapshotSlot* slot : snapshotSlots)
+        {
+            oldestEviction = std::min(oldestEviction, slot->eviction.load());
+        }
+    }
+    while (!evictedVersions.empty() && evictedVersions.front().first <= oldestEviction)
+    {
+        delete evictedVersions.front().second;
+        evictedVersions.pop_front();
+    }
+    retiredCount.store(retiredVersions.size() + evictedVersions.size(), std::memory_order_relaxed);
+}
+
+// Pages evicted after the calling thread publishes the eviction clock are not freed
+// until it publishes it again. Like the snapshot version, it's read again until it didn't
+// move in between
+static void publishEviction()
+{
+    uint64_t eviction;
+    do
+    {
+        eviction = lastEviction.load();
+        threadSnapshot.eviction.store(eviction);
+    } while (lastEviction.load() != eviction);
+}
+
+// A commit that reclaims between reading the clock and publishing the slot would 
+// miss this snapshot, so the clock is read again until it didn't move in between
+Snapshot::Snapshot() : pinned(true)
+{
+    if (threadSnapshotDepth++ == 0)
+    {
+        uint64_t version;
+        do
+        {
+            version = lastCommit.load();
+            threadSnapshot.version.store(version);
+        } while (lastCommit.load() != version);
+        publishEviction();
+    }
+}
+
+// Read the version of a snapshot another thread holds, so threads that work on
+// one statement see the same state. The other snapshot has to outlive this one
+Snapshot::Snapshot(uint64_t version) : pinned(true)
+{
+    if (threadSnapshotDepth++ == 0)
+    {
+        threadSnapshot.version.store(version);
+        publishEviction();
+    }
+}
+
+Snapshot::Snapshot(Snapshot&& other) noexcept : pinned(other.pinned)
+{
+    other.pinned = false;
+}
+
+Snapshot& Snapshot::operator=(Snapshot&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->~Snapshot();
+        pinned = other.pinned;
+        other.pinned = false;
+    }
+    return *this;
+}
+
+// The last snapshot of a thread frees versions nobody reads anymore, 
+// unless a commit is doing it already
+Snapshot::~Snapshot()
+{
+    if (!pinned)
+    {
+        return;
+    }
+    pinned = false;
+
+    if (--threadSnapshotDepth == 0)
+    {
+        threadSnapshot.version.store(NO_SNAPSHOT);
+        threadSnapshot.eviction.store(NO_SNAPSHOT);
+        if (retiredCount.load(std::memory_order_relaxed) > 0)
+        {
+            std::unique_lock<std::mutex> lock(versionMutex, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+                reclaimVersions();
+            }
+        }
+    }
+}
+
+// Version the calling thread reads, the newest one if it holds no snapshot
+uint64_t Snapshot::getVersion()
+{
+    return threadSnapshotDepth > 0 ? threadSnapshot.version.load(std::memory_order_relaxed) 
+                                   : NO_SNAPSHOT;
+}
+
+// The calling thread no longer uses any page it read, so pages evicted since can be 
+// freed. It keeps reading the same snapshot. A long scan calls it between batches
+void Snapshot::releasePages()
+{
+    if (threadSnapshotDepth > 0)
+    {
+        publishEviction();
+    }
+}
+
+// Make the calling thread the writer, pages it reads from now on are copied
+void Pager::beginWrite()
+{
+    writePageCount = pageCount;
+    writer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+}
+
+// Drop the copies of the writer, the committed versions stay as they were
+void Pager::discardWrite()
+{
+    for (uint32_t pageNumber : pendingPages)
+    {
+        Frame& frame = getFrame(pageNumber);
+        delete frame.pending;
+        frame.pending = nullptr;
+    }
+    pendingPages.clear();
+
+    // Pages taken from the top of the file are given back. Only the writer could reach them
+    for (uint32_t pageNumber = writePageCount; pageNumber < pageCount; pageNumber++)
+    {
+        freePage(pageNumber);
+    }
+    pageCount = writePageCount;
+
+    writer.store(std::thread::id(), std::memory_order_relaxed);
+    evictAt.store(cacheLimit);
+}
+
+// Commit the copies of the writer, they are put in front of the versions they replace.
+// Snapshots taken from now on see them, older snapshots keep reading the old versions.
+// Copies that weren't changed are dropped, so they aren't written to the file
+void Pager::commitWrite()
+{
+    std::lock_guard<std::mutex> lock(versionMutex);
+    uint64_t commitVersion = lastCommit.load() + 1;
+    for (uint32_t pageNumber : pendingPages)
+    {
+        Frame& frame = getFrame(pageNumber);
+        PageVersion* replaced = frame.newest.load(std::memory_order_relaxed);
+        if (replaced != nullptr && memcmp(frame.pending->data, replaced->data, PAGE_SIZE) == 0)
+        {
+            delete frame.pending;
+            frame.pending = nullptr;
+            continue;
+        }
+
+        frame.pending->commitVersion = commitVersion;
+        frame.pending->older.store(replaced, std::memory_order_relaxed);
+        frame.newest.store(frame.pending, std::memory_order_release);
+        frame.pending = nullptr;
+        if (!frame.dirty)
+        {
+            frame.dirty = true;
+            dirtyPages.push_back(pageNumber);
+        }
+
+        if (replaced != nullptr)
+        {
+            retiredVersions.emplace_back(commitVersion, replaced);
+        }
+        else
+        {
+            // The page cache was emptied while the copy was pending
+            cachedPageCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    pendingPages.clear();
+    writer.store(std::thread::id(), std::memory_order_relaxed);
+
+    lastCommit.store(commitVersion);
+    reclaimVersions();
+
+    // Pages the writer copied kept the cache over its limit, they can be evicted now
+    evictAt.store(cacheLimit);
+}
+
+// True if the calling thread has a transaction open. Only the writer sets the lock
+bool Pager::inTransaction()
+{
+    return writer.load(std::memory_order_relaxed) == std::this_thread::get_id() &&
+           transactionLock.owns_lock();
+}
+
+// Keep the writer mutex and the copies of the writer until the transaction ends.
+// The committed versions stay as they were, so they are the undo image of the transaction.
+// Return false if the thread has a transaction open
+bool Pager::beginTransaction()
+{
+    if (inTransaction())
+    {
+        return false;
+    }
+
+    transactionLock = std::unique_lock<std::mutex>(writeMutex);
+    beginWrite();
+    return true;
+}
+
+// Commit every page the transaction changed, then write them to the file with every
+// other changed page. The writer mutex is released however the write ends, pages that
+// failed to be written stay changed for the next checkpoint. Return false if no 
+// transaction is open
+bool Pager::commitTransaction()
+{
+    if (!inTransaction())
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(std::move(transactionLock));
+    commitWrite();
+    writeDirtyPages();
+    return true;
+}
+
+// Drop the copies of the transaction, return false if no transaction is open
+bool Pager::rollbackTransaction()
+{
+    if (!inTransaction())
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(std::move(transactionLock));
+    discardWrite();
+    return true;
+}
+
+// Write the newest committed version of every changed page to the file at once, 
+// in page order. The pages they overwrite are saved to the journal and flushed first, 
+// so if the write stops halfway the file is rolled back when it's opened again. 
+// Called with the writer mutex held
+void Pager::writeDirtyPages()
+{
+    if (dirtyPages.empty())
+    {
+        return;
+    }
+
+    // Readers that miss the cache don't read the file while it's written
+    std::lock_guard<std::mutex> lock(loadMutex);
+    if (hotJournal)
+    {
+        rollbackJournal(filename, fileHandle);
+        fileLength = getFileSize(fileHandle);
+        hotJournal = false;
+    }
+
+    std::string journalName = filename + JOURNAL_SUFFIX;
+    HANDLE journal = CreateFileA(journalName.c_str(), GENERIC_READ | GENERIC_WRITE,
+                     0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (journal == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Unable to create journal. Error code: " + std::to_string(GetLastError()));
+    }
+    hotJournal = true;
+
+    try
+    {
+        // Pages past the end of the file are not saved, the file is cut back instead
+        std::sort(dirtyPages.begin(), dirtyPages.end());
+        char header[JOURNAL_HEADER_SIZE] = {};
+        writeBytes(journal, header, JOURNAL_HEADER_SIZE);
+
+        std::unique_ptr<char[]> entry(new char[JOURNAL_ENTRY_SIZE]);
+        uint32_t savedCount = 0;
+        for (uint32_t pageNumber : dirtyPages)
+        {
+            if ((static_cast<uint64_t>(pageNumber) + 1) * PAGE_SIZE > fileLength)
+            {
+                break;
+            }
+            memcpy(entry.get(), &pageNumber, JOURNAL_PAGE_NUMBER_SIZE);
+            seekPage(fileHandle, pageNumber);
+            readBytes(fileHandle, entry.get() + JOURNAL_PAGE_NUMBER_SIZE, PAGE_SIZE);
+            writeBytes(journal, entry.get(), JOURNAL_ENTRY_SIZE);
+            savedCount++;
+        }
+        flushFile(journal);
+
+        memcpy(header + JOURNAL_MAGIC_OFFSET, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        memcpy(header + JOURNAL_FILE_LENGTH_OFFSET, &fileLength, JOURNAL_FILE_LENGTH_SIZE);
+        memcpy(header + JOURNAL_PAGE_COUNT_OFFSET, &savedCount, JOURNAL_PAGE_COUNT_SIZE);
+        LARGE_INTEGER start;
+        start.QuadPart = 0;
+        if (!SetFilePointerEx(journal, start, nullptr, FILE_BEGIN))
+        {
+            throw std::runtime_error("Error seeking in file. Error code: " + std::to_string(GetLastError()));
+        }
+        writeBytes(journal, header, JOURNAL_HEADER_SIZE);
+        flushFile(journal);
+
+        for (uint32_t pageNumber : dirtyPages)
+        {
+            if (getFrame(pageNumber).newest.load(std::memory_order_relaxed) != nullptr)
+            {
+                pagerFlush(pageNumber);
+            }
+        }
+        flushFile(fileHandle);
+    }
+    catch (...)
+    {
+        CloseHandle(journal);
+        throw;
+    }
+
+    CloseHandle(journal);
+    if (!DeleteFileA(journalName.c_str()))
+    {
+        throw std::runtime_error("Unable to delete journal. Error code: " + std::to_string(GetLastError()));
+    }
+    hotJournal = false;
+
+    for (uint32_t pageNumber : dirtyPages)
+    {
+        getFrame(pageNumber).dirty = false;
+    }
+    dirtyPages.clear();
+}
+
+// Drop the least recently used pages until the cache is a quarter below its limit.
+// Only pages whose newest version every snapshot reads and that the writer didn't copy 
+// are evicted, a snapshot that reads them again from the file sees the same data.
+// Changed pages are written first, all of them, since writing only some could tear 
+// the tree. Evicting needs the writer mutex, a reader that can't take it leaves it 
+// to the writer. Threads without a snapshot may hold pages nothing protects, they don't evict
+void Pager::evictPages()
+{
+    std::unique_lock<std::mutex> writeLock(writeMutex, std::defer_lock);
+    if (writer.load(std::memory_order_relaxed) != std::this_thread::get_id())
+    {
+        if (Snapshot::getVersion() == NO_SNAPSHOT || !writeLock.try_lock())
+        {
+            return;
+        }
+    }
+
+    uint32_t slack = std::max<uint32_t>(cacheLimit / 4, 1);
+    uint32_t keepCount = cacheLimit - slack;
+    std::vector<std::pair<uint64_t, uint32_t>> victims; // last use, page number
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        uint64_t oldestSnapshot;
+        {
+            std::lock_guard<std::mutex> versionLock(versionMutex);
+            oldestSnapshot = getOldestSnapshot();
+        }
+
+        for (uint32_t pageNumber = 0; pageNumber < pageCount; pageNumber++)
+        {
+            Frame* frames = frameGroups[pageNumber / PAGER_FRAME_GROUP_SIZE].load(std::memory_order_acquire);
+            if (frames == nullptr)
+            {
+                pageNumber += PAGER_FRAME_GROUP_SIZE - 1 - pageNumber % PAGER_FRAME_GROUP_SIZE;
+                continue;
+            }
+            Frame& frame = frames[pageNumber % PAGER_FRAME_GROUP_SIZE];
+            PageVersion* version = frame.newest.load(std::memory_order_relaxed);
+            if (version != nullptr && frame.pending == nullptr && version->commitVersion <= oldestSnapshot)
+            {
+                victims.emplace_back(frame.lastUse.load(std::memory_order_relaxed), pageNumber);
+            }
+        }
+
+        uint32_t cachedCount = cachedPageCount.load(std::memory_order_relaxed);
+        size_t victimCount = std::min<size_t>(victims.size(), cachedCount > keepCount ? cachedCount - keepCount : 0);
+        std::nth_element(victims.begin(), victims.begin() + victimCount, victims.end());
+        victims.resize(victimCount);
+    }
+
+    bool dirty = std::any_of(victims.begin(), victims.end(), 
+                             [this](const std::pair<uint64_t, uint32_t>& victim) 
+                             { return getFrame(victim.second).dirty; });
+    if (dirty)
+    {
+        writeDirtyPages();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        std::lock_guard<std::mutex> versionLock(versionMutex);
+        uint64_t eviction = lastEviction.load() + 1;
+        for (const std::pair<uint64_t, uint32_t>& victim : victims)
+        {
+            PageVersion* version = getFrame(victim.second).newest.exchange(nullptr);
+            if (version != nullptr)
+            {
+                evictedVersions.emplace_back(eviction, version);
+                cachedPageCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        lastEviction.store(eviction);
+        reclaimVersions();
+    }
+
+    uint32_t cachedCount = cachedPageCount.load(std::memory_order_relaxed);
+    evictAt.store(std::max(cacheLimit, cachedCount + slack));
+}
+
+// Write every committed page that changed to the file. Waits for the writer of another
+// thread. Inside a transaction of the calling thread its own pages are left out
+void Pager::checkpoint()
+{
+    if (writer.load(std::memory_order_relaxed) == std::this_thread::get_id())
+    {
+        writeDirtyPages();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    writeDirtyPages();
 }
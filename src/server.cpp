@@ -0,0 +1,635 @@
+#include "../includes/server.h"
+#include "../includes/database.h"
+
+// Length of a frame, stored before its text
+static void appendFrame(std::string& output, std::string_view text)
+{
+    uint32_t length = static_cast<uint32_t>(text.size());
+    char header[SERVER_FRAME_HEADER_SIZE];
+    for (uint32_t i = 0; i < SERVER_FRAME_HEADER_SIZE; i++)
+    {
+        header[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+    }
+    output.append(header, SERVER_FRAME_HEADER_SIZE);
+    output.append(text);
+}
+
+// Length of the frame at the start of the input, false if the header isn't complete
+static bool readFrameLength(std::string_view input, uint32_t& length)
+{
+    if (input.size() < SERVER_FRAME_HEADER_SIZE)
+    {
+        return false;
+    }
+    length = 0;
+    for (uint32_t i = 0; i < SERVER_FRAME_HEADER_SIZE; i++)
+    {
+        length |= static_cast<uint32_t>(static_cast<uint8_t>(input[i])) << (8 * i);
+    }
+    return true;
+}
+
+static bool hasWholeFrame(std::string_view input)
+{
+    uint32_t length;
+    return readFrameLength(input, length) && input.size() - SERVER_FRAME_HEADER_SIZE >= length;
+}
+
+static void appendResponseHeader(std::string& output, ResponseStatus status, uint8_t code,
+                                 ResponsePayload payload)
+{
+    output.push_back(static_cast<char>(status));
+    output.push_back(static_cast<char>(code));
+    output.push_back(static_cast<char>(payload));
+}
+
+// Take the next bytes of a binary response, false if the frame ends before
+static bool readBytes(std::string_view& input, void* destination, size_t size)
+{
+    if (input.size() < size)
+    {
+        return false;
+    }
+    memcpy(destination, input.data(), size);
+    input.remove_prefix(size);
+    return true;
+}
+
+static bool readString(std::string_view& input, char* destination, size_t maxLength)
+{
+    uint8_t length;
+    if (!readBytes(input, &length, STRING_LENGTH_SIZE) || length > maxLength ||
+        !readBytes(input, destination, length))
+    {
+        return false;
+    }
+    destination[length] = '\0';
+    return true;
+}
+
+// Record of writeSerializedRow(), only the columns of the response are set
+static bool readRecord(std::string_view& input, const std::vector<RowColumn>& columns, Row& row)
+{
+    for (RowColumn column : columns)
+    {
+        switch (column)
+        {
+        case COLUMN_ID:
+        {
+            char key[KEY_COMPOSITE_SIZE];
+            if (!readBytes(input, &row.keyType, sizeof(row.keyType)) || row.keyType > KEY_COMPOSITE ||
+                !readBytes(input, key, keySize(row.keyType)))
+            {
+                return false;
+            }
+            row.key = readKey(row.keyType, key);
+            break;
+        }
+        case COLUMN_USERNAME:
+            if (!readString(input, row.username, COLUMN_USERNAME_SIZE))
+            {
+                return false;
+            }
+            break;
+        case COLUMN_EMAIL:
+            if (!readString(input, row.email, COLUMN_EMAIL_SIZE))
+            {
+                return false;
+            }
+            break;
+        case COLUMN_VALUE:
+        {
+            uint32_t length;
+            if (!readBytes(input, &length, VALUE_LENGTH_SIZE) || input.size() < length)
+            {
+                return false;
+            }
+            row.value.assign(input.data(), length);
+            input.remove_prefix(length);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool setNonBlocking(SOCKET socket)
+{
+    unsigned long mode = 1;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+}
+
+static sockaddr_un socketAddress(const std::string& socketPath)
+{
+    if (socketPath.size() >= UNIX_PATH_MAX)
+    {
+        throw std::runtime_error("Socket path " + socketPath + " is too long.");
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath.data(), socketPath.size());
+    return address;
+}
+
+Session::Session(SOCKET socket) : socket(socket), outputSent(0), peerClosed(false), closed(false) { }
+
+// A socket file left by a server that didn't stop cleanly is replaced
+Server::Server(Database& database, const std::string& socketPath) :
+    database(database), socketPath(socketPath), listener(INVALID_SOCKET), stopping(false),
+    transactionSession(nullptr)
+{
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+    {
+        throw std::runtime_error("Unable to start Winsock.");
+    }
+
+    sockaddr_un address = socketAddress(socketPath);
+    DeleteFileA(socketPath.c_str());
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET ||
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listener, SERVER_BACKLOG) == SOCKET_ERROR || !setNonBlocking(listener))
+    {
+        int error = WSAGetLastError();
+        if (listener != INVALID_SOCKET)
+        {
+            closesocket(listener);
+        }
+        WSACleanup();
+        throw std::runtime_error("Unable to listen on " + socketPath + ". Error code: " + 
+                                 std::to_string(error));
+    }
+}
+
+Server::~Server()
+{
+    for (std::unique_ptr<Session>& session : sessions)
+    {
+        closesocket(session->socket);
+    }
+    closesocket(listener);
+    DeleteFileA(socketPath.c_str());
+    WSACleanup();
+}
+
+// Serve until stop() is called, then save the database file
+void Server::run()
+{
+    std::vector<WSAPOLLFD> polled;
+    while (!stopping.load())
+    {
+        polled.clear();
+        polled.push_back({ listener, POLLRDNORM, 0 });
+        for (std::unique_ptr<Session>& session : sessions)
+        {
+            short events = session->peerClosed ? 0 : POLLRDNORM;
+            if (session->outputSent < session->output.size())
+            {
+                events |= POLLWRNORM;
+            }
+            polled.push_back({ session->socket, events, 0 });
+        }
+
+        if (WSAPoll(polled.data(), static_cast<unsigned long>(polled.size()), SERVER_POLL_TIMEOUT_MS) == SOCKET_ERROR &&
+            WSAGetLastError() != WSAEINTR)
+        {
+            throw std::runtime_error("Unable to poll connections. Error code: " + 
+                                     std::to_string(WSAGetLastError()));
+        }
+
+        // Sessions accepted now are polled from the next round on
+        size_t polledSessions = sessions.size();
+        if (polled[0].revents != 0)
+        {
+            acceptSessions();
+        }
+
+        for (size_t i = 0; i < polledSessions; i++)
+        {
+            Session& session = *sessions[i];
+            if (polled[i + 1].revents & (POLLRDNORM | POLLHUP | POLLERR))
+            {
+                receive(session);
+            }
+        }
+
+        // Requests that waited for a transaction of another session run as soon as it ends.
+        // A client that closed its side is done once its requests ran and the responses are sent
+        for (std::unique_ptr<Session>& session : sessions)
+        {
+            runRequests(*session);
+            send(*session);
+            if (session->peerClosed && !hasWholeFrame(session->input) && session->output.empty())
+            {
+                session->closed = true;
+            }
+        }
+
+        for (std::unique_ptr<Session>& session : sessions)
+        {
+            if (session->closed)
+            {
+                closeSession(*session);
+            }
+        }
+        std::erase_if(sessions, [](const std::unique_ptr<Session>& session) { return session->closed; });
+    }
+
+    database.getTables().closeAll();
+}
+
+// Can be called from any thread, the server stops within one poll timeout
+void Server::stop()
+{
+    stopping.store(true);
+}
+
+void Server::acceptSessions()
+{
+    while (true)
+    {
+        SOCKET socket = accept(listener, nullptr, nullptr);
+        if (socket == INVALID_SOCKET)
+        {
+            return;
+        }
+        if (!setNonBlocking(socket))
+        {
+            closesocket(socket);
+            continue;
+        }
+        sessions.push_back(std::make_unique<Session>(socket));
+    }
+}
+
+// A client may shut down its side after the last request, the requests it sent 
+// before still run and get their responses
+void Server::receive(Session& session)
+{
+    char block[SERVER_RECEIVE_SIZE];
+    while (!session.closed && !session.peerClosed)
+    {
+        int received = recv(session.socket, block, SERVER_RECEIVE_SIZE, 0);
+        if (received > 0)
+        {
+            session.input.append(block, received);
+        }
+        else if (received == 0)
+        {
+            session.peerClosed = true;
+        }
+        else if (WSAGetLastError() != WSAEWOULDBLOCK)
+        {
+            session.closed = true;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+// Run the whole requests a session has sent. The output of every statement
+// is collected into a response frame instead of the console. A request that
+// throws gets the error as its response, the server goes on with the next one
+void Server::runRequests(Session& session)
+{
+    size_t position = 0;
+    uint32_t length;
+    while (!session.closed && readFrameLength(std::string_view(session.input).substr(position), length))
+    {
+        if (length < SERVER_REQUEST_HEADER_SIZE || length > SERVER_MAX_REQUEST_SIZE)
+        {
+            session.closed = true;
+            break;
+        }
+        if (session.input.size() - position < SERVER_FRAME_HEADER_SIZE + length ||
+            (transactionSession != nullptr && transactionSession != &session) ||
+            session.output.size() - session.outputSent > SERVER_MAX_PENDING_OUTPUT)
+        {
+            break;
+        }
+
+        RequestKind kind = static_cast<RequestKind>(session.input[position + SERVER_FRAME_HEADER_SIZE]);
+        if (kind != RequestKind::REQUEST_BINARY && kind != RequestKind::REQUEST_TEXT)
+        {
+            session.closed = true;
+            break;
+        }
+        std::string_view statement(session.input.data() + position + SERVER_FRAME_HEADER_SIZE + SERVER_REQUEST_HEADER_SIZE,
+                                   length - SERVER_REQUEST_HEADER_SIZE);
+        position += SERVER_FRAME_HEADER_SIZE + length;
+
+        TableCache& tables = database.getTables();
+        tables.setCurrent(session.currentName);
+        response.str(std::string());
+        std::streambuf* console = std::cout.rdbuf(response.rdbuf());
+        std::string result;
+        bool keepOpen = true;
+        try
+        {
+            if (kind == RequestKind::REQUEST_BINARY)
+            {
+                keepOpen = runBinaryRequest(statement, result);
+            }
+            else
+            {
+                keepOpen = database.handleRequest(statement);
+                result = response.view();
+            }
+        }
+        catch (const std::exception& exception)
+        {
+            result.clear();
+            if (kind == RequestKind::REQUEST_BINARY)
+            {
+                appendResponseHeader(result, ResponseStatus::RESPONSE_ERROR, 0, ResponsePayload::PAYLOAD_TEXT);
+                result += exception.what();
+            }
+            else
+            {
+                result = response.view();
+                result += "Error: " + std::string(exception.what()) + "\n";
+            }
+        }
+        catch (...)
+        {
+            result.clear();
+            if (kind == RequestKind::REQUEST_BINARY)
+            {
+                appendResponseHeader(result, ResponseStatus::RESPONSE_ERROR, 0, ResponsePayload::PAYLOAD_TEXT);
+                result += "An unexpected error has occured.";
+            }
+            else
+            {
+                result = response.view();
+                result += "Error: An unexpected error has occured.\n";
+            }
+        }
+        std::cout.rdbuf(console);
+
+        session.currentName = tables.getCurrentName();
+        transactionSession = tables.inTransaction() ? &session : nullptr;
+        appendFrame(session.output, result);
+
+        // ".exit" ends the session like a client that shut down its side: later requests
+        // are dropped, and the session is closed once its responses are sent. Its 
+        // transaction is rolled back then, the tables stay open for the other sessions
+        if (!keepOpen)
+        {
+            session.peerClosed = true;
+            position = session.input.size();
+            break;
+        }
+    }
+    session.input.erase(0, position);
+}
+
+// Run a binary request. A statement writes its rows or its count in the binary
+// format, a meta command prints to the console and its output is sent as text.
+// False if it was .exit
+bool Server::runBinaryRequest(std::string_view text, std::string& result)
+{
+    if (text.empty())
+    {
+        appendResponseHeader(result, ResponseStatus::RESPONSE_EXECUTE, 
+                             static_cast<uint8_t>(ExecuteResult::EXECUTE_SUCCESS), ResponsePayload::PAYLOAD_NONE);
+        return true;
+    }
+    if (text.front() == '.')
+    {
+        if (metaInput == nullptr)
+        {
+            metaInput = std::make_shared<InputBuffer>();
+        }
+        metaInput->setInput(text);
+
+        // .exit leaves the tables open for the other sessions
+        MetaCommandResult metaResult = metaInput->getBuffer() == ".exit" ? MetaCommandResult::META_COMMAND_EXIT :
+                                       doMetaCommand(metaInput, database.getTables());
+        appendResponseHeader(result, ResponseStatus::RESPONSE_META, static_cast<uint8_t>(metaResult), 
+                             response.view().empty() ? ResponsePayload::PAYLOAD_NONE : ResponsePayload::PAYLOAD_TEXT);
+        result += response.view();
+        return metaResult != MetaCommandResult::META_COMMAND_EXIT;
+    }
+
+    Statement statement;
+    PrepareResult prepareResult = statement.prepareStatement(text);
+    if (prepareResult != PrepareResult::PREPARE_SUCCESS)
+    {
+        appendResponseHeader(result, ResponseStatus::RESPONSE_PREPARE, static_cast<uint8_t>(prepareResult),
+                             ResponsePayload::PAYLOAD_NONE);
+        return true;
+    }
+
+    ExecuteResult executeResult = statement.executeStatement(database.getTables(), response, OUTPUT_BINARY);
+    uint8_t code = static_cast<uint8_t>(executeResult);
+    if (executeResult != ExecuteResult::EXECUTE_SUCCESS || statement.getStatement() != StatementType::STATEMENT_SELECT)
+    {
+        appendResponseHeader(result, ResponseStatus::RESPONSE_EXECUTE, code, ResponsePayload::PAYLOAD_NONE);
+    }
+    else if (statement.isCounting())
+    {
+        appendResponseHeader(result, ResponseStatus::RESPONSE_EXECUTE, code, ResponsePayload::PAYLOAD_COUNT);
+        result += response.view();
+    }
+    else
+    {
+        static const std::vector<RowColumn> allColumns = { COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL, COLUMN_VALUE };
+        const std::vector<RowColumn>& columns = statement.getColumns().empty() ? allColumns : statement.getColumns();
+        appendResponseHeader(result, ResponseStatus::RESPONSE_EXECUTE, code, ResponsePayload::PAYLOAD_ROWS);
+        result.push_back(static_cast<char>(columns.size()));
+        result.append(reinterpret_cast<const char*>(columns.data()), columns.size());
+        result += response.view();
+    }
+    return true;
+}
+
+void Server::send(Session& session)
+{
+    while (session.outputSent < session.output.size())
+    {
+        int sent = ::send(session.socket, session.output.data() + session.outputSent,
+                          static_cast<int>(session.output.size() - session.outputSent), 0);
+        if (sent == SOCKET_ERROR)
+        {
+            if (WSAGetLastError() != WSAEWOULDBLOCK)
+            {
+                session.closed = true;
+            }
+            return;
+        }
+        session.outputSent += sent;
+    }
+    session.output.clear();
+    session.outputSent = 0;
+}
+
+// A transaction left open by a closed session is rolled back
+void Server::closeSession(Session& session)
+{
+    if (transactionSession == &session)
+    {
+        database.getTables().rollback();
+        transactionSession = nullptr;
+    }
+    closesocket(session.socket);
+}
+
+ServerConnection::ServerConnection(const std::string& socketPath) : socket(INVALID_SOCKET)
+{
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+    {
+        throw std::runtime_error("Unable to start Winsock.");
+    }
+
+    sockaddr_un address = socketAddress(socketPath);
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET ||
+        connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+    {
+        int error = WSAGetLastError();
+        if (socket != INVALID_SOCKET)
+        {
+            closesocket(socket);
+        }
+        WSACleanup();
+        throw std::runtime_error("Unable to connect to " + socketPath + ". Error code: " + 
+                                 std::to_string(error));
+    }
+}
+
+ServerConnection::~ServerConnection()
+{
+    closesocket(socket);
+    WSACleanup();
+}
+
+// Send a request without waiting for its response
+bool ServerConnection::sendRequest(std::string_view statement, RequestKind kind)
+{
+    std::string request;
+    request.reserve(SERVER_REQUEST_HEADER_SIZE + statement.size());
+    request.push_back(static_cast<char>(kind));
+    request.append(statement);
+    std::string frame;
+    appendFrame(frame, request);
+    for (size_t sent = 0; sent < frame.size();)
+    {
+        int result = ::send(socket, frame.data() + sent, static_cast<int>(frame.size() - sent), 0);
+        if (result == SOCKET_ERROR)
+        {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+// Tell the server that no more requests come, the responses of the sent ones still arrive
+bool ServerConnection::finishRequests()
+{
+    return shutdown(socket, SD_SEND) != SOCKET_ERROR;
+}
+
+// Wait for the next response, false if the server closed the connection
+bool ServerConnection::receiveResponse(std::string& output)
+{
+    uint32_t length;
+    while (!readFrameLength(input, length) || input.size() < SERVER_FRAME_HEADER_SIZE + length)
+    {
+        char block[SERVER_RECEIVE_SIZE];
+        int received = recv(socket, block, SERVER_RECEIVE_SIZE, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        input.append(block, received);
+    }
+
+    output.assign(input, SERVER_FRAME_HEADER_SIZE, length);
+    input.erase(0, SERVER_FRAME_HEADER_SIZE + length);
+    return true;
+}
+
+// Wait for the next response of a binary request and decode it,
+// false if the server closed the connection or the response is malformed
+bool ServerConnection::receiveResponse(ServerResponse& response)
+{
+    std::string frame;
+    if (!receiveResponse(frame))
+    {
+        return false;
+    }
+
+    std::string_view input(frame);
+    response = ServerResponse();
+    if (!readBytes(input, &response.status, sizeof(response.status)) ||
+        !readBytes(input, &response.code, sizeof(response.code)) ||
+        !readBytes(input, &response.payload, sizeof(response.payload)))
+    {
+        return false;
+    }
+
+    switch (response.payload)
+    {
+    case ResponsePayload::PAYLOAD_NONE:
+        return input.empty();
+    case ResponsePayload::PAYLOAD_ROWS:
+    {
+        uint8_t columnCount;
+        if (!readBytes(input, &columnCount, sizeof(columnCount)))
+        {
+            return false;
+        }
+        response.columns.resize(columnCount);
+        if (!readBytes(input, response.columns.data(), columnCount))
+        {
+            return false;
+        }
+        while (!input.empty())
+        {
+            Row& row = response.rows.emplace_back();
+            if (!readRecord(input, response.columns, row))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case ResponsePayload::PAYLOAD_COUNT:
+        return readBytes(input, &response.count, sizeof(response.count)) && input.empty();
+    case ResponsePayload::PAYLOAD_TEXT:
+        response.text = input;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Send a text request and wait for the output the console would print
+std::string ServerConnection::request(std::string_view statement)
+{
+    std::string output;
+    if (!sendRequest(statement) || !receiveResponse(output))
+    {
+        throw std::runtime_error("Connection to the server was closed.");
+    }
+    return output;
+}
+
+// Send a binary request and wait for its result
+ServerResponse ServerConnection::query(std::string_view statement)
+{
+    ServerResponse response;
+    if (!sendRequest(statement, RequestKind::REQUEST_BINARY) || !receiveResponse(response))
+    {
+        throw std::runtime_error("Connection to the server was closed.");
+    }
+    return response;
+}
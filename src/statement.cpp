@@ -1,27 +1,110 @@
 #include "../includes/statement.h"
+#include "../includes/transfer.h"
+#include "../includes/workerpool.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 
 // META COMMANDS
 
-MetaCommandResult doMetaCommand(std::shared_ptr<InputBuffer> inputBuffer, 
-                                  const std::shared_ptr<Table>& table)
+// ".import file [table-name]" or ".export file [table-name]", the extension 
+// of the file decides if it's CSV or binary
+static MetaCommandResult doTransferCommand(std::string_view input, TableCache& tables)
+{
+    bool importing = input.starts_with(".import");
+    Tokenizer tokens(input, 7);
+
+    std::string_view _filename;
+    std::string_view _tableName;
+    std::string_view _rest;
+    TransferFormat format;
+
+    if (!tokens.word(_filename) || !parseTransferFormat(_filename, format))
+    {
+        return MetaCommandResult::META_COMMAND_SYNTAX_ERROR;
+    }
+    tokens.word(_tableName);
+    if (tokens.word(_rest))
+    {
+        return MetaCommandResult::META_COMMAND_SYNTAX_ERROR;
+    }
+
+    std::shared_ptr<Table> table = _tableName.empty() ? tables.current() 
+                                                      : tables.get(std::string(_tableName));
+    if (table == nullptr)
+    {
+        return _tableName.empty() ? MetaCommandResult::META_COMMAND_TABLE_NOT_SELECTED 
+                                  : MetaCommandResult::META_COMMAND_TABLE_NOT_FOUND;
+    }
+
+    std::string filename(_filename);
+    uint64_t rowCount;
+    TransferResult result = importing ? importTable(table, filename, format, rowCount) 
+                                      : exportTable(table, filename, format, rowCount);
+    switch (result)
+    {
+    case TransferResult::TRANSFER_SUCCESS:
+        std::cout << (importing ? "Imported " : "Exported ") << rowCount << " rows." << std::endl;
+        return MetaCommandResult::META_COMMAND_SUCCESS;
+    case TransferResult::TRANSFER_FILE_ERROR:
+        std::cout << "Error: Could not " << (importing ? "read " : "write ") << filename << "." << std::endl;
+        return MetaCommandResult::META_COMMAND_SUCCESS;
+    case TransferResult::TRANSFER_FORMAT_ERROR:
+        std::cout << "Error: Row " << rowCount + 1 << " of the file could not be parsed.";
+        break;
+    case TransferResult::TRANSFER_STRING_TOO_LONG:
+        std::cout << "Error: Row " << rowCount + 1 << " of the file has a string that is too long.";
+        break;
+    case TransferResult::TRANSFER_KEY_TYPE_MISMATCH:
+        std::cout << "Error: Key of row " << rowCount + 1 << " of the file doesn't match the table.";
+        break;
+    case TransferResult::TRANSFER_DUPLICATE_KEY:
+        std::cout << "Error: Duplicate key in the batch after row " << rowCount << " of the file.";
+        break;
+    }
+    std::cout << " Imported " << rowCount << " rows." << std::endl;
+    return MetaCommandResult::META_COMMAND_SUCCESS;
+}
+
+MetaCommandResult doMetaCommand(std::shared_ptr<InputBuffer> inputBuffer, TableCache& tables)
 {
 	if (inputBuffer->getBuffer() == ".exit")
 	{
-        saveAndCloseDatabase(table);
-		exit(EXIT_SUCCESS);
+        tables.closeAll();
+        return MetaCommandResult::META_COMMAND_EXIT;
 	}
     if (inputBuffer->getBuffer() == ".save")
 	{
-        saveTable(table);
+        saveTable(tables.getCatalog());
 		std::cout << "Executed." << std::endl;
         return MetaCommandResult::META_COMMAND_SUCCESS;
 	}
     else if (inputBuffer->getBuffer() == ".btree")
     {
-        printTree(table->pager, 0, 0);
+        std::shared_ptr<Table> table = tables.current();
+        if (table == nullptr)
+        {
+            return MetaCommandResult::META_COMMAND_TABLE_NOT_SELECTED;
+        }
+        printTree(table->pager, table->rootPageNumber, 0);
+        return MetaCommandResult::META_COMMAND_SUCCESS;
+    }
+    else if (inputBuffer->getBuffer() == ".tables")
+    {
+        for (const std::string& name : catalogList(tables.getCatalog(), CATALOG_TABLE))
+        {
+            std::cout << name << std::endl;
+        }
         return MetaCommandResult::META_COMMAND_SUCCESS;
     }
+    else if (inputBuffer->getBuffer().starts_with(".import ") || 
+             inputBuffer->getBuffer().starts_with(".export "))
+    {
+        return doTransferCommand(inputBuffer->getBuffer(), tables);
+    }
     else if (inputBuffer->getBuffer() == ".constants")
     {
         printConstants();
@@ -35,56 +118,151 @@ MetaCommandResult doMetaCommand(std::shared_ptr<InputBuffer> inputBuffer,
 
 // STATEMENTS
 
-Statement::Statement() : type(), tableName("") { };
+Statement::Statement() : type(), tableName(""), ranged(false), rangeStart(MIN_KEY), rangeEnd(MAX_KEY),
+                         keyOperator(""), betweenEnd(MAX_KEY), betweenEndType(KEY_INTEGER),
+                         whereColumn(INDEX_COUNT), descending(false), limit(UINT64_MAX), offset(0),
+                         counting(false), whereLike(false), output(&std::cout),
+                         outputFormat(OUTPUT_TEXT) { };
 
-PrepareResult Statement::prepareStatement(InputBuffer* inputBuffer)
+// Parse an integer key "id" or a composite key "prefix:id"
+static PrepareResult parseKey(Tokenizer& tokens, Key& key, KeyType& keyType)
 {
-    if (inputBuffer->getBuffer().compare(0, 12, "create table", 0, 12) == 0)
+    // Unsigned parsing would silently wrap negative numbers around
+    if (tokens.peekWord() == '-')
     {
-        type = StatementType::STATEMENT_CREATE;
+        return PrepareResult::PREPARE_NEGATIVE_ID;
+    }
+
+    uint64_t _id;
+    if (!tokens.number(_id))
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    if (tokens.peek() != ':')
+    {
+        keyType = KEY_INTEGER;
+        key = { 0, _id };
+        return PrepareResult::PREPARE_SUCCESS;
+    }
+
+    tokens.get();
+    if (tokens.peek() == '-')
+    {
+        return PrepareResult::PREPARE_NEGATIVE_ID;
+    }
+
+    uint64_t _prefix = _id;
+    if (!std::isdigit(tokens.peek()) || !tokens.number(_id))
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    keyType = KEY_COMPOSITE;
+    key = { _prefix, _id };
+    return PrepareResult::PREPARE_SUCCESS;
+}
+
+// Parse an optional "[keyword] [table-name]" naming the table of a statement,
+// leave the tokens as they were if the next word isn't the keyword
+static PrepareResult parseTableName(Tokenizer& tokens, std::string_view keyword,
+                                    std::string& tableName)
+{
+    size_t start = tokens.getPosition();
+    std::string_view _word;
+    if (!tokens.word(_word) || _word != keyword)
+    {
+        tokens.setPosition(start);
+        return PrepareResult::PREPARE_SUCCESS;
+    }
+
+    std::string_view _tableName;
+    if (!tokens.word(_tableName))
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+    tableName = _tableName;
+    return PrepareResult::PREPARE_SUCCESS;
+}
+
+// Copy a string into a column of the row
+static void copyColumn(char* column, std::string_view value)
+{
+    memcpy(column, value.data(), value.size());
+    column[value.size()] = '\0';
+}
+
+PrepareResult Statement::prepareStatement(InputBuffer* inputBuffer)
+{
+    return prepareStatement(inputBuffer->getBuffer());
+}
+
+// Parse a statement once. A "?" in place of a key, a string or the value is a parameter,
+// the statement can be executed many times with values bound to its parameters.
+// Words are parsed in place, only the values kept by the statement are copied.
+// A statement prepared again keeps nothing of the one it held before
+PrepareResult Statement::prepareStatement(std::string_view input)
+{
+    std::ostream* statementOutput = output;
+    *this = Statement();
+    output = statementOutput;
 
-        std::string args = inputBuffer->getBuffer();
-        std::stringstream argStream(args.substr(12, args.size()));
+    if (input.starts_with("create index on"))
+    {
+        type = StatementType::STATEMENT_CREATE_INDEX;
+        Tokenizer tokens(input, 15);
 
-        std::string _tableName;
+        std::string_view _column;
+        std::string_view _rest;
 
-        if (!(argStream >> _tableName))
+        if (!tokens.word(_column) || tokens.word(_rest) ||
+            !parseIndexColumn(_column, whereColumn))
         {
             return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
 
-        this->tableName = _tableName;
-
         return PrepareResult::PREPARE_SUCCESS;
     }
-    else if (inputBuffer->getBuffer().compare(0, 10, "open table", 0, 10) == 0)
+    else if (input.starts_with("create table"))
     {
-        type = StatementType::STATEMENT_OPEN;
-
-        std::string args = inputBuffer->getBuffer();
-        std::stringstream argStream(args.substr(10, args.size()));
+        type = StatementType::STATEMENT_CREATE;
+        Tokenizer tokens(input, 12);
 
-        std::string _tableName;
+        std::string_view _tableName;
+        std::string_view _keyType;
 
-        if (!(argStream >> _tableName))
+        if (!tokens.word(_tableName))
         {
             return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
+        if (_tableName.size() > TABLE_NAME_MAX_SIZE)
+        {
+            return PrepareResult::PREPARE_STRING_TOO_LONG;
+        }
+
+        // Tables use integer keys unless created as composite
+        rowToEdit.keyType = KEY_INTEGER;
+        if (tokens.word(_keyType))
+        {
+            if (_keyType != "composite")
+            {
+                return PrepareResult::PREPARE_SYNTAX_ERROR;
+            }
+            rowToEdit.keyType = KEY_COMPOSITE;
+        }
 
         this->tableName = _tableName;
 
         return PrepareResult::PREPARE_SUCCESS;
     }
-    else if (inputBuffer->getBuffer().compare(0, 10, "drop table", 0, 10) == 0)
+    else if (input.starts_with("open table") || input.starts_with("drop table"))
     {
-        type = StatementType::STATEMENT_DROP;
-
-        std::string args = inputBuffer->getBuffer();
-        std::stringstream argStream(args.substr(10, args.size()));
+        type = input.starts_with("open") ? StatementType::STATEMENT_OPEN : StatementType::STATEMENT_DROP;
+        Tokenizer tokens(input, 10);
 
-        std::string _tableName;
+        std::string_view _tableName;
 
-        if (!(argStream >> _tableName))
+        if (!tokens.word(_tableName))
         {
             return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
@@ -93,25 +271,49 @@ PrepareResult Statement::prepareStatement(InputBuffer* inputBuffer)
 
         return PrepareResult::PREPARE_SUCCESS;
     }
-	else if (inputBuffer->getBuffer().compare(0, 6, "insert", 0, 6) == 0)
+	else if (input.starts_with("insert") || input.starts_with("update"))
 	{
-		type = StatementType::STATEMENT_INSERT;
+        bool inserting = input.starts_with("insert");
+		type = inserting ? StatementType::STATEMENT_INSERT : StatementType::STATEMENT_UPDATE;
+        Tokenizer tokens(input, 6);
 
-		std::string args = inputBuffer->getBuffer();
-		std::stringstream argStream(args.substr(6, args.size()));
+        std::string_view _username;
+        std::string_view _email;
+        std::string_view _value;
 
-        int32_t _id;
-        std::string _username;
-        std::string _email;
+        if (inserting)
+        {
+            if (parseTableName(tokens, "into", tableName) != PrepareResult::PREPARE_SUCCESS)
+            {
+                return PrepareResult::PREPARE_SYNTAX_ERROR;
+            }
+            if (tokens.peekWord() == '(')
+            {
+                return prepareInsertRows(tokens);
+            }
+        }
+        else
+        {
+            // Keys start with a digit or are a parameter, anything else names the table
+            int next = tokens.peekWord();
+            if (next != EOF && next != '-' && next != '?' && !std::isdigit(next))
+            {
+                std::string_view _tableName;
+                tokens.word(_tableName);
+                tableName = _tableName;
+            }
+        }
 
-		if (!(argStream >> _id >> _username >> _email))
+        PrepareResult keyResult = prepareKey(tokens, rowToEdit.key, rowToEdit.keyType,
+                                             ParameterType::PARAMETER_KEY);
+        if (keyResult != PrepareResult::PREPARE_SUCCESS)
+        {
+            return keyResult;
+        }
+		if (!tokens.word(_username) || !tokens.word(_email))
 		{
 			return PrepareResult::PREPARE_SYNTAX_ERROR;
 		}
-        if (_id < 1)
-        {
-            return PrepareResult::PREPARE_NEGATIVE_ID;
-        }
         if (_email.size() > COLUMN_EMAIL_SIZE)
         {
             return PrepareResult::PREPARE_STRING_TOO_LONG;
@@ -121,174 +323,609 @@ PrepareResult Statement::prepareStatement(InputBuffer* inputBuffer)
             return PrepareResult::PREPARE_STRING_TOO_LONG;
         }
 
-        rowToEdit.id = _id;
-        strcpy_s(rowToEdit.email, _email.c_str());
-        strcpy_s(rowToEdit.username, _username.c_str());
+        // Rest of the line is the value, it may contain spaces
+        _value = tokens.rest();
+
+        if (!prepareText(_username, ParameterType::PARAMETER_USERNAME))
+            copyColumn(rowToEdit.username, _username);
+        if (!prepareText(_email, ParameterType::PARAMETER_EMAIL))
+            copyColumn(rowToEdit.email, _email);
+        if (!prepareText(_value, ParameterType::PARAMETER_VALUE))
+            rowToEdit.value = _value;
 
 		return PrepareResult::PREPARE_SUCCESS;
 	}
-    else if (inputBuffer->getBuffer().compare(0, 6, "update", 0, 6) == 0)
+    else if (input.starts_with("delete"))
     {
-        type = StatementType::STATEMENT_UPDATE;
+        type = StatementType::STATEMENT_DELETE;
+        Tokenizer tokens(input, 6);
+
+        if (parseTableName(tokens, "from", tableName) != PrepareResult::PREPARE_SUCCESS)
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+
+        return prepareKey(tokens, rowToEdit.key, rowToEdit.keyType, ParameterType::PARAMETER_KEY);
+    }
 
-        std::string args = inputBuffer->getBuffer();
-        std::stringstream argStream(args.substr(6, args.size()));
+	if (input.starts_with("select"))
+	{
+		type = StatementType::STATEMENT_SELECT;
+        Tokenizer tokens(input, 6);
 
-        int32_t _id;
-        std::string _newUsername;
-        std::string _newEmail;
+        std::string_view _word;
+        tokens.word(_word, ',');
 
-        if (!(argStream >> _id >> _newUsername >> _newEmail))
+        // Count rows instead of printing them
+        if (_word == "count(*)")
+        {
+            counting = true;
+            tokens.word(_word);
+        }
+        else if (prepareColumns(tokens, _word) != PrepareResult::PREPARE_SUCCESS)
         {
             return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
-        if (_id < 1)
+
+        if (_word == "from")
         {
-            return PrepareResult::PREPARE_NEGATIVE_ID;
+            std::string_view _tableName;
+            if (!tokens.word(_tableName))
+            {
+                return PrepareResult::PREPARE_SYNTAX_ERROR;
+            }
+            tableName = _tableName;
+            tokens.word(_word);
         }
-        if (_newEmail.size() > COLUMN_EMAIL_SIZE)
+
+        if (_word == "where")
         {
-            return PrepareResult::PREPARE_STRING_TOO_LONG;
+            return prepareWhere(tokens);
+        }
+		return prepareSelectModifiers(tokens, _word);
+	}
+    else if (input.starts_with("begin") || input.starts_with("commit") || input.starts_with("rollback"))
+    {
+        Tokenizer tokens(input, 0);
+
+        std::string_view _word;
+        std::string_view _rest;
+
+        tokens.word(_word);
+        if (_word == "begin")
+        {
+            type = StatementType::STATEMENT_BEGIN;
         }
-        if (_newUsername.size() > COLUMN_USERNAME_SIZE)
+        else if (_word == "commit")
         {
-            return PrepareResult::PREPARE_STRING_TOO_LONG;
+            type = StatementType::STATEMENT_COMMIT;
+        }
+        else if (_word == "rollback")
+        {
+            type = StatementType::STATEMENT_ROLLBACK;
+        }
+        else
+        {
+            return PrepareResult::PREPARE_UNRECOGNIZED_STATEMENT;
         }
 
-        rowToEdit.id = _id;
-        strcpy_s(rowToEdit.email, _newEmail.c_str());
-        strcpy_s(rowToEdit.username, _newUsername.c_str());
+        if (tokens.word(_rest))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        return PrepareResult::PREPARE_SUCCESS;
+    }
 
+	return PrepareResult::PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+// Parse the columns of a select, or "*" for all of them. The word after them is left in _word
+PrepareResult Statement::prepareColumns(Tokenizer& tokens, std::string_view& _word)
+{
+    RowColumn column;
+    if (_word == "*")
+    {
+        tokens.word(_word);
         return PrepareResult::PREPARE_SUCCESS;
     }
-    else if (inputBuffer->getBuffer().compare(0, 6, "delete", 0, 6) == 0)
+    if (!parseRowColumn(_word, column))
     {
-        type = StatementType::STATEMENT_DELETE;
+        return PrepareResult::PREPARE_SUCCESS;
+    }
+
+    columns.push_back(column);
+    while (tokens.peekWord() == ',')
+    {
+        tokens.get();
+        if (!tokens.word(_word, ',') || !parseRowColumn(_word, column))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        columns.push_back(column);
+    }
+    tokens.word(_word);
+    return PrepareResult::PREPARE_SUCCESS;
+}
+
+// Parse the condition of a select after "where"
+PrepareResult Statement::prepareWhere(Tokenizer& tokens)
+{
+    std::string_view _column;
+    std::string_view _operator;
 
-        std::string args = inputBuffer->getBuffer();
-        std::stringstream argStream(args.substr(6, args.size()));
+    if (!tokens.word(_column) || !tokens.word(_operator))
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    // Seek by primary key
+    if (_column == "id")
+    {
+        return prepareKeyRange(tokens, _operator);
+    }
 
-        int32_t _id;
-        if (!(argStream >> _id))
+    // Filter by a column value, using an index if the column has one, 
+    // or by a pattern of the column value
+    whereLike = (_operator == "like");
+    if (_operator != "=" && !whereLike)
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+    if (parseIndexColumn(_column, whereColumn))
+    {
+        std::string_view _value;
+        if (!tokens.word(_value))
         {
             return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
-        if (_id < 1)
+        if (!prepareText(_value, ParameterType::PARAMETER_WHERE_VALUE))
         {
-            return PrepareResult::PREPARE_NEGATIVE_ID;
+            whereValue = _value;
         }
+        return prepareSelectModifiers(tokens);
+    }
+
+    // Range scan over every key with the given leading component
+    if (_column != "prefix" || whereLike)
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    Key prefix;
+    KeyType prefixType;
+    PrepareResult keyResult = parseKey(tokens, prefix, prefixType);
+    if (keyResult != PrepareResult::PREPARE_SUCCESS)
+    {
+        return keyResult;
+    }
+    if (prefixType != KEY_INTEGER)
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    ranged = true;
+    rowToEdit.keyType = KEY_COMPOSITE;
+    rangeStart = { prefix.id, 0 };
+    rangeEnd = { prefix.id, UINT64_MAX };
 
-        rowToEdit.id = _id;
+    return prepareSelectModifiers(tokens);
+}
 
+// Parse optional "order by id [asc|desc]", "limit N" and "offset M" at the end 
+// of a select. The first word may already be read by the caller
+PrepareResult Statement::prepareSelectModifiers(Tokenizer& tokens, std::string_view _word)
+{
+    if (_word.empty() && !tokens.word(_word))
+    {
         return PrepareResult::PREPARE_SUCCESS;
     }
 
-	if (inputBuffer->getBuffer() == "select")
-	{
-		type = StatementType::STATEMENT_SELECT;
-		return PrepareResult::PREPARE_SUCCESS;
-	}
+    if (_word == "order")
+    {
+        std::string_view _by;
+        std::string_view _column;
+        if (!tokens.word(_by) || !tokens.word(_column) || _by != "by" || _column != "id")
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        if (!tokens.word(_word))
+        {
+            return PrepareResult::PREPARE_SUCCESS;
+        }
+        if (_word == "asc" || _word == "desc")
+        {
+            descending = (_word == "desc");
+            if (!tokens.word(_word))
+            {
+                return PrepareResult::PREPARE_SUCCESS;
+            }
+        }
+    }
 
-	return PrepareResult::PREPARE_UNRECOGNIZED_STATEMENT;
+    if (_word == "limit")
+    {
+        if (tokens.peekWord() == '-' || !tokens.number(limit))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        if (!tokens.word(_word))
+        {
+            return PrepareResult::PREPARE_SUCCESS;
+        }
+    }
+
+    if (_word == "offset")
+    {
+        if (tokens.peekWord() == '-' || !tokens.number(offset))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        if (!tokens.word(_word))
+        {
+            return PrepareResult::PREPARE_SUCCESS;
+        }
+    }
+
+    return PrepareResult::PREPARE_SYNTAX_ERROR;
 }
 
-// Change cached table to the new one if created successfully,
-// don't change chached table if an error occured
-ExecuteResult Statement::executeCreate(std::shared_ptr<Table>& table)
+// Parse the rows of "insert (key username email [value]), (...), ...".
+// The value of a row ends at its closing bracket
+PrepareResult Statement::prepareInsertRows(Tokenizer& tokens)
 {
-    std::shared_ptr<Table> _table;
-    try
+    while (true)
     {
-        _table = std::move(createDatabase(tableName + ".db"));
+        if (tokens.peekWord() != '(')
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        tokens.get();
+
+        Row& row = rows.emplace_back();
+        PrepareResult keyResult = parseKey(tokens, row.key, row.keyType);
+        if (keyResult != PrepareResult::PREPARE_SUCCESS)
+        {
+            return keyResult;
+        }
+
+        std::string_view _username;
+        std::string_view _email;
+        if (!tokens.word(_username, ')') || !tokens.word(_email, ')'))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        if (_email.size() > COLUMN_EMAIL_SIZE)
+        {
+            return PrepareResult::PREPARE_STRING_TOO_LONG;
+        }
+        if (_username.size() > COLUMN_USERNAME_SIZE)
+        {
+            return PrepareResult::PREPARE_STRING_TOO_LONG;
+        }
+        copyColumn(row.username, _username);
+        copyColumn(row.email, _email);
+        row.value = tokens.until(')');
+
+        if (tokens.peek() != ')')
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        tokens.get();
+
+        // Rows are separated by commas
+        int next = tokens.peekWord();
+        if (next == EOF)
+        {
+            return PrepareResult::PREPARE_SUCCESS;
+        }
+        if (next != ',')
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        tokens.get();
     }
-    catch (...)
+}
+
+// Parse "= key", "between key and key", "> key", ">= key", "< key" or "<= key"
+// into an inclusive range of keys
+PrepareResult Statement::prepareKeyRange(Tokenizer& tokens, std::string_view _operator)
+{
+    ranged = true;
+    keyOperator = _operator;
+    if (_operator != "=" && _operator != "between" && _operator != ">=" && _operator != "<=" &&
+        _operator != ">" && _operator != "<")
+    {
+        return PrepareResult::PREPARE_SYNTAX_ERROR;
+    }
+
+    PrepareResult keyResult = prepareKey(tokens, rowToEdit.key, rowToEdit.keyType,
+                                         ParameterType::PARAMETER_KEY);
+    if (keyResult != PrepareResult::PREPARE_SUCCESS)
+    {
+        return keyResult;
+    }
+
+    betweenEndType = rowToEdit.keyType;
+    if (_operator == "between")
     {
-        if (GetLastError() == ERROR_FILE_EXISTS)
+        std::string_view _and;
+        if (!tokens.word(_and) || _and != "and")
         {
-            return ExecuteResult::EXECUTE_ERROR_FILE_EXISTS;
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
-        else
+        keyResult = prepareKey(tokens, betweenEnd, betweenEndType,
+                               ParameterType::PARAMETER_BETWEEN_END);
+        if (keyResult != PrepareResult::PREPARE_SUCCESS)
         {
-            return ExecuteResult::EXECUTE_ERROR_WHILE_CREATING;
+            return keyResult;
+        }
+        if (parameters.empty() && betweenEndType != rowToEdit.keyType)
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
         }
     }
 
-    // New table created successfully
-    if (table != nullptr)
-        saveAndCloseDatabase(table);
-    table = _table;
+    setKeyRange();
+    return prepareSelectModifiers(tokens);
+}
 
-    return ExecuteResult::EXECUTE_SUCCESS;
+// Set the range of keys to select from the operator and its keys,
+// again every time a key parameter is bound
+void Statement::setKeyRange()
+{
+    const Key& key = rowToEdit.key;
+    rangeStart = MIN_KEY;
+    rangeEnd = maxKey(rowToEdit.keyType);
+
+    if (keyOperator == "=")
+    {
+        rangeStart = key;
+        rangeEnd = key;
+    }
+    else if (keyOperator == "between")
+    {
+        rangeStart = key;
+        rangeEnd = betweenEnd;
+    }
+    else if (keyOperator == ">=")
+    {
+        rangeStart = key;
+    }
+    else if (keyOperator == "<=")
+    {
+        rangeEnd = key;
+    }
+    else if (keyOperator == ">")
+    {
+        rangeStart = key;
+        if (!nextKey(rowToEdit.keyType, rangeStart))
+        {
+            // Nothing is greater than the largest key
+            rangeStart = rangeEnd;
+            rangeEnd = MIN_KEY;
+        }
+    }
+    else if (keyOperator == "<")
+    {
+        rangeEnd = key;
+        if (!previousKey(rowToEdit.keyType, rangeEnd))
+        {
+            // Nothing is less than the smallest key
+            rangeStart = maxKey(rowToEdit.keyType);
+        }
+    }
 }
 
-// Change cached table to the new one if opened successfully,
-// don't change chached table if an error occured
-ExecuteResult Statement::executeOpen(std::shared_ptr<Table>& table)
+// Parse a key, or a "?" parameter that stands for one
+PrepareResult Statement::prepareKey(Tokenizer& tokens, Key& key, KeyType& keyType,
+                                    ParameterType parameterType)
 {
-    std::shared_ptr<Table> _table;
-    try
+    if (tokens.peekWord() == '?')
     {
-        _table = std::move(openDatabase(tableName + ".db"));
+        tokens.get();
+        int next = tokens.peek();
+        if (next != EOF && !std::isspace(next))
+        {
+            return PrepareResult::PREPARE_SYNTAX_ERROR;
+        }
+        parameters.push_back({ parameterType, false });
+        return PrepareResult::PREPARE_SUCCESS;
     }
-    catch (...)
+    return parseKey(tokens, key, keyType);
+}
+
+// Return true if a string argument is a "?" parameter
+bool Statement::prepareText(std::string_view text, ParameterType parameterType)
+{
+    if (text != "?")
+    {
+        return false;
+    }
+    parameters.push_back({ parameterType, false });
+    return true;
+}
+
+uint32_t Statement::getParameterCount() const
+{
+    return static_cast<uint32_t>(parameters.size());
+}
+
+// Bind a key to a parameter, parameters are numbered from 1 like in SQLite.
+// Bound values stay until they are bound again
+PrepareResult Statement::bindKey(uint32_t index, const Key& key, KeyType keyType)
+{
+    if (index == 0 || index > parameters.size())
+    {
+        return PrepareResult::PREPARE_PARAMETER_MISMATCH;
+    }
+
+    Parameter& parameter = parameters[index - 1];
+    if (parameter.type == ParameterType::PARAMETER_KEY)
+    {
+        rowToEdit.key = key;
+        rowToEdit.keyType = keyType;
+    }
+    else if (parameter.type == ParameterType::PARAMETER_BETWEEN_END)
+    {
+        betweenEnd = key;
+        betweenEndType = keyType;
+    }
+    else
     {
-        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        return PrepareResult::PREPARE_PARAMETER_MISMATCH;
+    }
+
+    parameter.bound = true;
+    if (ranged)
+    {
+        setKeyRange();
+    }
+    return PrepareResult::PREPARE_SUCCESS;
+}
+
+// Bind a string to a parameter of a column, the value or a where condition
+PrepareResult Statement::bindText(uint32_t index, const std::string& text)
+{
+    if (index == 0 || index > parameters.size())
+    {
+        return PrepareResult::PREPARE_PARAMETER_MISMATCH;
+    }
+
+    Parameter& parameter = parameters[index - 1];
+    switch (parameter.type)
+    {
+    case (ParameterType::PARAMETER_USERNAME):
+        if (text.size() > COLUMN_USERNAME_SIZE)
         {
-            return ExecuteResult::EXECUTE_ERROR_FILE_NOT_FOUND;
+            return PrepareResult::PREPARE_STRING_TOO_LONG;
         }
-        else
+        strcpy_s(rowToEdit.username, text.c_str());
+        break;
+    case (ParameterType::PARAMETER_EMAIL):
+        if (text.size() > COLUMN_EMAIL_SIZE)
         {
-            return ExecuteResult::EXECUTE_ERROR_WHILE_OPENING;
+            return PrepareResult::PREPARE_STRING_TOO_LONG;
         }
+        strcpy_s(rowToEdit.email, text.c_str());
+        break;
+    case (ParameterType::PARAMETER_VALUE):
+        rowToEdit.value = text;
+        break;
+    case (ParameterType::PARAMETER_WHERE_VALUE):
+        whereValue = text;
+        break;
+    default:
+        return PrepareResult::PREPARE_PARAMETER_MISMATCH;
+    }
+
+    parameter.bound = true;
+    return PrepareResult::PREPARE_SUCCESS;
+}
+
+// Open the new table if created successfully,
+// don't change the opened table if an error occured
+ExecuteResult Statement::executeCreate(TableCache& tables)
+{
+    std::shared_ptr<Table> _table;
+    try
+    {
+        _table = createTable(tables.getCatalog(), tableName, rowToEdit.keyType);
+    }
+    catch (...)
+    {
+        return ExecuteResult::EXECUTE_ERROR_WHILE_CREATING;
+    }
+
+    if (_table == nullptr)
+    {
+        return ExecuteResult::EXECUTE_TABLE_EXISTS;
     }
 
-    // New table opened successfully
-    if (table != nullptr)
-        saveAndCloseDatabase(table);
-    table = _table;
+    // New table created successfully, other tables stay open
+    tables.add(_table);
+    tables.setCurrent(tableName);
 
     return ExecuteResult::EXECUTE_SUCCESS;
 }
 
-ExecuteResult Statement::executeDrop(std::shared_ptr<Table>& table)
+// Make the table the opened one if opened successfully,
+// don't change the opened table if an error occured
+ExecuteResult Statement::executeOpen(TableCache& tables)
+{
+    std::shared_ptr<Table> _table;
+    ExecuteResult result = getNamedTable(tables, _table);
+    if (result == ExecuteResult::EXECUTE_SUCCESS)
+    {
+        tables.setCurrent(tableName);
+    }
+    return result;
+}
+
+// Get the table named by the statement from the cache, it's opened if it isn't open yet
+ExecuteResult Statement::getNamedTable(TableCache& tables, std::shared_ptr<Table>& table)
 {
-    this->attempts++;
     try
     {
-        dropDatabase(tableName + ".db");
+        table = tables.get(tableName);
     }
     catch (...)
     {
-        if (GetLastError() == ERROR_FILE_NOT_FOUND)
-        {
-            return ExecuteResult::EXECUTE_ERROR_FILE_NOT_FOUND;
-        }
-        // SHARING_VIOLATION happens when file can't be accessed
-        // because it's currently opened
-        else if (GetLastError() == ERROR_SHARING_VIOLATION)
-        {
-            // Close file first
-            CloseHandle(table->pager->getFileHandle());
+        return ExecuteResult::EXECUTE_ERROR_WHILE_OPENING;
+    }
 
-            // Check the attempt count to avoid infinite loop
-            if (this->attempts > 2)
-                throw std::runtime_error("Failed to access the file.");
+    if (table == nullptr)
+    {
+        return ExecuteResult::EXECUTE_TABLE_NOT_FOUND;
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
 
-            // Free cached table before closing
-            freeTable(table);
+// Build an index on a column of the opened table
+ExecuteResult Statement::executeCreateIndex(std::shared_ptr<Table>& table)
+{
+    if (table == nullptr)
+    {
+        return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
+    }
 
-            // Try again
-            executeDrop(table);
+    // Index keys only have room for an integer primary key
+    if (table->keyType != KEY_INTEGER)
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
 
-            // Assign cached table to nullptr
-            table = nullptr;
+    try
+    {
+        if (!createIndex(table, whereColumn))
+        {
+            return ExecuteResult::EXECUTE_INDEX_EXISTS;
         }
-        else
+    }
+    catch (...)
+    {
+        return ExecuteResult::EXECUTE_ERROR_WHILE_CREATING;
+    }
+
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+// Free the pages of the table and its indexes inside the database file.
+// The table stays open if it wasn't dropped
+ExecuteResult Statement::executeDrop(TableCache& tables)
+{
+    try
+    {
+        if (!dropTable(tables.getCatalog(), tableName))
         {
-            return ExecuteResult::EXECUTE_ERROR_WHILE_DROPPING;
+            return ExecuteResult::EXECUTE_TABLE_NOT_FOUND;
         }
     }
+    catch (...)
+    {
+        return ExecuteResult::EXECUTE_ERROR_WHILE_DROPPING;
+    }
 
+    tables.close(tableName);
     return ExecuteResult::EXECUTE_SUCCESS;
 }
 
@@ -299,20 +936,32 @@ ExecuteResult Statement::executeUpdate(std::shared_ptr<Table>& table)
         return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
     }
 
+    if (rowToEdit.keyType != table->keyType)
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
+
     // Point cursor at the position of the key to update 
-	uint32_t keyToUpdate = this->rowToEdit.id;
+    TableWriter writer(table);
+	const Key& keyToUpdate = this->rowToEdit.key;
     std::unique_ptr<Cursor> cursor = tableFindKey(table, keyToUpdate);
 
-    // Check if key exists
-    void* node = table->pager->getPage(cursor->pageNumber);
+    // Check if key exists and wasn't marked as deleted
+    void* node = table->pager->readPage(cursor->pageNumber);
     uint32_t cellCount = *leafGetCellCount(node);
     if (cursor->cellCount < cellCount)
     {
-        uint32_t keyAtIndex = *leafGetKey(node, cursor->cellCount);
-        if (keyAtIndex == keyToUpdate)
+        Key keyAtIndex = leafGetKey(node, cursor->cellCount);
+        if (keyAtIndex == keyToUpdate && !isRowDeleted(cursorValue(cursor)))
         {
+            // Index entries of the old values are replaced
+            Row oldRow;
+            deserializeRow(cursorValue(cursor), &oldRow);
+            indexDeleteRow(table, &oldRow);
+
             // Update key with new values
             leafUpdate(cursor, &rowToEdit);
+            indexInsertRow(table, &rowToEdit);
             
             return ExecuteResult::EXECUTE_SUCCESS;
         }
@@ -328,38 +977,103 @@ ExecuteResult Statement::executeInsert(std::shared_ptr<Table>& table)
         return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
     }
 
+    if (!rows.empty())
+    {
+        return executeInsertRows(table);
+    }
+
+    return insertRow(table, &rowToEdit);
+}
+
+// Insert one row with its index entries, a deleted row with the same key is overwritten
+ExecuteResult insertRow(std::shared_ptr<Table>& table, Row* row)
+{
+    if (row->keyType != table->keyType)
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
+
     // Point cursor at the position for a new key 
-	uint32_t keyToInsert = this->rowToEdit.id;
+    TableWriter writer(table);
+	const Key& keyToInsert = row->key;
     std::unique_ptr<Cursor> cursor = tableFindKey(table, keyToInsert);
 
     // Check if key already exists
-    void* node = table->pager->getPage(cursor->pageNumber);
+    void* node = table->pager->readPage(cursor->pageNumber);
     uint32_t cellCount = *leafGetCellCount(node);
     if (cursor->cellCount < cellCount)
     {
-        uint32_t keyAtIndex = *leafGetKey(node, cursor->cellCount);
+        Key keyAtIndex = leafGetKey(node, cursor->cellCount);
         if (keyAtIndex == keyToInsert)
         {
             // Check if key was marked as deleted
-            Row rowAtIndex;
-            deserializeRow(cursorValue(cursor), &rowAtIndex);
-            if (rowAtIndex.id != 0)
+            if (!isRowDeleted(cursorValue(cursor)))
             {
                 return ExecuteResult::EXECUTE_DUPLICATE_KEY;
             }
             else
             {
                 // Overwrite deleted key
-                leafUpdate(cursor, &rowToEdit);
+                leafUpdate(cursor, row);
+                indexInsertRow(table, row);
                 return ExecuteResult::EXECUTE_SUCCESS;
             }
         }
     }
 
-	leafInsert(cursor, this->rowToEdit.id, &rowToEdit);
+	leafInsert(cursor, row);
+    indexInsertRow(table, row);
 	return ExecuteResult::EXECUTE_SUCCESS;
 }
 
+// Insert the rows of a multi-row insert
+ExecuteResult Statement::executeInsertRows(std::shared_ptr<Table>& table)
+{
+    std::vector<Row*> batch;
+    batch.reserve(rows.size());
+    for (Row& row : rows)
+    {
+        batch.push_back(&row);
+    }
+    return insertRows(table, batch);
+}
+
+// Insert a batch of rows with their index entries. Rows are sorted by key, so the rows 
+// that land in the same leaf are inserted together. If a key is taken, nothing is inserted
+ExecuteResult insertRows(std::shared_ptr<Table>& table, std::vector<Row*>& rows)
+{
+    for (Row* row : rows)
+    {
+        if (row->keyType != table->keyType)
+        {
+            return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+        }
+    }
+
+    std::sort(rows.begin(), rows.end(),
+              [](const Row* lhs, const Row* rhs) { return lhs->key < rhs->key; });
+    for (size_t i = 1; i < rows.size(); i++)
+    {
+        if (rows[i - 1]->key == rows[i]->key)
+        {
+            return ExecuteResult::EXECUTE_DUPLICATE_KEY;
+        }
+    }
+
+    TableWriter writer(table);
+    if (tableHasAnyKey(table, rows))
+    {
+        return ExecuteResult::EXECUTE_DUPLICATE_KEY;
+    }
+
+    tableInsertRows(table, rows);
+    for (Row* row : rows)
+    {
+        indexInsertRow(table, row);
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
 ExecuteResult Statement::executeDelete(std::shared_ptr<Table>& table)
 {
     if (table == nullptr)
@@ -367,28 +1081,35 @@ ExecuteResult Statement::executeDelete(std::shared_ptr<Table>& table)
         return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
     }
 
+    if (rowToEdit.keyType != table->keyType)
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
+
     // Point cursor at the position of the key to delete
-    uint32_t keyToDelete = this->rowToEdit.id;
+    TableWriter writer(table);
+    const Key& keyToDelete = this->rowToEdit.key;
     std::unique_ptr<Cursor> cursor = tableFindKey(table, keyToDelete);
 
     // Check if key exists
-    void* node = table->pager->getPage(cursor->pageNumber);
+    void* node = table->pager->readPage(cursor->pageNumber);
     uint32_t cellCount = *leafGetCellCount(node);
     if (cursor->cellCount < cellCount)
     {
-        uint32_t keyAtIndex = *leafGetKey(node, cursor->cellCount);
+        Key keyAtIndex = leafGetKey(node, cursor->cellCount);
         if (keyAtIndex == keyToDelete)
         {
             // Check if key was marked as deleted
-            Row rowAtIndex;
-            deserializeRow(cursorValue(cursor), &rowAtIndex);
-            if (rowAtIndex.id == 0)
+            if (isRowDeleted(cursorValue(cursor)))
             {
                 return ExecuteResult::EXECUTE_KEY_DOES_NOT_EXIST;
             }
             else
             {
                 // Delete key
+                Row oldRow;
+                deserializeRow(cursorValue(cursor), &oldRow);
+                indexDeleteRow(table, &oldRow);
                 leafDelete(cursor);
                 return ExecuteResult::EXECUTE_SUCCESS;
             }
@@ -405,21 +1126,273 @@ ExecuteResult Statement::executeSelect(std::shared_ptr<Table>& table)
         return ExecuteResult::EXECUTE_TABLE_NOT_SELECTED;
     }
 
-    std::unique_ptr<Cursor> cursor = tableStart(table);
+    // Every read of the statement sees the tables as they were when it started,
+    // writers committing meanwhile don't change its result and don't wait for it
+    Snapshot snapshot;
 
-	Row row;
-	while (!(cursor->endOfTable))
-	{
-		deserializeRow(cursorValue(cursor), &row);
-		printRow(&row);
-        (*cursor)++; // move by one position
-	}
+    if (whereColumn != INDEX_COUNT)
+    {
+        return executeSelectWhere(table);
+    }
+
+    if (ranged && (rowToEdit.keyType != table->keyType ||
+                   (keyOperator == "between" && betweenEndType != table->keyType)))
+    {
+        return ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH;
+    }
+
+    // Internal nodes keep the number of live rows under each child, so counts 
+    // and offsets are answered by one descent instead of a scan
+    uint64_t first = ranged ? tableCountLess(table, rangeStart) : 0;
+    uint64_t count = ranged ? tableCountRange(table, rangeStart, rangeEnd) : tableCount(table);
+    if (counting)
+    {
+        printCount(std::min(count > offset ? count - offset : 0, limit));
+        return ExecuteResult::EXECUTE_SUCCESS;
+    }
+    if (count <= offset)
+    {
+        return ExecuteResult::EXECUTE_SUCCESS;
+    }
+
+    // Leaves are chained in both directions in key order, so a range is a seek 
+    // to one end followed by a scan that stops at the first key past the other end
+    std::unique_ptr<Cursor> cursor;
+    if (offset > 0)
+        cursor = tableSeekRank(table, descending ? first + count - 1 - offset : first + offset);
+    else if (descending)
+        cursor = ranged ? tableSeekLast(table, rangeEnd) : tableEnd(table);
+    else
+        cursor = ranged ? tableSeek(table, rangeStart) : tableStart(table);
+
+    ScanOperator scan(std::move(cursor), descending);
+    if (ranged)
+    {
+        scan.setEnd(descending ? rangeStart : rangeEnd, true);
+    }
+    LimitOperator limited(scan, 0, limit);
+    printRows(limited, *output, table->pager, columns, outputFormat);
 
 	return ExecuteResult::EXECUTE_SUCCESS;
 }
 
-ExecuteResult Statement::executeStatement(std::shared_ptr<Table>& table)
+// Select rows by a column value. Look up the index of the column if it has one,
+// otherwise compare the column of every row in place in its page.
+// Patterns are always matched by a scan
+ExecuteResult Statement::executeSelectWhere(std::shared_ptr<Table>& table)
+{
+    std::shared_ptr<Table>& index = table->indexes[whereColumn];
+    if (index != nullptr && !whereLike)
+    {
+        // Entries are read in the order of the select and only as many as the offset
+        // and the limit need, so the lookup stops early
+        uint64_t maxKeys = offset < UINT64_MAX - limit ? offset + limit : UINT64_MAX;
+        std::vector<Key> keys = indexLookup(index, whereColumn, whereValue, descending, maxKeys);
+        if (counting)
+        {
+            uint64_t count = keys.size();
+            printCount(count > offset ? count - offset : 0);
+            return ExecuteResult::EXECUTE_SUCCESS;
+        }
+
+        for (uint64_t i = std::min<uint64_t>(offset, keys.size()); i < keys.size(); i++)
+        {
+            const Key& key = keys[i];
+            std::unique_ptr<Cursor> cursor = tableFindKey(table, key);
+            if (outputFormat == OUTPUT_BINARY)
+            {
+                writeSerializedRow(*output, table->pager, cursorValue(cursor), columns);
+            }
+            else
+            {
+                printSerializedRow(*output, table->pager, cursorValue(cursor), columns);
+            }
+        }
+        return ExecuteResult::EXECUTE_SUCCESS;
+    }
+
+    // Large tables are split between threads when the result doesn't depend on
+    // the order rows are found in. A transaction's own changes are only visible to its thread
+    if ((counting || (!descending && limit == UINT64_MAX && offset == 0)) && 
+        !table->pager->inTransaction())
+    {
+        uint32_t threadCount = std::min(std::thread::hardware_concurrency(), PARALLEL_SCAN_MAX_THREADS);
+        if (threadCount > 1 && tableCount(table) >= PARALLEL_SCAN_MIN_ROWS)
+        {
+            return executeSelectWhereParallel(table, threadCount);
+        }
+    }
+
+    ScanOperator scan(descending ? tableEnd(table) : tableStart(table), descending);
+    FilterOperator filter(scan, whereColumn, whereValue, whereLike);
+    LimitOperator limited(filter, offset, limit);
+    if (counting)
+    {
+        printCount(countRows(limited));
+    }
+    else
+    {
+        printRows(limited, *output, table->pager, columns, outputFormat);
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+// Scan a where condition on several threads of the worker pool. The table is split
+// into key ranges of about the same number of rows, and every thread takes the next range
+// until none is left. Rows of a range are printed as soon as every range before it is,
+// and a thread doesn't start a range too far ahead of the printed ones, so only a few
+// ranges are held in memory. Every thread reads the snapshot of the statement
+ExecuteResult Statement::executeSelectWhereParallel(std::shared_ptr<Table>& table, uint32_t threadCount)
 {
+    Snapshot snapshot;
+    uint64_t version = Snapshot::getVersion();
+
+    std::vector<Key> splitKeys = tableSplitKeys(table, threadCount * PARALLEL_SCAN_RANGES_PER_THREAD);
+    size_t rangeCount = splitKeys.size() + 1;
+    size_t window = counting ? rangeCount : threadCount * PARALLEL_SCAN_BUFFERED_RANGES_PER_THREAD;
+    std::vector<std::ostringstream> outputs(rangeCount);
+    std::vector<bool> finished(rangeCount, false);
+    std::vector<uint64_t> counts(rangeCount, 0);
+    size_t nextRange = 0;
+    size_t printedRanges = 0;
+    bool failed = false;
+    std::mutex rangeMutex;
+    std::condition_variable printed;
+
+    auto scanRanges = [&]()
+    {
+        Snapshot threadSnapshot(version);
+        while (true)
+        {
+            size_t range;
+            {
+                std::unique_lock<std::mutex> lock(rangeMutex);
+                printed.wait(lock, [&]() { 
+                    return failed || nextRange == rangeCount || nextRange < printedRanges + window; 
+                });
+                if (failed || nextRange == rangeCount)
+                {
+                    return;
+                }
+                range = nextRange++;
+            }
+
+            try
+            {
+                ScanOperator scan(range == 0 ? tableStart(table) : tableSeek(table, splitKeys[range - 1]), false);
+                if (range < splitKeys.size())
+                {
+                    scan.setEnd(splitKeys[range], false);
+                }
+                FilterOperator filter(scan, whereColumn, whereValue, whereLike);
+                if (counting)
+                {
+                    counts[range] = countRows(filter);
+                }
+                else
+                {
+                    printRows(filter, outputs[range], table->pager, columns, outputFormat);
+                }
+            }
+            catch (...)
+            {
+                // Threads waiting for this range to be printed stop
+                {
+                    std::lock_guard<std::mutex> lock(rangeMutex);
+                    failed = true;
+                }
+                printed.notify_all();
+                throw;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(rangeMutex);
+                finished[range] = true;
+                while (printedRanges < rangeCount && finished[printedRanges])
+                {
+                    *output << outputs[printedRanges].view();
+                    outputs[printedRanges] = std::ostringstream();
+                    printedRanges++;
+                }
+            }
+            printed.notify_all();
+        }
+    };
+
+    // Errors of reading the file are raised again on the calling thread
+    WorkerPool::instance().run(threadCount, scanRanges);
+
+    if (counting)
+    {
+        uint64_t count = 0;
+        for (uint64_t rangeRows : counts)
+        {
+            count += rangeRows;
+        }
+        printCount(std::min(count > offset ? count - offset : 0, limit));
+    }
+    return ExecuteResult::EXECUTE_SUCCESS;
+}
+
+// A count is a line of text, or 8 bytes in the binary format
+void Statement::printCount(uint64_t count)
+{
+    if (outputFormat == OUTPUT_BINARY)
+    {
+        output->write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    else
+    {
+        *output << count << std::endl;
+    }
+}
+
+// Rows and counts that a select prints go to the output
+ExecuteResult Statement::executeStatement(TableCache& tables, std::ostream& output, OutputFormat format)
+{
+    this->output = &output;
+    outputFormat = format;
+    switch (type)
+    {
+    case(StatementType::STATEMENT_CREATE):
+        return executeCreate(tables);
+    case(StatementType::STATEMENT_OPEN):
+        return executeOpen(tables);
+    case(StatementType::STATEMENT_DROP):
+        return executeDrop(tables);
+    case(StatementType::STATEMENT_BEGIN):
+        return tables.begin() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_TRANSACTION_OPEN;
+    case(StatementType::STATEMENT_COMMIT):
+        return tables.commit() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_NO_TRANSACTION;
+    case(StatementType::STATEMENT_ROLLBACK):
+        return tables.rollback() ? ExecuteResult::EXECUTE_SUCCESS : ExecuteResult::EXECUTE_NO_TRANSACTION;
+    default:
+        break;
+    }
+
+    for (const Parameter& parameter : parameters)
+    {
+        if (!parameter.bound)
+        {
+            return ExecuteResult::EXECUTE_PARAMETER_NOT_BOUND;
+        }
+    }
+
+    // Statements run on the table they name, or on the opened table
+    std::shared_ptr<Table> table;
+    if (tableName.empty())
+    {
+        table = tables.current();
+    }
+    else
+    {
+        ExecuteResult result = getNamedTable(tables, table);
+        if (result != ExecuteResult::EXECUTE_SUCCESS)
+        {
+            return result;
+        }
+    }
+
 	switch (type)
 	{
     case (StatementType::STATEMENT_INSERT):
@@ -430,12 +1403,8 @@ ExecuteResult Statement::executeStatement(std::shared_ptr<Table>& table)
         return executeDelete(table);
 	case (StatementType::STATEMENT_SELECT):
 		return executeSelect(table);
-    case(StatementType::STATEMENT_CREATE):
-        return executeCreate(table);
-    case(StatementType::STATEMENT_OPEN):
-        return executeOpen(table);
-    case(StatementType::STATEMENT_DROP):
-        return executeDrop(table);
+    case(StatementType::STATEMENT_CREATE_INDEX):
+        return executeCreateIndex(table);
     default:
         throw std::exception("Unknown statement.");
 	}
@@ -446,6 +1415,16 @@ const StatementType Statement::getStatement() const
 	return this->type;
 }
 
+bool Statement::isCounting() const
+{
+    return counting;
+}
+
+const std::vector<RowColumn>& Statement::getColumns() const
+{
+    return columns;
+}
+
 const Row Statement::getRow() const
 {
 	return this->rowToEdit;
@@ -461,10 +1440,10 @@ const std::string Statement::getTableName() const
 void printConstants()
 {
     std::cout << "Constants:" << std::endl;
-    std::cout << "ROW_SIZE: " << ROW_SIZE << std::endl;
+    std::cout << "ROW_MAX_SIZE: " << ROW_MAX_SIZE << std::endl;
     std::cout << "COMMON_NODE_HEADER_SIZE: " << COMMON_NODE_HEADER_SIZE << std::endl;
     std::cout << "LEAF_NODE_HEADER_SIZE: " << LEAF_NODE_HEADER_SIZE << std::endl;
-    std::cout << "LEAF_NODE_CELL_SIZE: " << LEAF_NODE_CELL_SIZE << std::endl;
+    std::cout << "LEAF_NODE_MAX_CELL_SIZE: " << LEAF_NODE_MAX_CELL_SIZE << std::endl;
     std::cout << "LEAF_NODE_SPACE_FOR_CELLS: " << LEAF_NODE_SPACE_FOR_CELLS << std::endl;
     std::cout << "LEAF_NODE_MAX_CELLS: " << LEAF_NODE_MAX_CELLS << std::endl;
 }
@@ -478,8 +1457,8 @@ void indent(uint32_t level)
     }
 }
 
-void printTree(const std::unique_ptr<Pager>& pager, uint32_t pageNumber, uint32_t indentation_level) {
-    void* node = pager->getPage(pageNumber);
+void printTree(const std::shared_ptr<Pager>& pager, uint32_t pageNumber, uint32_t indentation_level) {
+    void* node = pager->readPage(pageNumber);
     uint32_t keyCount, child;
 
     switch (nodeGetType(node)) 
@@ -492,12 +1471,10 @@ void printTree(const std::unique_ptr<Pager>& pager, uint32_t pageNumber, uint32_
             {
                 indent(indentation_level + 1);
                 // Check if key is marked as deleted
-                Row currentRow;
-                deserializeRow(leafGetValue(node, i), &currentRow);
-                if (currentRow.id == 0) // key is marked as deleted
-                    std::cout << "- " << *leafGetKey(node, i) << "*" << "\n";
+                if (isRowDeleted(leafGetValue(node, i)))
+                    std::cout << "- " << keyToString(leafGetKey(node, i), nodeGetKeyType(node)) << "*" << "\n";
                 else
-                    std::cout << "- " << *leafGetKey(node, i) << "\n";
+                    std::cout << "- " << keyToString(leafGetKey(node, i), nodeGetKeyType(node)) << "\n";
             }
             break;
         case (NODE_INTERNAL):
@@ -512,7 +1489,7 @@ void printTree(const std::unique_ptr<Pager>& pager, uint32_t pageNumber, uint32_
                     printTree(pager, child, indentation_level + 1);
 
                     indent(indentation_level + 1);
-                    std::cout << "- key " << *internalGetKey(node, i) << "\n";
+                    std::cout << "- key " << keyToString(internalGetKey(node, i), nodeGetKeyType(node)) << "\n";
                 }
                 child = *internalGetRightChild(node);
                 printTree(pager, child, indentation_level + 1);
@@ -0,0 +1,151 @@
+#include "../includes/tablecache.h"
+
+TableCache::TableCache(const std::string& filename, uint32_t maxTables, uint32_t maxPages) :
+    filename(filename), catalog(nullptr), currentName(""), maxTables(maxTables), maxPages(maxPages) { }
+
+// Catalog of the database file, the file is opened or created on first use
+std::shared_ptr<Table>& TableCache::getCatalog()
+{
+    if (catalog == nullptr)
+    {
+        catalog = openDatabase(filename);
+        catalog->pager->setCacheLimit(maxPages);
+    }
+    return catalog;
+}
+
+// Return an open table and mark it as the most recently used one, open it
+// with its indexes if it isn't open. Return nullptr if the file has no such table
+std::shared_ptr<Table> TableCache::get(const std::string& name)
+{
+    auto found = tablesByName.find(name);
+    if (found != tablesByName.end())
+    {
+        tables.splice(tables.begin(), tables, found->second);
+        evict();
+        return tables.front();
+    }
+
+    std::shared_ptr<Table> table = openTable(getCatalog(), name);
+    if (table != nullptr)
+    {
+        add(table);
+    }
+    return table;
+}
+
+// Table used by statements that don't name one, nullptr if none was opened
+std::shared_ptr<Table> TableCache::current()
+{
+    if (currentName.empty())
+    {
+        return nullptr;
+    }
+    return get(currentName);
+}
+
+void TableCache::setCurrent(const std::string& name)
+{
+    currentName = name;
+}
+
+const std::string& TableCache::getCurrentName() const
+{
+    return currentName;
+}
+
+// Start caching a table that was just opened or created
+void TableCache::add(const std::shared_ptr<Table>& table)
+{
+    tables.push_front(table);
+    tablesByName[table->name] = tables.begin();
+    evict();
+}
+
+// Start a transaction, false if one is open already
+bool TableCache::begin()
+{
+    return getCatalog()->pager->beginTransaction();
+}
+
+// Commit the open transaction and write its pages to the file, false if none is open
+bool TableCache::commit()
+{
+    return getCatalog()->pager->commitTransaction();
+}
+
+// Undo the open transaction, false if none is open. Tables created, dropped or 
+// indexed in it may have changed, so every handle is opened again on next use
+bool TableCache::rollback()
+{
+    if (!getCatalog()->pager->rollbackTransaction())
+    {
+        return false;
+    }
+
+    tables.clear();
+    tablesByName.clear();
+    return true;
+}
+
+// True if this thread has a transaction open
+bool TableCache::inTransaction()
+{
+    return catalog != nullptr && catalog->pager->inTransaction();
+}
+
+bool TableCache::isOpen(const std::string& name) const
+{
+    return tablesByName.count(name) > 0;
+}
+
+uint32_t TableCache::getCachedPageCount()
+{
+    return catalog == nullptr ? 0 : catalog->pager->getCachedPageCount();
+}
+
+// Drop handles of the least recently used tables, closing them costs nothing
+// since their pages belong to the file. The pager keeps its pages within the budget
+void TableCache::evict()
+{
+    while (tables.size() > maxTables)
+    {
+        tablesByName.erase(tables.back()->name);
+        tables.pop_back();
+    }
+}
+
+// Forget a table that was dropped
+void TableCache::close(const std::string& name)
+{
+    auto found = tablesByName.find(name);
+    if (found != tablesByName.end())
+    {
+        tables.erase(found->second);
+        tablesByName.erase(found);
+    }
+    if (currentName == name)
+    {
+        currentName.clear();
+    }
+}
+
+// Save and close the database file with every table in it. 
+// A transaction that wasn't committed is rolled back
+void TableCache::closeAll()
+{
+    if (catalog != nullptr)
+    {
+        catalog->pager->rollbackTransaction();
+    }
+
+    tables.clear();
+    tablesByName.clear();
+    currentName.clear();
+
+    if (catalog != nullptr)
+    {
+        saveAndCloseDatabase(catalog);
+        catalog = nullptr;
+    }
+}
@@ -0,0 +1,127 @@
+#include "../includes/tokenizer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+Tokenizer::Tokenizer(std::string_view input, size_t position) :
+    input(input), position(std::min(position, input.size())) { }
+
+// Same characters as std::isspace in the "C" locale, without a locale lookup per character
+static bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Loops work on a local copy of the position, stores through it could alias the input
+void Tokenizer::skipSpaces()
+{
+    size_t next = position;
+    while (next < input.size() && isSpace(input[next]))
+    {
+        next++;
+    }
+    position = next;
+}
+
+// Next character without moving past it, EOF at the end of the input
+int Tokenizer::peek() const
+{
+    if (position == input.size())
+    {
+        return EOF;
+    }
+    return static_cast<unsigned char>(input[position]);
+}
+
+// First character of the next word
+int Tokenizer::peekWord()
+{
+    skipSpaces();
+    return peek();
+}
+
+void Tokenizer::get()
+{
+    if (position < input.size())
+    {
+        position++;
+    }
+}
+
+// Next run of characters up to a space or the end character.
+// Return false if there are no more words
+bool Tokenizer::word(std::string_view& word, char end)
+{
+    skipSpaces();
+    size_t last = position;
+    while (last < input.size() && !isSpace(input[last]) && input[last] != end)
+    {
+        last++;
+    }
+
+    word = input.substr(position, last - position);
+    position = last;
+    return !word.empty();
+}
+
+// Unsigned decimal number, it ends at the first character that isn't a digit.
+// Return false if there is no number or it doesn't fit into 64 bits
+bool Tokenizer::number(uint64_t& number)
+{
+    skipSpaces();
+    if (peek() == '+')
+    {
+        position++;
+    }
+
+    const char* first = input.data() + position;
+    const char* last = input.data() + input.size();
+    std::from_chars_result result = std::from_chars(first, last, number);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+
+    position += result.ptr - first;
+    return true;
+}
+
+// Rest of the input after the spaces, it may contain spaces itself
+std::string_view Tokenizer::rest()
+{
+    skipSpaces();
+    std::string_view rest = input.substr(position);
+    position = input.size();
+    return rest;
+}
+
+// Text after the spaces up to the end character, without spaces at its end.
+// The end character itself is left for the caller
+std::string_view Tokenizer::until(char end)
+{
+    skipSpaces();
+    size_t last = input.find(end, position);
+    if (last == std::string_view::npos)
+    {
+        last = input.size();
+    }
+
+    std::string_view text = input.substr(position, last - position);
+    while (!text.empty() && isSpace(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    position = last;
+    return text;
+}
+
+size_t Tokenizer::getPosition() const
+{
+    return position;
+}
+
+void Tokenizer::setPosition(size_t position)
+{
+    this->position = position;
+}
@@ -0,0 +1,602 @@
+#include "../includes/transfer.h"
+#include "../includes/statement.h"
+
+#include <charconv>
+#include <fstream>
+
+const char CSV_HEADER[] = "id,username,email,value";
+
+// Format of a file by its extension, false if it's neither .csv nor .bin
+bool parseTransferFormat(std::string_view filename, TransferFormat& format)
+{
+    if (filename.ends_with(".csv"))
+    {
+        format = TransferFormat::TRANSFER_CSV;
+        return true;
+    }
+    if (filename.ends_with(".bin"))
+    {
+        format = TransferFormat::TRANSFER_BINARY;
+        return true;
+    }
+    return false;
+}
+
+// EXPORT
+
+// Collects the output in a block and writes it to the file when the block is full.
+// Parts longer than a block are written directly
+class BlockWriter
+{
+private:
+    std::ofstream file;
+    std::string block;
+
+public:
+    explicit BlockWriter(const std::string& filename) : file(filename, std::ios::binary)
+    {
+        block.reserve(OUTPUT_BUFFER_SIZE);
+    }
+
+    bool isOpen() const
+    {
+        return file.is_open();
+    }
+
+    void append(const char* data, size_t length)
+    {
+        if (block.size() + length > OUTPUT_BUFFER_SIZE)
+        {
+            flush();
+            if (length > OUTPUT_BUFFER_SIZE)
+            {
+                file.write(data, length);
+                return;
+            }
+        }
+        block.append(data, length);
+    }
+
+    void append(std::string_view text)
+    {
+        append(text.data(), text.size());
+    }
+
+    // Return false if writing to the file failed
+    bool flush()
+    {
+        file.write(block.data(), block.size());
+        block.clear();
+        return !file.fail();
+    }
+};
+
+static void writeKeyText(BlockWriter& writer, const Key& key, KeyType keyType)
+{
+    char text[2 * 20 + 1];
+    char* end = text;
+    if (keyType == KEY_COMPOSITE)
+    {
+        end = std::to_chars(end, text + sizeof(text), key.prefix).ptr;
+        *end++ = ':';
+    }
+    end = std::to_chars(end, text + sizeof(text), key.id).ptr;
+    writer.append(text, end - text);
+}
+
+static bool csvNeedsQuotes(std::string_view text)
+{
+    return text.find_first_of(",\"\r\n") != std::string_view::npos;
+}
+
+// Text of a quoted field, with its quotes doubled
+static void writeCsvEscaped(BlockWriter& writer, std::string_view text)
+{
+    size_t quote;
+    while ((quote = text.find('"')) != std::string_view::npos)
+    {
+        writer.append(text.substr(0, quote + 1));
+        writer.append("\"");
+        text.remove_prefix(quote + 1);
+    }
+    writer.append(text);
+}
+
+static void writeCsvField(BlockWriter& writer, std::string_view text)
+{
+    if (!csvNeedsQuotes(text))
+    {
+        writer.append(text);
+        return;
+    }
+    writer.append("\"");
+    writeCsvEscaped(writer, text);
+    writer.append("\"");
+}
+
+// Fields are copied from the leaf, the value part by part from its overflow pages.
+// The value is read twice if it has to be quoted, once to find out
+static void writeCsvRow(BlockWriter& writer, const std::shared_ptr<Pager>& pager, void* source)
+{
+    KeyType keyType = serializedKeyType(source);
+    writeKeyText(writer, readKey(keyType, static_cast<char*>(source) + ROW_KEY_OFFSET), keyType);
+    writer.append(",");
+    writeCsvField(writer, serializedUsername(source));
+    writer.append(",");
+    writeCsvField(writer, serializedEmail(source));
+
+    ValueReader value(pager, source);
+    if (value.getLength() > 0)
+    {
+        writer.append(",");
+
+        bool quoted = false;
+        const char* data;
+        uint32_t length;
+        while (!quoted && value.nextChunk(data, length))
+        {
+            quoted = csvNeedsQuotes(std::string_view(data, length));
+        }
+
+        ValueReader chunks(pager, source);
+        if (quoted)
+        {
+            writer.append("\"");
+        }
+        while (chunks.nextChunk(data, length))
+        {
+            if (quoted)
+            {
+                writeCsvEscaped(writer, std::string_view(data, length));
+            }
+            else
+            {
+                writer.append(data, length);
+            }
+        }
+        if (quoted)
+        {
+            writer.append("\"");
+        }
+    }
+    writer.append("\n");
+}
+
+// The row up to the value length is copied as it is, then the whole value follows
+static void writeBinaryRow(BlockWriter& writer, const std::shared_ptr<Pager>& pager, void* source)
+{
+    std::string_view email = serializedEmail(source);
+    const char* valueLength = email.data() + email.size();
+    writer.append(static_cast<char*>(source), valueLength + VALUE_LENGTH_SIZE - static_cast<char*>(source));
+
+    ValueReader value(pager, source);
+    const char* data;
+    uint32_t length;
+    while (value.nextChunk(data, length))
+    {
+        writer.append(data, length);
+    }
+}
+
+// Write every row of the table to a file in key order. The cursor holds a snapshot,
+// so the file has the table as it was when the export started
+TransferResult exportTable(std::shared_ptr<Table>& table, const std::string& filename,
+                           TransferFormat format, uint64_t& rowCount)
+{
+    rowCount = 0;
+    BlockWriter writer(filename);
+    if (!writer.isOpen())
+    {
+        return TransferResult::TRANSFER_FILE_ERROR;
+    }
+
+    if (format == TransferFormat::TRANSFER_CSV)
+    {
+        writer.append(CSV_HEADER);
+        writer.append("\n");
+    }
+    else
+    {
+        writer.append(EXPORT_MAGIC, EXPORT_MAGIC_SIZE);
+    }
+
+    std::unique_ptr<Cursor> cursor = tableStart(table);
+    while (!(cursor->endOfTable))
+    {
+        void* source = cursorValue(cursor);
+        if (!isRowDeleted(source))
+        {
+            if (format == TransferFormat::TRANSFER_CSV)
+            {
+                writeCsvRow(writer, table->pager, source);
+            }
+            else
+            {
+                writeBinaryRow(writer, table->pager, source);
+            }
+            rowCount++;
+        }
+        (*cursor)++;
+    }
+
+    return writer.flush() ? TransferResult::TRANSFER_SUCCESS : TransferResult::TRANSFER_FILE_ERROR;
+}
+
+// IMPORT
+
+// Reads a file in blocks. Rows are cut out of the current block, the start of
+// a row that goes past the end of the block is kept and the next block is read after it
+class BlockReader
+{
+private:
+    std::ifstream file;
+    std::string block;
+    size_t position;
+
+public:
+    explicit BlockReader(const std::string& filename) : file(filename, std::ios::binary), position(0) { }
+
+    bool isOpen() const
+    {
+        return file.is_open();
+    }
+
+    // Part of the block that wasn't read yet
+    std::string_view unread() const
+    {
+        return std::string_view(block).substr(position);
+    }
+
+    void consume(size_t length)
+    {
+        position += length;
+    }
+
+    // Read the next block after the unread part, return false at the end of the file
+    bool refill()
+    {
+        block.erase(0, position);
+        position = 0;
+
+        size_t kept = block.size();
+        block.resize(kept + INPUT_BLOCK_SIZE);
+        file.read(block.data() + kept, INPUT_BLOCK_SIZE);
+        block.resize(kept + file.gcount());
+        return file.gcount() > 0;
+    }
+
+    // Make sure that at least length bytes are unread, false if the file ends before
+    bool ensure(size_t length)
+    {
+        while (unread().size() < length)
+        {
+            if (!refill())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Insert the rows read so far in one batch and count them as imported
+static TransferResult importBatch(std::shared_ptr<Table>& table, std::vector<Row>& batch, 
+                                  uint64_t& rowCount)
+{
+    if (batch.empty())
+    {
+        return TransferResult::TRANSFER_SUCCESS;
+    }
+
+    std::vector<Row*> rows;
+    rows.reserve(batch.size());
+    for (Row& row : batch)
+    {
+        rows.push_back(&row);
+    }
+
+    switch (insertRows(table, rows))
+    {
+    case ExecuteResult::EXECUTE_SUCCESS:
+        break;
+    case ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH:
+        return TransferResult::TRANSFER_KEY_TYPE_MISMATCH;
+    default:
+        return TransferResult::TRANSFER_DUPLICATE_KEY;
+    }
+
+    rowCount += batch.size();
+    batch.clear();
+    return TransferResult::TRANSFER_SUCCESS;
+}
+
+static bool copyString(char* destination, std::string_view text, size_t maxLength)
+{
+    if (text.size() > maxLength)
+    {
+        return false;
+    }
+    memcpy(destination, text.data(), text.size());
+    destination[text.size()] = '\0';
+    return true;
+}
+
+// Length of the CSV row at the start of the input, line breaks inside quotes belong 
+// to the field. Return false if the row doesn't end in the input
+static bool findCsvRowEnd(std::string_view input, size_t& end)
+{
+    bool quoted = false;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        if (input[i] == '"')
+        {
+            quoted = !quoted;
+        }
+        else if (input[i] == '\n' && !quoted)
+        {
+            end = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Field of a CSV row starting at position, which is left at the comma after it 
+// or at the end of the row. Quoted fields are unquoted into scratch
+static bool nextCsvField(std::string_view row, size_t& position, std::string_view& field, 
+                         std::string& scratch)
+{
+    if (position < row.size() && row[position] == '"')
+    {
+        scratch.clear();
+        size_t start = position + 1;
+        while (true)
+        {
+            size_t quote = row.find('"', start);
+            if (quote == std::string_view::npos)
+            {
+                return false;
+            }
+            scratch.append(row.substr(start, quote - start));
+
+            // Doubled quotes stand for one quote
+            if (quote + 1 < row.size() && row[quote + 1] == '"')
+            {
+                scratch.push_back('"');
+                start = quote + 2;
+                continue;
+            }
+            position = quote + 1;
+            break;
+        }
+        field = scratch;
+        return position == row.size() || row[position] == ',';
+    }
+
+    size_t end = row.find(',', position);
+    if (end == std::string_view::npos)
+    {
+        end = row.size();
+    }
+    field = row.substr(position, end - position);
+    position = end;
+    return true;
+}
+
+// Key of a CSV row, "id" or "prefix:id"
+static bool parseCsvKey(std::string_view text, Key& key, KeyType& keyType)
+{
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+
+    uint64_t number;
+    std::from_chars_result result = std::from_chars(first, last, number);
+    if (result.ec != std::errc() || result.ptr == first)
+    {
+        return false;
+    }
+
+    keyType = KEY_INTEGER;
+    key = { 0, number };
+    if (result.ptr != last && *result.ptr == ':')
+    {
+        first = result.ptr + 1;
+        result = std::from_chars(first, last, number);
+        if (result.ec != std::errc() || result.ptr == first)
+        {
+            return false;
+        }
+        keyType = KEY_COMPOSITE;
+        key = { key.id, number };
+    }
+    return result.ptr == last;
+}
+
+static TransferResult parseCsvRow(std::string_view text, Row& row, std::string* scratch)
+{
+    if (!text.empty() && text.back() == '\r')
+    {
+        text.remove_suffix(1);
+    }
+
+    // Key, username and email are required, the value is not
+    std::string_view fields[4];
+    size_t position = 0;
+    size_t fieldCount = 0;
+    while (fieldCount < 4)
+    {
+        if (!nextCsvField(text, position, fields[fieldCount], scratch[fieldCount]))
+        {
+            return TransferResult::TRANSFER_FORMAT_ERROR;
+        }
+        fieldCount++;
+        if (position == text.size())
+        {
+            break;
+        }
+        position++;
+    }
+    if (fieldCount < 3 || position < text.size())
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+
+    if (!parseCsvKey(fields[0], row.key, row.keyType))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+    if (!copyString(row.username, fields[1], COLUMN_USERNAME_SIZE) ||
+        !copyString(row.email, fields[2], COLUMN_EMAIL_SIZE))
+    {
+        return TransferResult::TRANSFER_STRING_TOO_LONG;
+    }
+    row.value = fields[3];
+    return TransferResult::TRANSFER_SUCCESS;
+}
+
+// Next CSV row of the file, false at the end of the file. The last row doesn't need a newline
+static bool readCsvRow(BlockReader& reader, std::string_view& text)
+{
+    size_t end;
+    while (!findCsvRowEnd(reader.unread(), end))
+    {
+        if (!reader.refill())
+        {
+            text = reader.unread();
+            reader.consume(text.size());
+            return !text.empty();
+        }
+    }
+
+    text = reader.unread().substr(0, end);
+    reader.consume(end + 1);
+    return true;
+}
+
+// Next binary row of the file, laid out like the rows written by writeBinaryRow()
+static TransferResult readBinaryRow(BlockReader& reader, Row& row)
+{
+    // Flags, key and the username length, then the username and the email length
+    if (!reader.ensure(ROW_KEY_OFFSET))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+    row.keyType = serializedKeyType(const_cast<char*>(reader.unread().data()));
+    size_t length = ROW_KEY_OFFSET + keySize(row.keyType) + STRING_LENGTH_SIZE;
+    if (!reader.ensure(length))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+    length += static_cast<uint8_t>(reader.unread()[length - STRING_LENGTH_SIZE]) + STRING_LENGTH_SIZE;
+    if (!reader.ensure(length))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+    length += static_cast<uint8_t>(reader.unread()[length - STRING_LENGTH_SIZE]) + VALUE_LENGTH_SIZE;
+    if (!reader.ensure(length))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+
+    // The length comes from the file, a corrupt one mustn't make the reader buffer gigabytes
+    uint32_t valueLength;
+    memcpy(&valueLength, reader.unread().data() + length - VALUE_LENGTH_SIZE, VALUE_LENGTH_SIZE);
+    if (valueLength > IMPORT_MAX_VALUE_SIZE || !reader.ensure(length + valueLength))
+    {
+        return TransferResult::TRANSFER_FORMAT_ERROR;
+    }
+
+    void* source = const_cast<char*>(reader.unread().data());
+    row.key = readKey(row.keyType, static_cast<char*>(source) + ROW_KEY_OFFSET);
+    if (!copyString(row.username, serializedUsername(source), COLUMN_USERNAME_SIZE) ||
+        !copyString(row.email, serializedEmail(source), COLUMN_EMAIL_SIZE))
+    {
+        return TransferResult::TRANSFER_STRING_TOO_LONG;
+    }
+    row.value.assign(reader.unread().data() + length, valueLength);
+    reader.consume(length + valueLength);
+    return TransferResult::TRANSFER_SUCCESS;
+}
+
+// Insert the rows of a file into the table, IMPORT_BATCH_ROWS rows at a time.
+// Each batch is inserted at once, so if a row can't be imported the rows of 
+// the batches before it stay in the table. rowCount is the number of imported rows
+TransferResult importTable(std::shared_ptr<Table>& table, const std::string& filename,
+                           TransferFormat format, uint64_t& rowCount)
+{
+    rowCount = 0;
+    BlockReader reader(filename);
+    if (!reader.isOpen())
+    {
+        return TransferResult::TRANSFER_FILE_ERROR;
+    }
+
+    bool binary = format == TransferFormat::TRANSFER_BINARY;
+    if (binary)
+    {
+        if (!reader.ensure(EXPORT_MAGIC_SIZE) || 
+            memcmp(reader.unread().data(), EXPORT_MAGIC, EXPORT_MAGIC_SIZE) != 0)
+        {
+            return TransferResult::TRANSFER_FORMAT_ERROR;
+        }
+        reader.consume(EXPORT_MAGIC_SIZE);
+    }
+
+    std::vector<Row> batch;
+    batch.reserve(IMPORT_BATCH_ROWS);
+    std::string scratch[4];
+    bool firstRow = true;
+    while (true)
+    {
+        TransferResult result = TransferResult::TRANSFER_SUCCESS;
+        if (binary)
+        {
+            if (!reader.ensure(1))
+            {
+                break;
+            }
+            result = readBinaryRow(reader, batch.emplace_back());
+        }
+        else
+        {
+            std::string_view text;
+            if (!readCsvRow(reader, text))
+            {
+                break;
+            }
+
+            // The header is skipped, keys are numbers so no row starts like it
+            bool header = firstRow && text.starts_with("id,");
+            firstRow = false;
+            if (header || text.empty() || text == "\r")
+            {
+                continue;
+            }
+            result = parseCsvRow(text, batch.emplace_back(), scratch);
+        }
+
+        if (result == TransferResult::TRANSFER_SUCCESS && batch.back().keyType != table->keyType)
+        {
+            result = TransferResult::TRANSFER_KEY_TYPE_MISMATCH;
+        }
+
+        // Rows before the one that failed are imported
+        if (result != TransferResult::TRANSFER_SUCCESS)
+        {
+            batch.pop_back();
+            TransferResult batchResult = importBatch(table, batch, rowCount);
+            return batchResult != TransferResult::TRANSFER_SUCCESS ? batchResult : result;
+        }
+
+        if (batch.size() == IMPORT_BATCH_ROWS)
+        {
+            result = importBatch(table, batch, rowCount);
+            if (result != TransferResult::TRANSFER_SUCCESS)
+            {
+                return result;
+            }
+        }
+    }
+
+    return importBatch(table, batch, rowCount);
+}
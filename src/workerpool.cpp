@@ -0,0 +1,99 @@
+#include "../includes/workerpool.h"
+#include "../includes/constants.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool() : stopping(false) { }
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+WorkerPool& WorkerPool::instance()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::work()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+// Run the task on the calling thread and on threadCount - 1 workers, and wait until 
+// every run returned. The first exception of a run is raised again on the calling thread
+void WorkerPool::run(uint32_t threadCount, const std::function<void()>& task)
+{
+    std::mutex doneMutex;
+    std::condition_variable done;
+    uint32_t running = threadCount - 1;
+    std::exception_ptr error;
+
+    auto runTask = [&]()
+    {
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (error == nullptr)
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (workers.size() < std::min(threadCount, PARALLEL_SCAN_MAX_THREADS) - 1)
+        {
+            workers.emplace_back(&WorkerPool::work, this);
+        }
+        for (uint32_t i = 1; i < threadCount; i++)
+        {
+            jobs.emplace_back([&]()
+            {
+                runTask();
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--running == 0)
+                {
+                    done.notify_one();
+                }
+            });
+        }
+    }
+    wake.notify_all();
+
+    runTask();
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&]() { return running == 0; });
+    if (error != nullptr)
+    {
+        std::rethrow_exception(error);
+    }
+}
@@ -1,16 +1,24 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include "../includes/server.h"
 #include "../includes/database.h"
 #include "../includes/buffer.h"
 #include "../includes/constants.h"
 #include "../includes/data.h"
 #include "../includes/pager.h"
 #include "../includes/statement.h"
+#include "../includes/catalog.h"
+#include "../includes/connection.h"
 
 #include <sstream>
+#include <fstream>
 #include <algorithm>
 #include <iterator>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <random>
 
 int argcGlobal = 0;
 char** argvGlobal;
@@ -55,8 +63,7 @@ void Database::runTest(std::vector<std::string>& commands)
     {
         if (commands.back() == ".exit")
         {
-            if (this->cachedTable != nullptr)
-                saveAndCloseDatabase(cachedTable);
+            tables.closeAll();
             return;
         }
         // print_prompt(); 
@@ -234,12 +241,12 @@ TEST_F(DB_TEST, PrintConstants)
     };
     std::vector<std::string> expect = {
         "Constants:",
-        "ROW_SIZE: 293",
-        "COMMON_NODE_HEADER_SIZE: \x6",
-        "LEAF_NODE_HEADER_SIZE: 14",
-        "LEAF_NODE_CELL_SIZE: 297",
-        "LEAF_NODE_SPACE_FOR_CELLS: 4082",
-        "LEAF_NODE_MAX_CELLS: 13"
+        "ROW_MAX_SIZE: 442",
+        "COMMON_NODE_HEADER_SIZE: \x07",
+        "LEAF_NODE_HEADER_SIZE: 23",
+        "LEAF_NODE_MAX_CELL_SIZE: 444",
+        "LEAF_NODE_SPACE_FOR_CELLS: 4073",
+        "LEAF_NODE_MAX_CELLS: 214"
     };
 
     Database databaseTest(argcGlobal, argvGlobal);
@@ -295,7 +302,7 @@ TEST_F(DB_TEST, Insert40Rows)
         "insert 5 Emily_Williams emily.williams@example.com",
         "insert 78 Kevin_King kevin.king@example.com",
         "insert 29 Amanda_Davis amanda.davis@example.com",
-        "insert 34 John_Snow john.snow@example.com"
+        "insert 34 John_Snow john.snow@example.com",
         "insert 15 Ryan_Garcia ryan.garcia@example.com",
         "insert 36 Emily_Perez emily.perez@example.com",
         "insert 24 Heather_Nelson heather.nelson@example.com",
@@ -324,7 +331,7 @@ TEST_F(DB_TEST, Insert40Rows)
     databaseTest.runTest(commands);
 
     std::vector<std::string> out = outputCapturer.getOutputs();
-    std::vector<std::string> outSelect(out.begin() + 38, out.end());
+    std::vector<std::string> outSelect(out.begin() + 39, out.end());
 
     EXPECT_EQ(expect, outSelect);
 }
@@ -545,6 +552,2033 @@ TEST_F(DB_TEST, DropTable3)
     EXPECT_EQ(expect, outputCapturer.getOutputs());
 }
 
+TEST_F(DB_TEST, LeafHoldsShortRows)
+{
+    int insertCount = 80;
+    std::vector<std::string> commands = { "create table test_case_5" };
+    for (int i = 1; i <= insertCount; i++)
+    {
+        std::string iStr = std::to_string(i);
+        commands.push_back("insert " + iStr + " user" + iStr + " user" + iStr + "@example.com");
+    }
+    commands.push_back(".btree");
+    commands.push_back(".exit");
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ("- leaf (size 80)", outputCapturer.getOutputs()[insertCount + 1]);
+}
+
+TEST_F(DB_TEST, UpdateGrowsAndShrinksRows)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_5",
+        "update 50 " + longName + " " + longEmail,
+        "update 51 " + longName + " " + longEmail,
+        "update 50 a b",
+        "select",
+        ".exit"
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    std::vector<std::string> out = outputCapturer.getOutputs();
+    ASSERT_EQ(4 + 80 + 1, out.size());
+    EXPECT_EQ("(49, user49, user49@example.com)", out[4 + 48]);
+    EXPECT_EQ("(50, a, b)", out[4 + 49]);
+    EXPECT_EQ("(51, " + longName + ", " + longEmail + ")", out[4 + 50]);
+    EXPECT_EQ("(80, user80, user80@example.com)", out[4 + 79]);
+}
+
+TEST_F(DB_TEST, DropTable5)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_5",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, InsertLargeValues)
+{
+    std::string bigValue;
+    for (int i = 0; bigValue.size() < 100000; i++)
+    {
+        bigValue += "{\"n\": " + std::to_string(i) + "},";
+    }
+
+    std::vector<std::string> commands = {
+        "create table test_case_6",
+        "insert 2 Bob_Ross bob.ross@example.com " + bigValue,
+        "insert 1 John_Snow john.snow@example.com short value",
+        "insert 3 Rick_Smith rick.smith@example.com",
+        "select",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1, John_Snow, john.snow@example.com, short value)",
+        "(2, Bob_Ross, bob.ross@example.com, " + bigValue + ")",
+        "(3, Rick_Smith, rick.smith@example.com)",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, UpdateLargeValuesPersistence)
+{
+    std::string longerValue(3 * 1000 * 1000, 'x');
+    std::string shorterValue(5000, 'y');
+
+    std::vector<std::string> commands = {
+        "open table test_case_6",
+        "update 2 Bob_Ross bob.ross@example.com " + shorterValue,
+        "update 3 Rick_Smith rick.smith@example.com " + longerValue,
+        ".exit"
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    commands = {
+        "open table test_case_6",
+        "select",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1, John_Snow, john.snow@example.com, short value)",
+        "(2, Bob_Ross, bob.ross@example.com, " + shorterValue + ")",
+        "(3, Rick_Smith, rick.smith@example.com, " + longerValue + ")",
+        "Executed."
+    };
+
+    Database databaseTestReopened(argcGlobal, argvGlobal);
+    databaseTestReopened.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, DropTable6)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_6",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, Insert64BitKeys)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_7",
+        "insert 18446744073709551615 max max@example.com",
+        "insert 4294967296 big big@example.com",
+        "insert 0 zero zero@example.com",
+        "insert 18446744073709551616 over over@example.com",
+        "insert 1:2 composite composite@example.com",
+        "delete 4294967296",
+        "update 4294967296 big big@example.com",
+        "select",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: Syntax error. Could not parse statement.",
+        "Error: Key type doesn't match the table.",
+        "Executed.",
+        "Error: Key does not exist.",
+        "(0, zero, zero@example.com)",
+        "(18446744073709551615, max, max@example.com)",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, DropTable7)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_7",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, CompositeKeysPrefixScan)
+{
+    // Enough rows for the tree to grow several levels
+    std::vector<std::string> commands = { "create table test_case_8 composite" };
+    for (int id = 100; id >= 1; id--)
+    {
+        for (int tenant = 3; tenant >= 1; tenant--)
+        {
+            std::string key = std::to_string(tenant) + ":" + std::to_string(id);
+            commands.push_back("insert " + key + " user" + key + " user@example.com");
+        }
+    }
+    commands.push_back("insert 5 integer integer@example.com");
+    commands.push_back("delete 2:50");
+    commands.push_back("select where prefix = 2");
+    commands.push_back(".exit");
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    std::vector<std::string> out = outputCapturer.getOutputs();
+    ASSERT_EQ(1 + 300 + 2 + 99 + 1, out.size());
+    EXPECT_EQ("Error: Key type doesn't match the table.", out[301]);
+    EXPECT_EQ("(2:1, user2:1, user@example.com)", out[303]);
+    EXPECT_EQ("(2:49, user2:49, user@example.com)", out[303 + 48]);
+    EXPECT_EQ("(2:51, user2:51, user@example.com)", out[303 + 49]);
+    EXPECT_EQ("(2:100, user2:100, user@example.com)", out[303 + 98]);
+}
+
+TEST_F(DB_TEST, CompositeKeysPersistence)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_8",
+        "select where prefix = 3",
+        "select where prefix = 4",
+        ".exit"
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    std::vector<std::string> out = outputCapturer.getOutputs();
+    ASSERT_EQ(1 + 100 + 1 + 1, out.size());
+    EXPECT_EQ("(3:1, user3:1, user@example.com)", out[1]);
+    EXPECT_EQ("(3:100, user3:100, user@example.com)", out[100]);
+    EXPECT_EQ("Executed.", out[101]);
+    EXPECT_EQ("Executed.", out[102]);
+}
+
+TEST_F(DB_TEST, DropTable8)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_8",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SelectWhereUsesIndex)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_9",
+        "insert 1 John_Snow shared@example.com",
+        "insert 2 Bob_Ross bob.ross@example.com",
+        "insert 3 Rick_Smith shared@example.com",
+        "select where email = shared@example.com",
+        "create index on email",
+        "create index on email",
+        "insert 4 Morty_Smith shared@example.com",
+        "update 1 John_Snow john.snow@example.com",
+        "delete 3",
+        "select where email = shared@example.com",
+        "select where email = john.snow@example.com",
+        "select where email = nobody@example.com",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1, John_Snow, shared@example.com)",
+        "(3, Rick_Smith, shared@example.com)",
+        "Executed.",
+        "Executed.",
+        "Error: Index already exists.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(4, Morty_Smith, shared@example.com)",
+        "Executed.",
+        "(1, John_Snow, john.snow@example.com)",
+        "Executed.",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, IndexPersistence)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_9",
+        "insert 3 Rick_Smith shared@example.com",
+        "create index on username",
+        "select where email = shared@example.com",
+        "select where username = Bob_Ross",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(3, Rick_Smith, shared@example.com)",
+        "(4, Morty_Smith, shared@example.com)",
+        "Executed.",
+        "(2, Bob_Ross, bob.ross@example.com)",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, DropTable9)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_9",
+        "create table test_case_9",
+        "create index on email",
+        "drop table test_case_9",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SelectKeyRanges)
+{
+    std::vector<std::string> commands = { "create table test_case_10" };
+    for (int i = 300; i >= 1; i--)
+    {
+        std::string iStr = std::to_string(i);
+        commands.push_back("insert " + iStr + " user" + iStr + " user" + iStr + "@example.com");
+    }
+    commands.push_back("delete 12");
+    commands.push_back("select where id = 150");
+    commands.push_back("select where id = 12");
+    commands.push_back("select where id between 10 and 13");
+    commands.push_back("select where id > 298");
+    commands.push_back("select where id <= 2");
+    commands.push_back("select where id < 0");
+    commands.push_back("select where id between 13 and 10");
+    commands.push_back("select where id > 18446744073709551615");
+    commands.push_back("select where id = 1:2");
+    commands.push_back("select where id ! 1");
+    commands.push_back(".exit");
+
+    std::vector<std::string> expect = {
+        "(150, user150, user150@example.com)",
+        "Executed.",
+        "Executed.",
+        "(10, user10, user10@example.com)",
+        "(11, user11, user11@example.com)",
+        "(13, user13, user13@example.com)",
+        "Executed.",
+        "(299, user299, user299@example.com)",
+        "(300, user300, user300@example.com)",
+        "Executed.",
+        "(1, user1, user1@example.com)",
+        "(2, user2, user2@example.com)",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: Key type doesn't match the table.",
+        "Error: Syntax error. Could not parse statement."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    std::vector<std::string> out = outputCapturer.getOutputs();
+    ASSERT_EQ(1 + 300 + 1 + expect.size(), out.size());
+    EXPECT_EQ(expect, std::vector<std::string>(out.begin() + 302, out.end()));
+}
+
+TEST_F(DB_TEST, SelectDescendingWithLimit)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_10",
+        "select order by id desc limit 3",
+        "select where id < 150 order by id desc limit 2",
+        "select where id between 10 and 13 order by id desc",
+        "select order by id asc limit 2",
+        "select limit 0",
+        "select where id <= 2 order by id desc limit 5",
+        "select order by id desc limit -1",
+        "select order by username",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "(300, user300, user300@example.com)",
+        "(299, user299, user299@example.com)",
+        "(298, user298, user298@example.com)",
+        "Executed.",
+        "(149, user149, user149@example.com)",
+        "(148, user148, user148@example.com)",
+        "Executed.",
+        "(13, user13, user13@example.com)",
+        "(11, user11, user11@example.com)",
+        "(10, user10, user10@example.com)",
+        "Executed.",
+        "(1, user1, user1@example.com)",
+        "(2, user2, user2@example.com)",
+        "Executed.",
+        "Executed.",
+        "(2, user2, user2@example.com)",
+        "(1, user1, user1@example.com)",
+        "Executed.",
+        "Error: Syntax error. Could not parse statement.",
+        "Error: Syntax error. Could not parse statement."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, CountAndOffset)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_10",
+        "select count(*)",
+        "select count(*) where id between 10 and 20",
+        "select count(*) where id > 295",
+        "select count(*) where id < 1",
+        "select count(*) where username = user5",
+        "select where id >= 10 limit 2 offset 2",
+        "select order by id desc limit 2 offset 290",
+        "select where id between 10 and 13 order by id desc offset 1",
+        "select offset 298",
+        "select offset 299",
+        "select offset -1",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "299",
+        "Executed.",
+        "10",
+        "Executed.",
+        "5",
+        "Executed.",
+        "0",
+        "Executed.",
+        "1",
+        "Executed.",
+        "(13, user13, user13@example.com)",
+        "(14, user14, user14@example.com)",
+        "Executed.",
+        "(9, user9, user9@example.com)",
+        "(8, user8, user8@example.com)",
+        "Executed.",
+        "(11, user11, user11@example.com)",
+        "(10, user10, user10@example.com)",
+        "Executed.",
+        "(300, user300, user300@example.com)",
+        "Executed.",
+        "Executed.",
+        "Error: Syntax error. Could not parse statement."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, DropTable10)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_10",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, ConcurrentReadersAndWriter)
+{
+    std::shared_ptr<Table> catalog = openDatabase(DEFAULT_DATABASE_FILENAME);
+    std::shared_ptr<Table> table = createTable(catalog, "test_case_11", KEY_INTEGER);
+
+    // Odd keys are there from the start, the writer fills in the even ones
+    // and splits leaves under the readers
+    auto writeRow = [&table](uint64_t id) {
+        Row row;
+        row.keyType = KEY_INTEGER;
+        row.key = { 0, id };
+        strcpy_s(row.username, ("user" + std::to_string(id)).c_str());
+        strcpy_s(row.email, ("user" + std::to_string(id) + "@example.com").c_str());
+
+        TableWriter writer(table);
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, row.key);
+        leafInsert(cursor, &row);
+    };
+    for (uint64_t id = 1; id < 4000; id += 2)
+    {
+        writeRow(id);
+    }
+
+    // Readers and the writer evict pages from a small cache while they run
+    catalog->pager->setCacheLimit(32);
+    std::atomic<bool> writing(true);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&table, &writing, &errors, i]() {
+            Row row;
+            uint64_t id = 1;
+            while (writing)
+            {
+                // Every odd key is found, scans see keys in order in both directions
+                id = (id + 2 * 97) % 4000 | 1;
+                std::unique_ptr<Cursor> cursor = tableFindKey(table, { 0, id });
+                deserializeRow(cursorValue(cursor), &row);
+                if (row.key.id != id)
+                    errors++;
+
+                cursor.reset();
+                cursor = i % 2 ? tableSeek(table, { 0, id }) : tableSeekLast(table, { 0, id });
+                uint64_t previous = id;
+                for (int step = 0; step < 50 && !(cursor->endOfTable); step++)
+                {
+                    deserializeRow(cursorValue(cursor), &row);
+                    if (i % 2 ? row.key.id < previous : row.key.id > previous)
+                        errors++;
+                    previous = row.key.id;
+                    if (i % 2)
+                        (*cursor)++;
+                    else
+                        (*cursor)--;
+                }
+            }
+        });
+    }
+
+    for (uint64_t id = 2; id < 4000; id += 2)
+    {
+        writeRow(id);
+    }
+    writing = false;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(3999, tableCount(table));
+
+    saveAndCloseDatabase(catalog);
+}
+
+TEST_F(DB_TEST, DropTable11)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_11",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SnapshotIgnoresLaterCommits)
+{
+    std::shared_ptr<Table> catalog = openDatabase(DEFAULT_DATABASE_FILENAME);
+    std::shared_ptr<Table> table = createTable(catalog, "test_case_12", KEY_INTEGER);
+
+    // Insert a row, or overwrite it if the key exists
+    auto writeRow = [&table](uint64_t id, const std::string& name) {
+        Row row;
+        row.keyType = KEY_INTEGER;
+        row.key = { 0, id };
+        strcpy_s(row.username, name.c_str());
+        strcpy_s(row.email, "user@example.com");
+
+        TableWriter writer(table);
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, row.key);
+        void* node = table->pager->getPage(cursor->pageNumber);
+        if (cursor->cellCount < *leafGetCellCount(node) &&
+            leafGetKey(node, cursor->cellCount) == row.key)
+        {
+            leafUpdate(cursor, &row);
+            return;
+        }
+        leafInsert(cursor, &row);
+    };
+    for (uint64_t id = 1; id <= 500; id++)
+    {
+        writeRow(id, "old");
+    }
+
+    {
+        // Rows rewritten and added after the snapshot was taken are not seen through it
+        Snapshot snapshot;
+        std::unique_ptr<Cursor> cursor = tableStart(table);
+        for (uint64_t id = 1; id <= 1000; id++)
+        {
+            writeRow(id, "new");
+        }
+
+        EXPECT_EQ(500, tableCount(table));
+        Row row;
+        uint64_t seen = 0;
+        for (; !(cursor->endOfTable); cursorAdvance(cursor))
+        {
+            deserializeRow(cursorValue(cursor), &row);
+            EXPECT_STREQ("old", row.username);
+            seen++;
+        }
+        EXPECT_EQ(500, seen);
+    }
+
+    // A writer that ends with an exception commits nothing
+    try
+    {
+        TableWriter writer(table);
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, { 0, 1 });
+        leafDelete(cursor);
+        throw std::runtime_error("Abort the write.");
+    }
+    catch (const std::runtime_error&) { }
+
+    EXPECT_EQ(1000, tableCount(table));
+    Row row;
+    std::unique_ptr<Cursor> cursor = tableFindKey(table, { 0, 1 });
+    deserializeRow(cursorValue(cursor), &row);
+    EXPECT_STREQ("new", row.username);
+    cursor.reset();
+
+    // Pages the writer only reads are not copied, so an insert that fails changes no page
+    saveTable(catalog);
+    row.keyType = KEY_INTEGER;
+    row.key = { 0, 1 };
+    EXPECT_EQ(ExecuteResult::EXECUTE_DUPLICATE_KEY, insertRow(table, &row));
+    EXPECT_EQ(0u, table->pager->getDirtyPageCount());
+    saveAndCloseDatabase(catalog);
+}
+
+TEST_F(DB_TEST, DropTable12)
+{
+    std::vector<std::string> commands = {
+        "drop table test_case_12",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, StatementsNameTheirTable)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_13",
+        "create table test_case_14",
+        "insert into test_case_13 1 John_Snow john.snow@example.com",
+        "insert into test_case_14 2 Bob_Ross bob.ross@example.com",
+        "insert 3 Rick_Smith rick.smith@example.com",
+        "update test_case_13 1 Arya_Stark arya.stark@example.com",
+        "delete from test_case_14 2",
+        "select from test_case_13",
+        "select count(*) from test_case_14 where id > 0",
+        "select from test_case_15",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1, Arya_Stark, arya.stark@example.com)",
+        "Executed.",
+        "1",
+        "Executed.",
+        "Error: Table with the name \"test_case_15\" was not found."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, TableCacheEvictsLeastRecentlyUsed)
+{
+    // Room for two table handles and a few pages
+    TableCache tables(DEFAULT_DATABASE_FILENAME, 2, 8);
+    std::shared_ptr<Table> table = tables.get("test_case_13");
+    tables.get("test_case_14");
+    EXPECT_TRUE(tables.isOpen("test_case_13"));
+    EXPECT_EQ(nullptr, tables.get("test_case_15"));
+
+    // Using a table again doesn't reopen it
+    EXPECT_EQ(table, tables.get("test_case_13"));
+
+    // A third table evicts the least recently used handle
+    tables.add(createTable(tables.getCatalog(), "test_case_15", KEY_INTEGER));
+    EXPECT_TRUE(tables.isOpen("test_case_13"));
+    EXPECT_FALSE(tables.isOpen("test_case_14"));
+
+    // Reads make room in the page cache while the table grows past the budget, least
+    // recently used pages are written and evicted. Only pages a statement copied go over it
+    for (uint64_t id = 101; id <= 300; id++)
+    {
+        Row row;
+        row.keyType = KEY_INTEGER;
+        row.key = { 0, id };
+        strcpy_s(row.username, "user");
+        strcpy_s(row.email, "user@example.com");
+        row.value = std::string(300, 'x');
+
+        TableWriter writer(table);
+        std::unique_ptr<Cursor> cursor = tableFindKey(table, row.key);
+        EXPECT_GE(8, tables.getCachedPageCount());
+        leafInsert(cursor, &row);
+    }
+    EXPECT_LT(8, table->pager->getPageCount());
+    std::shared_ptr<Table> reopened = tables.get("test_case_14");
+    EXPECT_EQ(1, tableCount(reopened));
+    EXPECT_EQ(201, tableCount(table));
+    EXPECT_GE(8, tables.getCachedPageCount());
+
+    table.reset();
+    reopened.reset();
+    tables.closeAll();
+}
+
+TEST_F(DB_TEST, DropTable13)
+{
+    // A drop that fails keeps the opened table
+    std::vector<std::string> commands = {
+        "open table test_case_13",
+        "drop table test_case_13_b",
+        "select count(*)",
+        "open table test_case_14",
+        "drop table test_case_13",
+        "drop table test_case_14",
+        "drop table test_case_15",
+        "select",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Error: Table with the name \"test_case_13_b\" was not found.",
+        "201",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: Table not opened. Use \"create/open table [name]\" to create/open a table"
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, DroppedTablesFreePages)
+{
+    std::shared_ptr<Table> catalog = openDatabase(DEFAULT_DATABASE_FILENAME);
+
+    // Many small tables with a row that spills into overflow pages
+    auto createTables = [&catalog]() {
+        for (int i = 0; i < 100; i++)
+        {
+            std::shared_ptr<Table> table = createTable(catalog, "test_case_16_" + std::to_string(i),
+                                                       KEY_INTEGER);
+            ASSERT_NE(nullptr, table);
+
+            Row row;
+            row.keyType = KEY_INTEGER;
+            row.key = { 0, 1 };
+            strcpy_s(row.username, "user");
+            strcpy_s(row.email, "user@example.com");
+            row.value = std::string(5000, 'x');
+
+            TableWriter writer(table);
+            std::unique_ptr<Cursor> cursor = tableFindKey(table, row.key);
+            leafInsert(cursor, &row);
+        }
+    };
+
+    createTables();
+    uint32_t pageCount = catalog->pager->getPageCount();
+    EXPECT_EQ(nullptr, createTable(catalog, "test_case_16_0", KEY_INTEGER));
+
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_TRUE(dropTable(catalog, "test_case_16_" + std::to_string(i)));
+    }
+    EXPECT_FALSE(dropTable(catalog, "test_case_16_0"));
+    EXPECT_EQ(nullptr, openTable(catalog, "test_case_16_0"));
+
+    // Tables created again take the freed pages instead of growing the file
+    createTables();
+    EXPECT_GE(pageCount + 4, catalog->pager->getPageCount());
+    saveAndCloseDatabase(catalog);
+}
+
+TEST_F(DB_TEST, DropTable16)
+{
+    std::vector<std::string> commands = { "open table test_case_16_42", "select count(*)" };
+    std::vector<std::string> expect = { "Executed.", "1", "Executed." };
+    for (int i = 0; i < 100; i++)
+    {
+        commands.push_back("drop table test_case_16_" + std::to_string(i));
+        expect.push_back("Executed.");
+    }
+    commands.push_back(".tables");
+    commands.push_back(".exit");
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, PreparedStatementsBindParameters)
+{
+    TableCache tables(DEFAULT_DATABASE_FILENAME);
+
+    Statement create;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, create.prepareStatement("create table test_case_17"));
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, create.executeStatement(tables));
+
+    // Parsed once, executed with new values every time
+    Statement insert;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, insert.prepareStatement("insert ? ? ? ?"));
+    EXPECT_EQ(4, insert.getParameterCount());
+    EXPECT_EQ(ExecuteResult::EXECUTE_PARAMETER_NOT_BOUND, insert.executeStatement(tables));
+    for (uint64_t id = 1; id <= 100; id++)
+    {
+        std::string idStr = std::to_string(id);
+        EXPECT_EQ(PrepareResult::PREPARE_SUCCESS, insert.bindKey(1, { 0, id }, KEY_INTEGER));
+        EXPECT_EQ(PrepareResult::PREPARE_SUCCESS, insert.bindText(2, "user" + idStr));
+        EXPECT_EQ(PrepareResult::PREPARE_SUCCESS, insert.bindText(3, "user" + idStr + "@example.com"));
+        EXPECT_EQ(PrepareResult::PREPARE_SUCCESS, insert.bindText(4, "value with spaces " + idStr));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, insert.executeStatement(tables));
+    }
+    EXPECT_EQ(ExecuteResult::EXECUTE_DUPLICATE_KEY, insert.executeStatement(tables));
+
+    // Values are checked when they are bound
+    EXPECT_EQ(PrepareResult::PREPARE_STRING_TOO_LONG, insert.bindText(2, longName + "a"));
+    EXPECT_EQ(PrepareResult::PREPARE_PARAMETER_MISMATCH, insert.bindText(1, "1"));
+    EXPECT_EQ(PrepareResult::PREPARE_PARAMETER_MISMATCH, insert.bindKey(2, { 0, 1 }, KEY_INTEGER));
+    EXPECT_EQ(PrepareResult::PREPARE_PARAMETER_MISMATCH, insert.bindText(5, "1"));
+
+    // Key parameters of a select set its range
+    Statement select;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS,
+              select.prepareStatement("select count(*) where id between ? and ?"));
+    select.bindKey(1, { 0, 11 }, KEY_INTEGER);
+    select.bindKey(2, { 0, 20 }, KEY_INTEGER);
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, select.executeStatement(tables));
+    select.bindKey(1, { 0, 91 }, KEY_INTEGER);
+    select.bindKey(2, { 0, 200 }, KEY_INTEGER);
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, select.executeStatement(tables));
+    select.bindKey(2, { 1, 200 }, KEY_COMPOSITE);
+    EXPECT_EQ(ExecuteResult::EXECUTE_KEY_TYPE_MISMATCH, select.executeStatement(tables));
+
+    // Preparing the statement again doesn't keep the count, limit or range of the last one
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS,
+              select.prepareStatement("select count(*) where id > 95 limit 2"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, select.executeStatement(tables));
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, select.prepareStatement("select where id = 7"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, select.executeStatement(tables));
+
+    Statement update;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, update.prepareStatement("update ? name ? new value"));
+    update.bindKey(1, { 0, 42 }, KEY_INTEGER);
+    update.bindText(2, "name@example.com");
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, update.executeStatement(tables));
+
+    Statement where;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, where.prepareStatement("select where email = ?"));
+    where.bindText(1, "name@example.com");
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, where.executeStatement(tables));
+
+    Statement remove;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, remove.prepareStatement("delete from test_case_17 ?"));
+    remove.bindKey(1, { 0, 42 }, KEY_INTEGER);
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, remove.executeStatement(tables));
+    EXPECT_EQ(ExecuteResult::EXECUTE_KEY_DOES_NOT_EXIST, remove.executeStatement(tables));
+
+    tables.closeAll();
+
+    std::vector<std::string> expect = { "10", "10", "2", "(7, user7, user7@example.com, value with spaces 7)",
+                                        "(42, name, name@example.com, new value)" };
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, UnboundParameters)
+{
+    std::vector<std::string> commands = {
+        "open table test_case_17",
+        "insert 101 ? user@example.com",
+        "select where id = ?",
+        "select count(*)",
+        "drop table test_case_17",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Error: Statement has a parameter without a value.",
+        "Error: Statement has a parameter without a value.",
+        "99",
+        "Executed.",
+        "Executed."
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, TokenizerParsesLikeStreams)
+{
+    // Statements are parsed in place, with the same results string streams gave
+    std::vector<std::pair<std::string, PrepareResult>> statements = {
+        { "insert\t7 \tuser  user@example.com", PrepareResult::PREPARE_SUCCESS },
+        { "insert +7 user user@example.com", PrepareResult::PREPARE_SUCCESS },
+        { "insert 99999999999999999999 user user@example.com", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "insert 7x user", PrepareResult::PREPARE_SUCCESS },
+        { "insert 4: user user@example.com", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "insert 4:-5 user user@example.com", PrepareResult::PREPARE_NEGATIVE_ID },
+        { "insert into", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "delete from", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "select limit 5x", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "select where id between 1 and 2:3", PrepareResult::PREPARE_SYNTAX_ERROR },
+        { "create index on email x", PrepareResult::PREPARE_SYNTAX_ERROR },
+    };
+
+    for (const auto& [text, result] : statements)
+    {
+        Statement statement;
+        EXPECT_EQ(result, statement.prepareStatement(text)) << text;
+    }
+
+    Statement statement;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS,
+              statement.prepareStatement("insert 7x  user\tuser@example.com   a  value "));
+    Row row = statement.getRow();
+    EXPECT_EQ(7, row.key.id);
+    EXPECT_STREQ("x", row.username);
+    EXPECT_STREQ("user", row.email);
+    EXPECT_EQ("user@example.com   a  value ", row.value);
+}
+
+TEST_F(DB_TEST, MultiRowInsert)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_18",
+        "create index on email",
+        "insert (5 e e@example.com), (1 a a@example.com value one),(3 c c@example.com)",
+        "insert into test_case_18 (2 b b@example.com) , (4 d d@example.com two words )",
+        "insert (6 f f@example.com), (6 g g@example.com)",
+        "insert (7 h h@example.com), (3 z z@example.com)",
+        "insert (8 h h@example.com) (9 i i@example.com)",
+        "delete 3",
+        "insert (3 cc cc@example.com), (8 h h@example.com)",
+        "select",
+        "select where email = d@example.com",
+        "select count(*) where email = h@example.com",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: Duplicate key.",
+        "Error: Duplicate key.",
+        "Error: Syntax error. Could not parse statement.",
+        "Executed.",
+        "Executed.",
+        "(1, a, a@example.com, value one)",
+        "(2, b, b@example.com)",
+        "(3, cc, cc@example.com)",
+        "(4, d, d@example.com, two words)",
+        "(5, e, e@example.com)",
+        "(8, h, h@example.com)",
+        "Executed.",
+        "(4, d, d@example.com, two words)",
+        "Executed.",
+        "1",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, MultiRowInsertOverPageBudget)
+{
+    // Batches in random order split many leaves while least recently used pages are evicted
+    TableCache tables(DEFAULT_DATABASE_FILENAME, 2, 16);
+    std::vector<uint64_t> ids(10000);
+    std::iota(ids.begin(), ids.end(), 1);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(18));
+
+    Statement open;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, open.prepareStatement("open table test_case_18"));
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, open.executeStatement(tables));
+    for (size_t first = 0; first < ids.size(); first += 500)
+    {
+        std::string text = "insert";
+        for (size_t i = first; i < first + 500; i++)
+        {
+            std::string idStr = std::to_string(ids[i] + 100);
+            text += (i > first ? ", (" : " (") + idStr + " user" + idStr + " user" + idStr + "@example.com)";
+        }
+
+        Statement insert;
+        ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, insert.prepareStatement(text));
+        ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, insert.executeStatement(tables));
+    }
+
+    Statement count;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, count.prepareStatement("select count(*) where id > 100"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, count.executeStatement(tables));
+    Statement where;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, where.prepareStatement("select where email = user5000@example.com"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, where.executeStatement(tables));
+    Statement drop;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, drop.prepareStatement("drop table test_case_18"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, drop.executeStatement(tables));
+    tables.closeAll();
+
+    std::vector<std::string> expect = { "10000", "(5000, user5000, user5000@example.com)" };
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, Transactions)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_19",
+        "create index on username",
+        "begin",
+        "begin",
+        "insert (1 a a@example.com), (2 b b@example.com)",
+        "insert 3 c c@example.com",
+        "select count(*)",
+        "rollback",
+        "select count(*)",
+        "select where username = a",
+        "rollback",
+        "commit",
+        "begin",
+        "insert 4 d d@example.com",
+        "update 4 dd d@example.com",
+        "create table test_case_19_b",
+        "insert 1 x x@example.com",
+        "open table test_case_19",
+        "commit",
+        "begin",
+        "drop table test_case_19_b",
+        "delete 4",
+        "create table test_case_19_c",
+        "open table test_case_19",
+        "rollback",
+        "open table test_case_19_c",
+        "select count(*) from test_case_19_b",
+        "select where username = dd",
+        "begin",
+        "insert 5 e e@example.com",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: A transaction is already open.",
+        "Executed.",
+        "Executed.",
+        "3",
+        "Executed.",
+        "Executed.",
+        "0",
+        "Executed.",
+        "Executed.",
+        "Error: No transaction is open.",
+        "Error: No transaction is open.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Error: Table with the name \"test_case_19_c\" was not found.",
+        "1",
+        "Executed.",
+        "(4, dd, d@example.com)",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, TransactionsRollBackOnExit)
+{
+    std::vector<std::string> commands = {
+        "select count(*) from test_case_19",
+        "drop table test_case_19_b",
+        "drop table test_case_19",
+        ".exit"
+    };
+    std::vector<std::string> expect = { "1", "Executed.", "Executed.", "Executed." };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, TransactionsAreInvisibleUntilCommit)
+{
+    TableCache tables(DEFAULT_DATABASE_FILENAME);
+    Statement statement;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement("create table test_case_20"));
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables));
+    std::shared_ptr<Table> table = tables.current();
+
+    auto countFromOtherThread = [&table]() {
+        uint64_t count = 0;
+        std::thread reader([&table, &count]() { count = tableCount(table); });
+        reader.join();
+        return count;
+    };
+
+    Statement begin;
+    Statement commit;
+    Statement insert;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, begin.prepareStatement("begin"));
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, commit.prepareStatement("commit"));
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, insert.prepareStatement("insert ? user user@example.com"));
+
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, begin.executeStatement(tables));
+    for (uint64_t id = 1; id <= 1000; id++)
+    {
+        insert.bindKey(1, { 0, id }, KEY_INTEGER);
+        ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, insert.executeStatement(tables));
+    }
+
+    // Readers keep seeing the last commit while the transaction is open
+    EXPECT_EQ(1000, tableCount(table));
+    EXPECT_EQ(0, countFromOtherThread());
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, commit.executeStatement(tables));
+    EXPECT_EQ(1000, countFromOtherThread());
+    EXPECT_EQ(ExecuteResult::EXECUTE_NO_TRANSACTION, commit.executeStatement(tables));
+
+    Statement drop;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, drop.prepareStatement("drop table test_case_20"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, drop.executeStatement(tables));
+    table.reset();
+    tables.closeAll();
+}
+
+TEST_F(DB_TEST, TransactionsDontCopyReadPages)
+{
+    // A select inside a transaction reads pages without copying them, so they can be
+    // evicted while it runs and the commit has nothing to write
+    TableCache tables(DEFAULT_DATABASE_FILENAME, 2, 32);
+    Statement statement;
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement("create table test_case_20"));
+    ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables));
+    for (uint64_t first = 1; first <= 20000; first += 500)
+    {
+        std::string text = "insert";
+        for (uint64_t id = first; id < first + 500; id++)
+        {
+            std::string idStr = std::to_string(id);
+            text += (id > first ? ", (" : " (") + idStr + " user" + idStr + " user" + idStr + "@example.com)";
+        }
+        ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement(text));
+        ASSERT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables));
+    }
+    std::shared_ptr<Pager> pager = tables.current()->pager;
+    saveTable(tables.getCatalog());
+    EXPECT_LT(32u, pager->getPageCount());
+
+    std::ostringstream selected;
+    ASSERT_TRUE(tables.begin());
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement("select id where email like %19999@%"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables, selected));
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement("select count(*) where id > 0"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables, selected));
+    EXPECT_EQ(0u, pager->getPendingPageCount());
+    EXPECT_GE(32u, tables.getCachedPageCount());
+    ASSERT_TRUE(tables.commit());
+    EXPECT_EQ(0u, pager->getDirtyPageCount());
+    EXPECT_EQ("(19999)\n20000\n", selected.str());
+
+    ASSERT_EQ(PrepareResult::PREPARE_SUCCESS, statement.prepareStatement("drop table test_case_20"));
+    EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, statement.executeStatement(tables));
+    pager.reset();
+    tables.closeAll();
+}
+
+TEST_F(DB_TEST, BatchScript)
+{
+    // Longer than one input block, with Windows line ends, empty lines and no newline at the end
+    const std::string scriptFilename = "test_case_21.sql";
+    std::vector<std::string> expect = { "Executed." };
+    {
+        std::ofstream script(scriptFilename, std::ios::binary);
+        script << "create table test_case_21\r\n\r\n";
+        for (int id = 1; id <= 30000; id++)
+        {
+            script << "insert " << id << " user" << id << " user" << id << "@example.com\r\n";
+            expect.push_back("Executed.");
+        }
+        script << "\nselect count(*)\nselect where id = 29999\ndrop table test_case_21";
+    }
+    expect.insert(expect.end(), { "30000", "Executed.", "(29999, user29999, user29999@example.com)", 
+                                  "Executed.", "Executed." });
+
+    std::string batchArgument = "--batch";
+    std::string filename = DEFAULT_DATABASE_FILENAME;
+    std::vector<char*> arguments = { argvGlobal[0], batchArgument.data(), 
+                                     const_cast<char*>(scriptFilename.c_str()), filename.data() };
+    {
+        Database databaseTest(static_cast<int>(arguments.size()), arguments.data());
+        databaseTest.run();
+    }
+    DeleteFileA(scriptFilename.c_str());
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+static std::string readFileBytes(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFileBytes(const std::string& filename, const std::string& bytes)
+{
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), bytes.size());
+}
+
+TEST_F(DB_TEST, ImportAndExport)
+{
+    std::string longValue(5000, 'v');
+    std::vector<std::string> commands = {
+        "create table test_case_22",
+        "insert 3 c c@example.com",
+        "insert 1 a a,b@example.com value, with \"quotes\"",
+        "insert 2 b b@example.com " + longValue,
+        "insert 4 d d@example.com",
+        "delete 4",
+        ".export test_case_22.csv",
+        ".export test_case_22.bin",
+        ".export test_case_22.txt",
+        "create table test_case_22_b",
+        ".import test_case_22.csv",
+        "select",
+        ".import test_case_22.bin",
+        ".import test_case_22.bin test_case_22_c",
+        "create table test_case_22_c composite",
+        ".import test_case_22.bin",
+        ".import missing.csv",
+        "select count(*) from test_case_22_c",
+        "drop table test_case_22",
+        "drop table test_case_22_b",
+        "drop table test_case_22_c",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Exported 3 rows.",
+        "Exported 3 rows.",
+        "Error: Syntax error. Could not parse statement.",
+        "Executed.",
+        "Imported 3 rows.",
+        "(1, a, a,b@example.com, value, with \"quotes\")",
+        "(2, b, b@example.com, " + longValue + ")",
+        "(3, c, c@example.com)",
+        "Executed.",
+        "Error: Duplicate key in the batch after row 0 of the file. Imported 0 rows.",
+        "Error: Table was not found.",
+        "Executed.",
+        "Error: Key of row 1 of the file doesn't match the table. Imported 0 rows.",
+        "Error: Could not read missing.csv.",
+        "0",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    // A truncated file and a value longer than the limit can't be parsed, 
+    // the rows before them are imported
+    std::string exported = readFileBytes("test_case_22.bin");
+    writeFileBytes("test_case_22_cut.bin", exported.substr(0, exported.size() - 1));
+    uint32_t corruptLength = UINT32_MAX;
+    memcpy(&exported[exported.find("value, with") - VALUE_LENGTH_SIZE], &corruptLength, VALUE_LENGTH_SIZE);
+    writeFileBytes("test_case_22_corrupt.bin", exported);
+
+    std::vector<std::string> corruptCommands = {
+        "create table test_case_22_d",
+        ".import test_case_22_cut.bin",
+        ".import test_case_22_corrupt.bin",
+        "select count(*)",
+        "drop table test_case_22_d",
+        ".exit"
+    };
+    Database corruptTest(argcGlobal, argvGlobal);
+    corruptTest.runTest(corruptCommands);
+    expect.insert(expect.end(), {
+        "Executed.",
+        "Error: Row 3 of the file could not be parsed. Imported 2 rows.",
+        "Error: Row 1 of the file could not be parsed. Imported 0 rows.",
+        "2",
+        "Executed.",
+        "Executed."
+    });
+    DeleteFileA("test_case_22.csv");
+    DeleteFileA("test_case_22.bin");
+    DeleteFileA("test_case_22_cut.bin");
+    DeleteFileA("test_case_22_corrupt.bin");
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SelectColumns)
+{
+    std::string longValue(5000, 'v');
+    std::vector<std::string> commands = {
+        "create table test_case_23",
+        "insert 1 a a@example.com",
+        "insert 2 b shared@example.com value 2",
+        "insert 3 c shared@example.com " + longValue,
+        "insert 4 d d@example.com",
+        "delete 3",
+        "select username where email = shared@example.com",
+        "insert 3 c shared@example.com " + longValue,
+        "select email, id, value from test_case_23 where email = shared@example.com order by id desc",
+        "select * where username = d",
+        "select id,username limit 2",
+        "select value where id between 2 and 3",
+        "select count(*) where email = shared@example.com",
+        "create index on email",
+        "select username, value where email = shared@example.com offset 1",
+        "select username, where id = 1",
+        "select name",
+        "drop table test_case_23",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(b)",
+        "Executed.",
+        "Executed.",
+        "(shared@example.com, 3, " + longValue + ")",
+        "(shared@example.com, 2, value 2)",
+        "Executed.",
+        "(4, d, d@example.com)",
+        "Executed.",
+        "(1, a)",
+        "(2, b)",
+        "Executed.",
+        "(value 2)",
+        "(" + longValue + ")",
+        "Executed.",
+        "2",
+        "Executed.",
+        "Executed.",
+        "(c, " + longValue + ")",
+        "Executed.",
+        "Error: Syntax error. Could not parse statement.",
+        "Error: Syntax error. Could not parse statement.",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SelectLike)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_24",
+        "insert 1 abc1 first.last@corp.com",
+        "insert 2 xabc a.very.long.mailbox.name@department.corp.com",
+        "insert 3 abc3 someone@example.com",
+        "insert 4 ab_4 a.very.long.mailbox.name@department.corp.com.example.org",
+        "create index on email",
+        "select id where email like %@corp.com",
+        "select id where email like %corp.com%",
+        "select id where username like abc%",
+        "select id where username like %abc% order by id desc limit 2",
+        "select id where username like ab_%",
+        "select count(*) where email like %.com offset 1",
+        "select id where email like first.last@corp.com",
+        "select id where email like %mailbox%corp%org",
+        "select id where username like _bc_",
+        "select where prefix like 1",
+        "drop table test_case_24",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1)",
+        "Executed.",
+        "(1)",
+        "(2)",
+        "(4)",
+        "Executed.",
+        "(1)",
+        "(3)",
+        "Executed.",
+        "(3)",
+        "(2)",
+        "Executed.",
+        "(1)",
+        "(3)",
+        "(4)",
+        "Executed.",
+        "2",
+        "Executed.",
+        "(1)",
+        "Executed.",
+        "(4)",
+        "Executed.",
+        "(1)",
+        "(3)",
+        "Executed.",
+        "Error: Syntax error. Could not parse statement.",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, ParallelScan)
+{
+    // Large enough to be scanned by several threads, a limit keeps a select on one thread
+    const int rowCount = 70000;
+    std::vector<std::string> commands = { "create table test_case_25" };
+    std::vector<std::string> expect = { "Executed." };
+    for (int first = 1; first <= rowCount; first += 1000)
+    {
+        std::string insert = "insert ";
+        for (int id = first; id < first + 1000; id++)
+        {
+            insert += "(" + std::to_string(id) + " user" + std::to_string(id % 1000) + " user" + 
+                      std::to_string(id) + "@example.com)" + (id < first + 999 ? ", " : "");
+        }
+        commands.push_back(insert);
+        expect.push_back("Executed.");
+    }
+    commands.insert(commands.end(), {
+        "delete 1234",
+        "delete 69234",
+        "select id where email like %234@%",
+        "select id where email like %234@% limit 100",
+        "select count(*) where username = user234",
+        "select count(*) where username = user234 limit 5 offset 60",
+        "select where email = user65536@example.com",
+        "drop table test_case_25",
+        ".exit"
+    });
+
+    std::vector<std::string> matching;
+    for (int id = 234; id <= rowCount; id += 1000)
+    {
+        if (id != 1234 && id != 69234)
+        {
+            matching.push_back("(" + std::to_string(id) + ")");
+        }
+    }
+    expect.insert(expect.end(), { "Executed.", "Executed." });
+    expect.insert(expect.end(), matching.begin(), matching.end());
+    expect.push_back("Executed.");
+    expect.insert(expect.end(), matching.begin(), matching.end());
+    expect.insert(expect.end(), { "Executed.", "68", "Executed.", "5", "Executed.", 
+                                  "(65536, user536, user65536@example.com)", "Executed.", "Executed." });
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, SelectBatches)
+{
+    // Selects pass rows in batches of SELECT_BATCH_ROWS, offsets, limits and deleted rows 
+    // fall on both sides of batch boundaries
+    std::vector<std::string> commands = { "create table test_case_26" };
+    std::vector<std::string> expect = { "Executed." };
+    for (int first = 1; first <= 3000; first += 500)
+    {
+        std::string insert = "insert ";
+        for (int id = first; id < first + 500; id++)
+        {
+            insert += "(" + std::to_string(id) + " user" + std::to_string(id % 2) + " user" + 
+                      std::to_string(id) + "@example.com)" + (id < first + 499 ? ", " : "");
+        }
+        commands.push_back(insert);
+        expect.push_back("Executed.");
+    }
+    for (int id = 1020; id <= 1030; id++)
+    {
+        commands.push_back("delete " + std::to_string(id));
+        expect.push_back("Executed.");
+    }
+    commands.insert(commands.end(), {
+        "select id where id >= 1000 limit 3 offset 1015",
+        "select id where username = user1 limit 2 offset 1020",
+        "select id where username = user0 order by id desc limit 2 offset 1023",
+        "select count(*) where email like %@example.com",
+        "select count(*) where username = user1 limit 2000 offset 490",
+        "drop table test_case_26",
+        ".exit"
+    });
+    expect.insert(expect.end(), { 
+        "(2026)", "(2027)", "(2028)", "Executed.",
+        "(2051)", "(2053)", "Executed.",
+        "(942)", "(940)", "Executed.",
+        "2989", "Executed.",
+        "1005", "Executed.",
+        "Executed." 
+    });
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, IndexLimit)
+{
+    std::vector<std::string> commands = {
+        "create table test_case_27",
+        "create index on username",
+        "insert (1 same a@example.com), (2 other b@example.com), (3 same c@example.com)",
+        "insert (4 same d@example.com), (5 same e@example.com), (6 other f@example.com)",
+        "delete 3",
+        "select id where username = same limit 2",
+        "select id where username = same order by id desc limit 2 offset 1",
+        "select count(*) where username = same limit 2 offset 1",
+        "select count(*) where username = same offset 5",
+        "select id where username = same offset 1",
+        "drop table test_case_27",
+        ".exit"
+    };
+    std::vector<std::string> expect = {
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "Executed.",
+        "(1)",
+        "(4)",
+        "Executed.",
+        "(4)",
+        "(1)",
+        "Executed.",
+        "2",
+        "Executed.",
+        "0",
+        "Executed.",
+        "(4)",
+        "(5)",
+        "Executed.",
+        "Executed.",
+    };
+
+    Database databaseTest(argcGlobal, argvGlobal);
+    databaseTest.runTest(commands);
+
+    EXPECT_EQ(expect, outputCapturer.getOutputs());
+}
+
+TEST_F(DB_TEST, ServerSessions)
+{
+    // Two clients of one server, each with its own current table. Requests of a 
+    // client are sent without waiting for the responses, and a select of one 
+    // session waits while the other has a transaction open
+    const std::string socketPath = "test_case_28.sock";
+    Database databaseTest(argcGlobal, argvGlobal);
+    Server server(databaseTest, socketPath);
+    std::thread serving([&server]() { server.run(); });
+
+    std::vector<std::string> outputs;
+    {
+        ServerConnection first(socketPath);
+        ServerConnection second(socketPath);
+
+        outputs.push_back(first.request("create table test_case_28"));
+        outputs.push_back(second.request("create table test_case_28_b"));
+        for (std::string_view request : { "insert 1 user1 person1@example.com", 
+                                          "insert 2 user2 person2@example.com", 
+                                          "select" })
+        {
+            first.sendRequest(request);
+        }
+        second.sendRequest("insert 3 user3 person3@example.com");
+        second.sendRequest("select");
+        for (int i = 0; i < 3; i++)
+        {
+            outputs.emplace_back();
+            first.receiveResponse(outputs.back());
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            outputs.emplace_back();
+            second.receiveResponse(outputs.back());
+        }
+
+        // The select of the second session runs after the commit
+        outputs.push_back(first.request("begin"));
+        outputs.push_back(first.request("insert 4 user4 person4@example.com"));
+        second.sendRequest("select from test_case_28");
+        outputs.push_back(first.request("insert 5 user5 person5@example.com"));
+        outputs.push_back(first.request("commit"));
+        outputs.emplace_back();
+        second.receiveResponse(outputs.back());
+
+        // A transaction of a closed session is rolled back
+        outputs.push_back(second.request("begin"));
+        outputs.push_back(second.request("insert 6 user6 person6@example.com"));
+        outputs.push_back(second.request(".exit"));
+        outputs.push_back(first.request("select id from test_case_28_b"));
+
+        // A client that shuts down its side after its requests still gets every response
+        ServerConnection third(socketPath);
+        for (std::string_view request : { "open table test_case_28", "select count(*)", "select id where id = 5" })
+        {
+            third.sendRequest(request);
+        }
+        EXPECT_TRUE(third.finishRequests());
+        for (int i = 0; i < 3; i++)
+        {
+            outputs.emplace_back();
+            third.receiveResponse(outputs.back());
+        }
+        std::string afterLast;
+        EXPECT_FALSE(third.receiveResponse(afterLast));
+
+        outputs.push_back(first.request("drop table test_case_28"));
+        outputs.push_back(first.request("drop table test_case_28_b"));
+    }
+
+    server.stop();
+    serving.join();
+
+    std::vector<std::string> expect = {
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "(1, user1, person1@example.com)\n(2, user2, person2@example.com)\nExecuted.\n",
+        "Executed.\n",
+        "(3, user3, person3@example.com)\nExecuted.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "(1, user1, person1@example.com)\n(2, user2, person2@example.com)\n"
+        "(4, user4, person4@example.com)\n(5, user5, person5@example.com)\nExecuted.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "",
+        "(3)\nExecuted.\n",
+        "Executed.\n",
+        "4\nExecuted.\n",
+        "(5)\nExecuted.\n",
+        "Executed.\n",
+        "Executed.\n"
+    };
+    EXPECT_EQ(expect, outputs);
+}
+
+TEST_F(DB_TEST, ServerSessionExit)
+{
+    // A session that exits closes only its own connection. The other session keeps
+    // its current table and the cached pages, and bad requests don't stop the server
+    const std::string socketPath = "test_case_28.sock";
+    Database databaseTest(argcGlobal, argvGlobal);
+    Server server(databaseTest, socketPath);
+    std::thread serving([&server]() { server.run(); });
+
+    std::vector<std::string> outputs;
+    {
+        ServerConnection first(socketPath);
+        outputs.push_back(first.request(".btree"));
+        outputs.push_back(first.request("create table test_case_28"));
+        for (uint64_t id = 1; id <= 200; id++)
+        {
+            std::string idStr = std::to_string(id);
+            first.sendRequest("insert " + idStr + " user" + idStr + " person" + idStr + "@example.com");
+        }
+        for (uint64_t id = 1; id <= 200; id++)
+        {
+            std::string output;
+            first.receiveResponse(output);
+        }
+        uint32_t cachedPageCount = databaseTest.getTables().getCachedPageCount();
+        EXPECT_LT(0, cachedPageCount);
+
+        {
+            ServerConnection second(socketPath);
+            outputs.push_back(second.request("open table test_case_28"));
+            outputs.push_back(second.request("begin"));
+            outputs.push_back(second.request("insert 201 user201 person201@example.com"));
+            outputs.push_back(second.request(".exit"));
+        }
+
+        // The transaction of the exited session is rolled back once the next request runs
+        outputs.push_back(first.request("select count(*)"));
+        EXPECT_TRUE(databaseTest.getTables().isOpen("test_case_28"));
+        EXPECT_LE(cachedPageCount, databaseTest.getTables().getCachedPageCount());
+        outputs.push_back(first.request("drop table test_case_28"));
+    }
+
+    server.stop();
+    serving.join();
+
+    std::vector<std::string> expect = {
+        "Error: Table not opened. Use \"create/open table [name]\" to create/open a table\n",
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "Executed.\n",
+        "",
+        "200\nExecuted.\n",
+        "Executed.\n"
+    };
+    EXPECT_EQ(expect, outputs);
+}
+
+TEST_F(DB_TEST, ServerBinaryResponses)
+{
+    // Binary requests get the result code of the statement and the selected
+    // columns as records, text requests of the same session still get the console output
+    const std::string socketPath = "test_case_28.sock";
+    Database databaseTest(argcGlobal, argvGlobal);
+    Server server(databaseTest, socketPath);
+    std::thread serving([&server]() { server.run(); });
+
+    std::vector<ServerResponse> responses;
+    std::string text;
+    {
+        ServerConnection connection(socketPath);
+        responses.push_back(connection.query(".btree"));
+        responses.push_back(connection.query("create table test_case_28_c composite"));
+        responses.push_back(connection.query("insert 1:2 user1 person1@example.com"));
+        responses.push_back(connection.query("insert 1:2 user1 person1@example.com"));
+        responses.push_back(connection.query("insert 3:4 user3 person3@example.com a value"));
+        responses.push_back(connection.query("select"));
+        responses.push_back(connection.query("select email, id where id > 1:2"));
+        responses.push_back(connection.query("select count(*)"));
+        responses.push_back(connection.query("selcet"));
+        text = connection.request("select id");
+        responses.push_back(connection.query("drop table test_case_28_c"));
+    }
+
+    server.stop();
+    serving.join();
+
+    ASSERT_EQ(10, responses.size());
+    EXPECT_EQ(ResponseStatus::RESPONSE_META, responses[0].status);
+    EXPECT_EQ(static_cast<uint8_t>(MetaCommandResult::META_COMMAND_TABLE_NOT_SELECTED), responses[0].code);
+    EXPECT_EQ(ResponsePayload::PAYLOAD_NONE, responses[0].payload);
+    for (size_t i : { 1, 2, 4, 9 })
+    {
+        EXPECT_EQ(ResponseStatus::RESPONSE_EXECUTE, responses[i].status);
+        EXPECT_EQ(static_cast<uint8_t>(ExecuteResult::EXECUTE_SUCCESS), responses[i].code);
+        EXPECT_EQ(ResponsePayload::PAYLOAD_NONE, responses[i].payload);
+    }
+    EXPECT_EQ(static_cast<uint8_t>(ExecuteResult::EXECUTE_DUPLICATE_KEY), responses[3].code);
+
+    const ServerResponse& all = responses[5];
+    EXPECT_EQ(ResponsePayload::PAYLOAD_ROWS, all.payload);
+    EXPECT_EQ((std::vector<RowColumn>{ COLUMN_ID, COLUMN_USERNAME, COLUMN_EMAIL, COLUMN_VALUE }), all.columns);
+    ASSERT_EQ(2, all.rows.size());
+    EXPECT_EQ(KEY_COMPOSITE, all.rows[0].keyType);
+    EXPECT_EQ((Key{ 1, 2 }), all.rows[0].key);
+    EXPECT_STREQ("user1", all.rows[0].username);
+    EXPECT_STREQ("person1@example.com", all.rows[0].email);
+    EXPECT_EQ("", all.rows[0].value);
+    EXPECT_EQ((Key{ 3, 4 }), all.rows[1].key);
+    EXPECT_EQ("a value", all.rows[1].value);
+
+    const ServerResponse& selected = responses[6];
+    EXPECT_EQ(ResponsePayload::PAYLOAD_ROWS, selected.payload);
+    EXPECT_EQ((std::vector<RowColumn>{ COLUMN_EMAIL, COLUMN_ID }), selected.columns);
+    ASSERT_EQ(1, selected.rows.size());
+    EXPECT_STREQ("person3@example.com", selected.rows[0].email);
+    EXPECT_EQ((Key{ 3, 4 }), selected.rows[0].key);
+
+    EXPECT_EQ(ResponsePayload::PAYLOAD_COUNT, responses[7].payload);
+    EXPECT_EQ(2, responses[7].count);
+    EXPECT_EQ(ResponseStatus::RESPONSE_PREPARE, responses[8].status);
+    EXPECT_EQ(static_cast<uint8_t>(PrepareResult::PREPARE_UNRECOGNIZED_STATEMENT), responses[8].code);
+    EXPECT_EQ("(1:2)\n(3:4)\nExecuted.\n", text);
+}
+
+TEST_F(DB_TEST, ConnectionApi)
+{
+    // Typed calls return rows and result codes and print nothing, 
+    // statements given as text print selected rows to the given stream
+    const std::string filename = "test_case_29.db";
+    DeleteFileA(filename.c_str());
+    std::vector<std::string> copied;
+    std::vector<uint64_t> visited;
+    std::ostringstream selected;
+    {
+        std::unique_ptr<Connection> connection = Connection::open(filename);
+        EXPECT_EQ(ExecuteResult::EXECUTE_TABLE_NOT_SELECTED, connection->insert(1, "user1", "user1@example.com"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_PREPARE_FAILED, connection->exec("create tabel test_case_29"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("create table test_case_29"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_TABLE_NOT_FOUND, connection->openTable("test_case_29_missing"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->openTable("test_case_29"));
+
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->begin());
+        for (uint64_t id = 1; id <= 3000; id++)
+        {
+            std::string value = id == 2000 ? std::string(10000, 'v') : "";
+            EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, 
+                      connection->insert(id, "user" + std::to_string(id), 
+                                         "user" + std::to_string(id) + "@example.com", value));
+        }
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->commit());
+        EXPECT_EQ(ExecuteResult::EXECUTE_DUPLICATE_KEY, connection->insert(5, "again", "again@example.com"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_STRING_TOO_LONG, connection->insert(3001, longName + "a", "user@example.com"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("delete 1500"));
+
+        // Rolled back inserts are not visible
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->begin());
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->insert(3001, "user3001", "user3001@example.com"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->rollback());
+        EXPECT_EQ(ExecuteResult::EXECUTE_NO_TRANSACTION, connection->rollback());
+
+        Row row;
+        EXPECT_EQ(ExecuteResult::EXECUTE_KEY_DOES_NOT_EXIST, connection->get(3001, row));
+        EXPECT_EQ(ExecuteResult::EXECUTE_KEY_DOES_NOT_EXIST, connection->get(1500, row));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->get(2000, row));
+        EXPECT_EQ(2000u, row.key.id);
+        EXPECT_STREQ("user2000@example.com", row.email);
+        EXPECT_EQ(std::string(10000, 'v'), row.value);
+
+        // Ranges cross leaves and skip the deleted row, the visitor stops a scan
+        std::vector<Row> rows;
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->scan(1498, 1502, rows));
+        for (Row& scanned : rows)
+        {
+            copied.push_back(scanned.username);
+        }
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->scan(2999, UINT64_MAX, rows));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->scan(10, 5, rows));
+        EXPECT_EQ(6u, rows.size());
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->scan(0, 3000, [&visited](const RowView& view) {
+            visited.push_back(view.id());
+            return view.id() < 1000 || view.value().size() < 10000;
+        }));
+
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("select count(*)", selected));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("select username where id = 2999", selected));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("drop table test_case_29"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_TABLE_NOT_SELECTED, connection->get(1, row));
+    }
+    DeleteFileA(filename.c_str());
+
+    std::vector<std::string> expectCopied = { "user1498", "user1499", "user1501", "user1502" };
+    EXPECT_EQ(expectCopied, copied);
+    EXPECT_EQ(1999u, visited.size());
+    EXPECT_EQ(2000u, visited.back());
+    EXPECT_EQ("2999\n(user2999)\n", selected.str());
+    EXPECT_TRUE(outputCapturer.getOutputs().empty());
+}
+
+TEST_F(DB_TEST, CommitJournal)
+{
+    // A commit saves the pages it overwrites to a journal and deletes it once the file
+    // is flushed. A file left with a complete journal is rolled back when it's opened
+    const std::string filename = "test_case_30.db";
+    const std::string journalName = filename + JOURNAL_SUFFIX;
+    DeleteFileA(filename.c_str());
+    {
+        std::unique_ptr<Connection> connection = Connection::open(filename);
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("create table test_case_30"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->openTable("test_case_30"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->begin());
+        for (uint64_t id = 1; id <= 500; id++)
+        {
+            EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->insert(id, "user", "user@example.com"));
+        }
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->commit());
+        EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributesA(journalName.c_str()));
+    }
+
+    // Every page was overwritten and the file grew before the write stopped
+    std::string committed = readFileBytes(filename);
+    ASSERT_EQ(0u, committed.size() % PAGE_SIZE);
+    uint64_t fileLength = committed.size();
+    uint32_t pageCount = static_cast<uint32_t>(fileLength / PAGE_SIZE);
+    std::string journal(JOURNAL_HEADER_SIZE, '\0');
+    memcpy(&journal[JOURNAL_MAGIC_OFFSET], JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    memcpy(&journal[JOURNAL_FILE_LENGTH_OFFSET], &fileLength, JOURNAL_FILE_LENGTH_SIZE);
+    memcpy(&journal[JOURNAL_PAGE_COUNT_OFFSET], &pageCount, JOURNAL_PAGE_COUNT_SIZE);
+    for (uint32_t pageNumber = 0; pageNumber < pageCount; pageNumber++)
+    {
+        journal.append(reinterpret_cast<char*>(&pageNumber), JOURNAL_PAGE_NUMBER_SIZE);
+        journal.append(committed, pageNumber * PAGE_SIZE, PAGE_SIZE);
+    }
+    writeFileBytes(journalName, journal);
+    writeFileBytes(filename, std::string(committed.size() + PAGE_SIZE, 'x'));
+
+    std::vector<Row> rows;
+    {
+        std::unique_ptr<Connection> connection = Connection::open(filename);
+        EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributesA(journalName.c_str()));
+        EXPECT_EQ(committed, readFileBytes(filename));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->openTable("test_case_30"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->scan(0, UINT64_MAX, rows));
+    }
+    EXPECT_EQ(500u, rows.size());
+
+    // A journal without its header was never complete, the file wasn't touched
+    writeFileBytes(journalName, std::string(JOURNAL_HEADER_SIZE + JOURNAL_ENTRY_SIZE, 'x'));
+    {
+        std::unique_ptr<Connection> connection = Connection::open(filename);
+        EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributesA(journalName.c_str()));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->openTable("test_case_30"));
+        EXPECT_EQ(ExecuteResult::EXECUTE_SUCCESS, connection->exec("drop table test_case_30"));
+    }
+    DeleteFileA(filename.c_str());
+    EXPECT_TRUE(outputCapturer.getOutputs().empty());
+}
+
+TEST_F(DB_TEST, DeleteDatabaseFile)
+{
+    // Tests share the database file, it's removed after the last one
+    EXPECT_TRUE(DeleteFileA(DEFAULT_DATABASE_FILENAME));
+    EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributesA(DEFAULT_DATABASE_FILENAME));
+}
+
 //
 // MAIN
 //